@@ -21,10 +21,20 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "airqualitymonitor.h"
+#include "sensorlogcolumns.h"
 #include "extern-plugininfo.h"
 
+#include <QDir>
 #include <QDateTime>
-#include <QTextStream>
+#include <QtConcurrent>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+static QList<ChipDiscovery::Chip> supportedChips()
+{
+    return QList<ChipDiscovery::Chip>() << ChipDiscovery::ChipSHT30 << ChipDiscovery::ChipBMP180 << ChipDiscovery::ChipTSL2561 << ChipDiscovery::ChipADS1115;
+}
 
 /*
     Once connected the I2C devices can be found using the i2cdetect command on port 1 of the Raspberry Pi.
@@ -48,43 +58,124 @@
         - 0x77 : The pressure sensor BMP180
 */
 
-AirQualityMonitor::AirQualityMonitor(Device *device, QObject *parent) :
+AirQualityMonitor::AirQualityMonitor(Device *device, ChipDiscovery::Chips chips, QObject *parent) :
     QObject(parent),
-    m_device(device)
+    m_device(device),
+    m_chips(chips)
 {
-    // Create I2C devices
-    m_adc = new ADS1115("i2c-1", 0x48, this);
-    m_lightSensor = new TSL2561("i2c-1", 0x39, this);
-    m_pressureSensor = new BMP180("i2c-1", 0x77, this);
-    m_temperatureHumiditySensor = new SHT30("i2c-1", 0x44, this);
+    m_i2cPortName = m_device->paramValue(sensorStationBusParamTypeId).toString();
 
-    m_airQualityFilter = new SensorDataFilter(SensorDataFilter::TypeAverage, this);
-    m_airQualityFilter->setFilterWindowSize(5);
+    // Note: all configured addresses count as in use, also the ones of missing chips
+    m_addresses = configuredAddresses(m_device);
+    m_i2cAddresses << m_addresses.sht30 << m_addresses.bmp180 << m_addresses.tsl2561 << m_addresses.ads1115;
 
-    m_temperatureFilter = new SensorDataFilter(SensorDataFilter::TypeAverage, this);
-    m_temperatureFilter->setFilterWindowSize(3);
-
-    m_humidityFilter = new SensorDataFilter(SensorDataFilter::TypeAverage, this);
-    m_humidityFilter->setFilterWindowSize(3);
+    // Sensor head behind a TCA9548A multiplexer
+    int muxAddress = m_device->paramValue(sensorStationMuxAddressParamTypeId).toInt();
+    if (muxAddress > 0) {
+        m_muxAddress = muxAddress;
+        m_muxChannel = m_device->paramValue(sensorStationMuxChannelParamTypeId).toInt();
+        qCDebug(dcSensorStation()) << "Using I2C multiplexer" << QString("0x%1").arg(m_muxAddress, 0, 16) << "channel" << m_muxChannel;
+    }
 
-    m_pressureFilter = new SensorDataFilter(SensorDataFilter::TypeLowPass, this);
-    m_pressureFilter->setFilterWindowSize(5);
+    // Note: the filter chain is shared with the replay tool, see FilterConfiguration
+    QHash<QString, FilterConfiguration::Filter> filters = FilterConfiguration::monitorFilters();
+    m_airQualityFilter = createFilter(filters.value("ppm"));
+    m_temperatureFilter = createFilter(filters.value("temperature"));
+    m_humidityFilter = createFilter(filters.value("humidity"));
+    m_pressureFilter = createFilter(filters.value("pressure"));
+    m_lightFilter = createFilter(filters.value("lux"));
 
-    m_lightFilter = new SensorDataFilter(SensorDataFilter::TypeAverage, this);
-    m_lightFilter->setFilterWindowSize(3);
+    // Create the I2C devices of the chips found on the bus, missing chips get created once they show up
+    // Note: every chip has its own reading thread, stations on different buses never wait for each other
+    foreach (ChipDiscovery::Chip chip, supportedChips()) {
+        if (m_chips.testFlag(chip)) {
+            createSensor(chip);
+        }
+    }
 
     // Create the MQ-135 class and enable the ADC reading
     m_airQualitySensor = new MQ135(this);
 
+    // Duty cycle: wake up the sensors shortly before the next publish
+    m_wakeUpTimer = new QTimer(this);
+    m_wakeUpTimer->setSingleShot(true);
+    connect(m_wakeUpTimer, &QTimer::timeout, this, &AirQualityMonitor::onWakeUpTimeout);
+
+    // Evaluate the rate of change triggers in between the periodic publishes
+    m_evaluationTimer = new QTimer(this);
+    m_evaluationTimer->setInterval(10000);
+    connect(m_evaluationTimer, &QTimer::timeout, this, &AirQualityMonitor::evaluate);
+
+    // Publish the first values as soon as the filters are ready instead of waiting for the first periodic publish
+    m_startupTimer = new QTimer(this);
+    m_startupTimer->setInterval(500);
+    connect(m_startupTimer, &QTimer::timeout, this, &AirQualityMonitor::onStartupTimeout);
+
+    // Bring up chips plugged in later, or whose thread could not open the bus
+    m_probeTimer = new QTimer(this);
+    m_probeTimer->setSingleShot(true);
+    connect(m_probeTimer, &QTimer::timeout, this, &AirQualityMonitor::onProbeTimeout);
+
+    // Probing blocks on the bus lock and the chip IDs, it runs in the thread pool
+    m_probeWatcher = new QFutureWatcher<ChipDiscovery::Chips>(this);
+    connect(m_probeWatcher, &QFutureWatcher<ChipDiscovery::Chips>::finished, this, &AirQualityMonitor::onProbeFinished);
+
+    // Every state only gets published once the filters it is calculated from are ready
+    QList<SensorDataFilter *> temperatureHumidityFilters;
+    temperatureHumidityFilters << m_temperatureFilter << m_humidityFilter;
+
+    QHash<StateTypeId, QList<SensorDataFilter *> > stateFilters;
+    stateFilters.insert(sensorStationCo2StateTypeId, QList<SensorDataFilter *>() << m_airQualityFilter);
+    stateFilters.insert(sensorStationTemperatureStateTypeId, QList<SensorDataFilter *>() << m_temperatureFilter);
+    stateFilters.insert(sensorStationHumidityStateTypeId, QList<SensorDataFilter *>() << m_humidityFilter);
+    stateFilters.insert(sensorStationPressureStateTypeId, QList<SensorDataFilter *>() << m_pressureFilter);
+    stateFilters.insert(sensorStationLightIntensityStateTypeId, QList<SensorDataFilter *>() << m_lightFilter);
+    stateFilters.insert(sensorStationDewPointStateTypeId, temperatureHumidityFilters);
+    stateFilters.insert(sensorStationAbsoluteHumidityStateTypeId, temperatureHumidityFilters);
+    stateFilters.insert(sensorStationHeatIndexStateTypeId, temperatureHumidityFilters);
+    stateFilters.insert(sensorStationSeaLevelPressureStateTypeId, QList<SensorDataFilter *>() << m_pressureFilter);
+    stateFilters.insert(sensorStationPressureTendencyStateTypeId, QList<SensorDataFilter *>() << m_pressureFilter);
+    foreach (const StateTypeId &stateTypeId, stateFilters.keys()) {
+        m_statePublishers.insert(stateTypeId, new StatePublisher(m_device, stateTypeId, stateFilters.value(stateTypeId)));
+    }
+
+    // Derived states have no rate of change trigger, they only get updated on the periodic publish
+    // and only if they moved more than their deadband. The sea level pressure follows the pressure settings.
+    QHash<StateTypeId, double> derivedDeadbands;
+    derivedDeadbands.insert(sensorStationDewPointStateTypeId, 0.1);
+    derivedDeadbands.insert(sensorStationAbsoluteHumidityStateTypeId, 0.05);
+    derivedDeadbands.insert(sensorStationHeatIndexStateTypeId, 0.1);
+    derivedDeadbands.insert(sensorStationSeaLevelPressureStateTypeId, 0.2);
+    derivedDeadbands.insert(sensorStationPressureTendencyStateTypeId, 0.1);
+    foreach (const StateTypeId &stateTypeId, derivedDeadbands.keys()) {
+        m_statePublishers.value(stateTypeId)->setDeadband(derivedDeadbands.value(stateTypeId));
+    }
+
     // Note: for debugging, if we want to log the sensordata for plotting and filter tests
-    m_logfile = new QFile("/tmp/sensordata.log");
+    // Convert it with tools/sensorlog-convert for gnuplot
+    m_sensorLog = new SensorLogWriter(QString("/tmp/sensordata-%1.slog").arg(m_device->id().toString().remove('{').remove('}')), sensorLogColumns());
+    m_sensorLog->setMaximumSize(8 * 1024 * 1024);
+    m_sensorLog->setMaximumFiles(4);
+
+    // Nothing delivers samples yet, also not if no chip has been found on setup
+    publishAvailability();
 }
 
 AirQualityMonitor::~AirQualityMonitor()
 {
-    if (m_logfile->isOpen()) {
-        m_logfile->close();
+    // Write the remaining captured samples while the sensors still exist
+    setCaptureEnabled(false);
+
+    // Wake up all sensor threads at once, the sensor destructors only have to join them
+    foreach (SensorThread *sensor, sensors()) {
+        sensor->disable();
     }
+
+    delete m_sensorLog;
+
+    qDeleteAll(m_historyStores);
+
+    qDeleteAll(m_statePublishers);
 }
 
 Device *AirQualityMonitor::device() const
@@ -92,26 +183,282 @@ Device *AirQualityMonitor::device() const
     return m_device;
 }
 
-double AirQualityMonitor::roundValue(double value)
+ChipDiscovery::Chips AirQualityMonitor::chips() const
+{
+    return m_chips;
+}
+
+ChipDiscovery::Chips AirQualityMonitor::availableChips() const
+{
+    return m_availableChips;
+}
+
+ChipDiscovery::Addresses AirQualityMonitor::configuredAddresses(Device *device)
+{
+    ChipDiscovery::Addresses addresses;
+    addresses.sht30 = device->paramValue(sensorStationSht30AddressParamTypeId).toInt();
+    addresses.bmp180 = device->paramValue(sensorStationBmp180AddressParamTypeId).toInt();
+    addresses.tsl2561 = device->paramValue(sensorStationTsl2561AddressParamTypeId).toInt();
+    addresses.ads1115 = device->paramValue(sensorStationAds1115AddressParamTypeId).toInt();
+    return addresses;
+}
+
+QString AirQualityMonitor::i2cPortName() const
+{
+    return m_i2cPortName;
+}
+
+QList<int> AirQualityMonitor::i2cAddresses() const
+{
+    return m_i2cAddresses;
+}
+
+int AirQualityMonitor::muxAddress() const
+{
+    return m_muxAddress;
+}
+
+int AirQualityMonitor::muxChannel() const
+{
+    return m_muxChannel;
+}
+
+void AirQualityMonitor::setSchedulingConfiguration(const SensorThread::SchedulingConfiguration &configuration)
+{
+    m_schedulingConfiguration = configuration;
+    foreach (SensorThread *sensor, sensors()) {
+        sensor->setSchedulingConfiguration(configuration);
+    }
+}
+
+int AirQualityMonitor::publishInterval() const
+{
+    return m_publishInterval;
+}
+
+void AirQualityMonitor::setPublishInterval(int publishInterval)
+{
+    m_publishInterval = publishInterval;
+}
+
+bool AirQualityMonitor::dutyCycleEnabled() const
+{
+    return m_dutyCycleEnabled;
+}
+
+void AirQualityMonitor::setDutyCycleEnabled(bool enabled)
+{
+    qCDebug(dcSensorStation()) << "Duty cycle" << (enabled ? "enabled" : "disabled");
+    m_dutyCycleEnabled = enabled;
+    if (!m_dutyCycleEnabled) {
+        m_wakeUpTimer->stop();
+    }
+
+    foreach (SensorThread *sensor, sensors()) {
+        sensor->setDutyCycleEnabled(enabled);
+    }
+}
+
+bool AirQualityMonitor::sensorLogEnabled() const
 {
-    return qRound(value * 100) / 100.0;
+    return m_writeLogs;
+}
+
+void AirQualityMonitor::setSensorLogEnabled(bool enabled)
+{
+    m_writeLogs = enabled;
+    if (!m_writeLogs) {
+        m_sensorLog->close();
+        return;
+    }
+
+    if (!m_sensorLog->isOpen() && !m_sensorLog->open()) {
+        qCWarning(dcSensorStation()) << "Could not open logfile" << m_sensorLog->fileName() << m_sensorLog->errorString();
+    }
+}
+
+bool AirQualityMonitor::captureEnabled() const
+{
+    return m_captureWriter != nullptr;
+}
+
+void AirQualityMonitor::setCaptureEnabled(bool enabled)
+{
+    if (enabled == captureEnabled())
+        return;
+
+    if (enabled) {
+        qCDebug(dcSensorStation()) << "Start capturing raw samples";
+        m_captureWriter = new CaptureWriter(QString("/tmp/sensorcapture-%1").arg(m_device->id().toString().remove('{').remove('}')), sensors(), this);
+        m_captureWriter->setSyncPolicy(m_captureSyncPolicy, m_captureSyncInterval);
+        foreach (SensorThread *sensor, sensors()) {
+            sensor->setCaptureEnabled(true);
+        }
+        m_captureWriter->start(QThread::LowPriority);
+    } else {
+        qCDebug(dcSensorStation()) << "Stop capturing raw samples";
+        foreach (SensorThread *sensor, sensors()) {
+            sensor->setCaptureEnabled(false);
+        }
+
+        // Note: the writer drains the queues one last time before the thread finishes
+        delete m_captureWriter;
+        m_captureWriter = nullptr;
+    }
+}
+
+void AirQualityMonitor::setCaptureSyncPolicy(CaptureWriter::SyncPolicy syncPolicy, int syncInterval)
+{
+    m_captureSyncPolicy = syncPolicy;
+    m_captureSyncInterval = syncInterval;
+    if (m_captureWriter) {
+        m_captureWriter->setSyncPolicy(m_captureSyncPolicy, m_captureSyncInterval);
+    }
+}
+
+void AirQualityMonitor::setHistoryDirectory(const QString &directory)
+{
+    qDeleteAll(m_historyStores);
+    m_historyStores.clear();
+    m_historyDirectory = directory;
+
+    if (!QDir().mkpath(m_historyDirectory)) {
+        qCWarning(dcSensorStation()) << "Could not create the history directory" << m_historyDirectory;
+        m_historyDirectory.clear();
+        return;
+    }
+
+    openHistoryStores();
+}
+
+void AirQualityMonitor::openHistoryStores()
+{
+    if (m_historyDirectory.isEmpty())
+        return;
+
+    // Only the series of chips found on the bus, chips appearing later get their store when their sensor is created
+    QHash<StateTypeId, QString> series;
+    if (m_adc)
+        series.insert(sensorStationCo2StateTypeId, "co2");
+
+    if (m_temperatureHumiditySensor) {
+        series.insert(sensorStationTemperatureStateTypeId, "temperature");
+        series.insert(sensorStationHumidityStateTypeId, "humidity");
+    }
+
+    if (m_pressureSensor)
+        series.insert(sensorStationPressureStateTypeId, "pressure");
+
+    if (m_lightSensor)
+        series.insert(sensorStationLightIntensityStateTypeId, "lightIntensity");
+
+    foreach (const StateTypeId &stateTypeId, series.keys()) {
+        if (m_historyStores.contains(stateTypeId))
+            continue;
+
+        HistoryStore *store = new HistoryStore(m_historyDirectory, series.value(stateTypeId));
+        if (!store->open()) {
+            qCWarning(dcSensorStation()) << "Could not open the history of" << store->seriesName() << "in" << m_historyDirectory;
+            delete store;
+            continue;
+        }
+        m_historyStores.insert(stateTypeId, store);
+    }
+}
+
+QString AirQualityMonitor::queryHistory(const StateTypeId &stateTypeId, qint64 from, qint64 to, int maxPoints) const
+{
+    QJsonObject result;
+    HistoryStore *store = m_historyStores.value(stateTypeId);
+    if (!store) {
+        result.insert("error", "No history available");
+        return QString::fromUtf8(QJsonDocument(result).toJson(QJsonDocument::Compact));
+    }
+
+    QString tierName;
+    QVector<HistoryStore::Point> points = store->query(from, to, maxPoints, &tierName);
+
+    // Note: [timestamp [ms], min, max, avg] per point
+    QJsonArray pointArray;
+    foreach (const HistoryStore::Point &point, points) {
+        QJsonArray pointValues;
+        pointValues.append(static_cast<double>(point.timestamp));
+        pointValues.append(StatePublisher::roundValue(point.minimum));
+        pointValues.append(StatePublisher::roundValue(point.maximum));
+        pointValues.append(StatePublisher::roundValue(point.average));
+        pointArray.append(pointValues);
+    }
+
+    result.insert("series", store->seriesName());
+    result.insert("tier", tierName);
+    result.insert("from", static_cast<double>(from));
+    result.insert("to", static_cast<double>(to));
+    result.insert("points", pointArray);
+    return QString::fromUtf8(QJsonDocument(result).toJson(QJsonDocument::Compact));
+}
+
+void AirQualityMonitor::setBaselineCalibration(bool enabled, int windowDays)
+{
+    qCDebug(dcSensorStation()) << "MQ-135 baseline calibration" << (enabled ? "enabled" : "disabled") << "| window" << windowDays << "days";
+    m_baselineEnabled = enabled;
+    m_baseline.setWindow(static_cast<qint64>(windowDays) * 24 * 3600 * 1000);
+    if (m_baselineEnabled) {
+        updateBaseline();
+    } else {
+        m_airQualitySensor->setRZero(MQ135::defaultRZero());
+    }
+}
+
+double AirQualityMonitor::rZero() const
+{
+    return m_airQualitySensor->rZero();
+}
+
+QVariantMap AirQualityMonitor::baselineState() const
+{
+    return m_baseline.saveState();
+}
+
+void AirQualityMonitor::restoreBaselineState(const QVariantMap &state)
+{
+    // Note: a state of a different window gets dropped, the baseline starts learning again
+    m_baseline.restoreState(state);
+    if (m_baselineEnabled) {
+        updateBaseline();
+    }
+}
+
+void AirQualityMonitor::setPublishThresholds(const StateTypeId &stateTypeId, double deadband, double rateThreshold)
+{
+    StatePublisher *publisher = m_statePublishers.value(stateTypeId);
+    if (!publisher) {
+        qCWarning(dcSensorStation()) << "No state publisher for state type" << stateTypeId.toString();
+        return;
+    }
+
+    publisher->setDeadband(deadband);
+    publisher->setRateThreshold(rateThreshold);
 }
 
 void AirQualityMonitor::enable()
 {
     // Enable the sensors
-    m_adc->enable();
-    m_temperatureHumiditySensor->enable();
-    m_pressureSensor->enable();
-    m_lightSensor->enable();
+    foreach (SensorThread *sensor, sensors()) {
+        sensor->enable();
+    }
 
-    // Make device available
-    m_device->setStateValue(sensorStationConnectedStateTypeId, true);
+    // Note: the device becomes available with the first samples
+    m_enabled = true;
+    updateAvailability();
+    scheduleProbe(true);
+    m_evaluationTimer->start();
+    m_startupEvaluations = 0;
+    m_startupTimer->start();
 
     // Open the logfile
-    if (!m_logfile->isOpen() && m_writeLogs) {
-        if (!m_logfile->open(QFile::WriteOnly  | QFile::Append)) {
-            qCWarning(dcSensorStation()) << "Could not open logfile" << m_logfile->errorString();
+    if (!m_sensorLog->isOpen() && m_writeLogs) {
+        if (!m_sensorLog->open()) {
+            qCWarning(dcSensorStation()) << "Could not open logfile" << m_sensorLog->fileName() << m_sensorLog->errorString();
         }
     }
 }
@@ -119,59 +466,551 @@ void AirQualityMonitor::enable()
 void AirQualityMonitor::disable()
 {
     // Disable the sensors
-    m_adc->disable();
-    m_temperatureHumiditySensor->disable();
-    m_pressureSensor->disable();
-    m_lightSensor->disable();
+    foreach (SensorThread *sensor, sensors()) {
+        sensor->disable();
+    }
 
     // Make device unavailable
-    m_device->setStateValue(sensorStationConnectedStateTypeId, false);
+    m_enabled = false;
+    updateAvailability();
+    m_evaluationTimer->stop();
+    m_startupTimer->stop();
+    m_wakeUpTimer->stop();
+    m_probeTimer->stop();
 }
 
 void AirQualityMonitor::measure()
 {
-    // SHT30
-    double currentTemperature = m_temperatureHumiditySensor->currentTemperatureValue();
-    double currentTemperatureFiltered = m_temperatureFilter->filterValue(currentTemperature);
+    processSamples();
 
-    double currentHumidity = m_temperatureHumiditySensor->currentHumidityValue();
-    double currentHumidityFiltered = m_humidityFilter->filterValue(currentHumidity);
+    // Duty cycle: the sensors are powered down now, wake them up just early enough to fill their filter windows again.
+    // Note: one spare cycle covers the power up, 1 s per sample until the sensor has measured its cycle.
+    if (m_dutyCycleEnabled) {
+        int wakeUpLeadTime = 0;
+        foreach (SensorThread *sensor, sensors()) {
+            if (sensor == m_adc && m_airQualityStreaming)
+                continue;
+
+            int cyclePeriod = sensor->cyclePeriod() > 0 ? sensor->cyclePeriod() : 1000;
+            wakeUpLeadTime = qMax(wakeUpLeadTime, (sensor->samplesPerWindow() + 1) * cyclePeriod);
+        }
+        m_wakeUpTimer->start(qMax(0, m_publishInterval * 1000 - wakeUpLeadTime));
+    }
+
+    qCDebug(dcSensorStation()) << "Air quality value" << m_currentAirQualityAdcValue << m_airQualitySensor->getCalibrationRestistance() << "Ohm | RZero" << m_airQualitySensor->rZero() << "Ohm" << ADS1115::convertToVoltage(m_currentAirQualityAdcValue) << "V" << m_currentPpm << "ppm";
+    qCDebug(dcSensorStation()) << "Temperature" << m_currentTemperature << "[°C]" << "| Humidity" << m_currentHumidity << "[%]";
+    qCDebug(dcSensorStation()) << "Pressure" << m_currentPressure << "[hPa]";
+    qCDebug(dcSensorStation()) << "Light intensity" << m_currentLux << "[lux]";
+
+    updateStates(true);
+
+    // Wake up latency of the sensor threads since the last publish, for verifying the scheduling configuration
+    foreach (SensorThread *sensor, sensors()) {
+        SensorThread::WakeUpLatency latency = sensor->wakeUpLatency();
+        sensor->resetWakeUpLatency();
+        qCDebug(dcSensorStation()) << qPrintable(sensor->sensorName() + ":") << sensor->schedulingStatus() << "wake up latency average" << latency.averageMicroSeconds << "[us] | max" << latency.maxMicroSeconds << "[us] |" << latency.count << "wake ups";
+    }
+
+    // Write logfile for filter verification, same order as sensorLogColumns()
+    if (m_sensorLog->isOpen()) {
+        float values[10] = {
+            static_cast<float>(m_currentTemperature), static_cast<float>(m_currentTemperatureFiltered),
+            static_cast<float>(m_currentHumidity), static_cast<float>(m_currentHumidityFiltered),
+            static_cast<float>(m_currentPressure), static_cast<float>(m_currentPressureFiltered),
+            static_cast<float>(m_currentLux), static_cast<float>(m_currentLuxFiltered),
+            static_cast<float>(m_currentPpm), static_cast<float>(m_currentPpmFiltered)
+        };
+
+        if (!m_sensorLog->append(QDateTime::currentMSecsSinceEpoch(), values)) {
+            qCWarning(dcSensorStation()) << "Could not write logfile" << m_sensorLog->errorString();
+        }
+
+        // Note: one row per publish, make it visible for copying the log right away
+        m_sensorLog->flush();
+    }
+}
+
+double AirQualityMonitor::altitude() const
+{
+    return m_altitude;
+}
+
+bool AirQualityMonitor::airQualityStreamingEnabled() const
+{
+    return m_airQualityStreaming;
+}
+
+void AirQualityMonitor::setAirQualityStreamingEnabled(bool enabled)
+{
+    if (m_airQualityStreaming == enabled)
+        return;
+
+    qCDebug(dcSensorStation()) << "MQ-135 streaming" << (enabled ? "enabled" : "disabled");
+    m_airQualityStreaming = enabled;
+
+    // Note: the average keeps covering 60 s with the higher sample rate
+    int sampleRate = enabled ? ADS1115::streamingSampleRate() : FilterConfiguration::singleShotSampleRate;
+    FilterConfiguration::apply(m_airQualityFilter, FilterConfiguration::monitorFilters(sampleRate).value("ppm"));
+    m_airQualityFilter->reset();
+
+    if (m_adc) {
+        m_adc->setSamplesPerWindow(windowSamples(ChipDiscovery::ChipADS1115));
+        m_adc->setStreamingEnabled(enabled, ADS1115::Channel1);
+    }
+}
+
+void AirQualityMonitor::setAltitude(double altitude)
+{
+    m_altitude = altitude;
+}
+
+SensorDataFilter *AirQualityMonitor::createFilter(const FilterConfiguration::Filter &configuration)
+{
+    SensorDataFilter *filter = new SensorDataFilter(configuration.type, this);
+    FilterConfiguration::apply(filter, configuration);
+    return filter;
+}
+
+int AirQualityMonitor::windowSamples(ChipDiscovery::Chip chip) const
+{
+    // Duty cycle: a window has to fill the largest filter of the chip, otherwise every publish mixes in old windows
+    QList<SensorDataFilter *> chipFilters;
+    switch (chip) {
+    case ChipDiscovery::ChipSHT30:
+        chipFilters << m_temperatureFilter << m_humidityFilter;
+        break;
+    case ChipDiscovery::ChipBMP180:
+        chipFilters << m_pressureFilter;
+        break;
+    case ChipDiscovery::ChipTSL2561:
+        chipFilters << m_lightFilter;
+        break;
+    case ChipDiscovery::ChipADS1115:
+        chipFilters << m_airQualityFilter;
+        break;
+    default:
+        break;
+    }
+
+    uint samples = 1;
+    foreach (SensorDataFilter *filter, chipFilters) {
+        samples = qMax(samples, filter->windowSize());
+    }
+    return static_cast<int>(samples);
+}
+
+QList<SensorThread *> AirQualityMonitor::sensors() const
+{
+    // Only the chips found on the bus
+    QList<SensorThread *> sensorList;
+    if (m_temperatureHumiditySensor)
+        sensorList << m_temperatureHumiditySensor;
+
+    if (m_pressureSensor)
+        sensorList << m_pressureSensor;
+
+    if (m_lightSensor)
+        sensorList << m_lightSensor;
+
+    if (m_adc)
+        sensorList << m_adc;
+
+    return sensorList;
+}
+
+QHash<QString, SensorDataFilter *> AirQualityMonitor::filters() const
+{
+    QHash<QString, SensorDataFilter *> filterHash;
+    if (m_adc)
+        filterHash.insert("co2", m_airQualityFilter);
+
+    if (m_temperatureHumiditySensor) {
+        filterHash.insert("temperature", m_temperatureFilter);
+        filterHash.insert("humidity", m_humidityFilter);
+    }
+
+    if (m_pressureSensor)
+        filterHash.insert("pressure", m_pressureFilter);
+
+    if (m_lightSensor)
+        filterHash.insert("lightIntensity", m_lightFilter);
+
+    return filterHash;
+}
+
+void AirQualityMonitor::onWakeUpTimeout()
+{
+    qCDebug(dcSensorStation()) << "Wake up sensors for the next publish window";
+    foreach (SensorThread *sensor, sensors()) {
+        sensor->wakeUp();
+    }
+}
+
+void AirQualityMonitor::processSamples()
+{
+    // Feed every raw sample collected since the last call through the filters.
+    // Note: the SHT30 gets drained first, so the MQ-135 ppm calculation uses the latest temperature and humidity.
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    // SHT30
+    int temperatureHumiditySamples = 0;
+    if (m_temperatureHumiditySensor) {
+        temperatureHumiditySamples = m_temperatureHumiditySensor->consumeSamples([this](const SHT30::Sample &sample) {
+            m_currentTemperature = sample.temperature;
+            m_currentTemperatureFiltered = m_temperatureFilter->filterValue(sample.temperature);
+            m_currentHumidity = sample.humidity;
+            m_currentHumidityFiltered = m_humidityFilter->filterValue(sample.humidity);
+            addHistoryValue(sensorStationTemperatureStateTypeId, sample.timestamp, sample.temperature);
+            addHistoryValue(sensorStationHumidityStateTypeId, sample.timestamp, sample.humidity);
+        });
+    }
 
     // BMP180
-    double currentPressure = m_pressureSensor->currentPressureValue();
-    double currentPressureFiltered = m_pressureFilter->filterValue(currentPressure);
+    int pressureSamples = 0;
+    if (m_pressureSensor) {
+        pressureSamples = m_pressureSensor->consumeSamples([this](const BMP180::Sample &sample) {
+            m_currentPressure = sample.pressure;
+            m_currentPressureFiltered = m_pressureFilter->filterValue(sample.pressure);
+            m_pressureTendency.addValue(sample.timestamp, m_currentPressureFiltered);
+            addHistoryValue(sensorStationPressureStateTypeId, sample.timestamp, sample.pressure);
+        });
+    }
 
     // TSL2561
-    double currentLux = m_lightSensor->currentLux();
-    double currentLuxFiltered = m_lightFilter->filterValue(currentLux);
+    int lightSamples = 0;
+    if (m_lightSensor) {
+        lightSamples = m_lightSensor->consumeSamples([this](const TSL2561::Sample &sample) {
+            m_currentLux = sample.lux;
+            m_currentLuxFiltered = m_lightFilter->filterValue(sample.lux);
+            addHistoryValue(sensorStationLightIntensityStateTypeId, sample.timestamp, sample.lux);
+        });
+    }
 
     // CO2 ppm
-    m_airQualitySensor->setTemperature(currentTemperature);
-    m_airQualitySensor->setHumidity(currentHumidity);
-    m_airQualitySensor->setAdcValue(m_adc->getChannelValue(ADS1115::Channel1));
-    double currentPpm = m_airQualitySensor->calculatePpmValue();
-    double currentPpmFiltered = m_airQualityFilter->filterValue(currentPpm);
-
-    qCDebug(dcSensorStation()) << "Air quality value" << m_adc->getChannelValue(ADS1115::Channel1) << m_airQualitySensor->getCalibrationRestistance() << "Ohm" << m_adc->getChannelVoltage(ADS1115::Channel1) << "V" << currentPpm << "ppm";
-    qCDebug(dcSensorStation()) << "Temperature" << currentTemperature << "[°C]" << "| Humidity" << currentHumidity << "[%]";
-    qCDebug(dcSensorStation()) << "Pressure" << currentPressure << "[hPa]";
-    qCDebug(dcSensorStation()) << "Light intensity" << currentLux << "[lux]";
-
-    m_device->setStateValue(sensorStationCo2StateTypeId, roundValue(currentPpmFiltered));
-    m_device->setStateValue(sensorStationTemperatureStateTypeId, roundValue(currentTemperatureFiltered));
-    m_device->setStateValue(sensorStationHumidityStateTypeId, roundValue(currentHumidityFiltered));
-    m_device->setStateValue(sensorStationPressureStateTypeId, roundValue(currentPressureFiltered));
-    m_device->setStateValue(sensorStationLightIntensityStateTypeId, roundValue(currentLuxFiltered));
-
-    // Write logfile for filter verification
-    if (m_logfile->isOpen()) {
-        QTextStream textStream(m_logfile);
-        textStream << QDateTime::currentDateTime().toTime_t() << " "
-                   << currentTemperature << " " << currentTemperatureFiltered << " "
-                   << currentHumidity << " " << currentHumidityFiltered << " "
-                   << currentPressure << " " << currentPressureFiltered << " "
-                   << currentLux << " " << currentLuxFiltered << " "
-                   << currentPpm << " " << currentPpmFiltered << " "
-                   << endl;
+    int airQualitySamples = 0;
+    if (m_adc) {
+        // Without SHT30 readings the MQ-135 keeps its default correction (22 °C, 50 %)
+        if (m_temperatureHumiditySensor && (temperatureHumiditySamples > 0 || m_lastSampleTimestamps.contains(ChipDiscovery::ChipSHT30))) {
+            m_airQualitySensor->setTemperature(m_currentTemperature);
+            m_airQualitySensor->setHumidity(m_currentHumidity);
+        }
+
+        // Note: the baseline gets the average RZero of the batch, single noisy samples must not become the maximum
+        double rZeroSum = 0;
+        int rZeroSamples = 0;
+        qint64 lastTimestamp = 0;
+        airQualitySamples = m_adc->consumeSamples([this, &rZeroSum, &rZeroSamples, &lastTimestamp](const ADS1115::Sample &sample) {
+            m_currentAirQualityAdcValue = sample.channelValues[ADS1115::Channel1];
+            m_airQualitySensor->setAdcValue(m_currentAirQualityAdcValue);
+            m_currentPpm = m_airQualitySensor->calculatePpmValue();
+            m_currentPpmFiltered = m_airQualityFilter->filterValue(m_currentPpm);
+
+            // The history keeps the single shot resolution, the streaming samples would shorten the raw tier
+            if (!m_airQualityStreaming || sample.timestamp - m_airQualityHistoryTimestamp >= 500) {
+                addHistoryValue(sensorStationCo2StateTypeId, sample.timestamp, m_currentPpm);
+                m_airQualityHistoryTimestamp = sample.timestamp;
+            }
+
+            if (m_currentAirQualityAdcValue > 0) {
+                rZeroSum += m_airQualitySensor->getCorrectedRZero();
+                rZeroSamples++;
+            }
+
+            lastTimestamp = sample.timestamp;
+        });
+
+        // Only while the temperature and humidity correction is valid
+        if (m_baselineEnabled && rZeroSamples > 0 && m_temperatureHumiditySensor && m_temperatureFilter->isReady()) {
+            double rZero = rZeroSum / rZeroSamples;
+            if (rZero > MQ135::defaultRZero() / 20 && rZero < MQ135::defaultRZero() * 20) {
+                m_baseline.addValue(lastTimestamp, rZero);
+                updateBaseline();
+            }
+        }
+    }
+
+    if (temperatureHumiditySamples > 0)
+        m_lastSampleTimestamps.insert(ChipDiscovery::ChipSHT30, now);
+
+    if (pressureSamples > 0)
+        m_lastSampleTimestamps.insert(ChipDiscovery::ChipBMP180, now);
+
+    if (lightSamples > 0)
+        m_lastSampleTimestamps.insert(ChipDiscovery::ChipTSL2561, now);
+
+    if (airQualitySamples > 0)
+        m_lastSampleTimestamps.insert(ChipDiscovery::ChipADS1115, now);
+
+    qCDebug(dcSensorStation()) << "Processed samples: SHT30" << temperatureHumiditySamples << "| BMP180" << pressureSamples << "| TSL2561" << lightSamples << "| ADS1115" << airQualitySamples;
+}
+
+void AirQualityMonitor::updateBaseline()
+{
+    // The sensor needs at least one day (or the whole window) to see clean air once
+    qint64 minimumCoverage = qMin<qint64>(m_baseline.window(), 24 * 3600 * 1000);
+    if (m_baseline.isEmpty() || m_baseline.coverage() < minimumCoverage)
+        return;
+
+    m_airQualitySensor->setRZero(m_baseline.maximum());
+}
+
+void AirQualityMonitor::addHistoryValue(const StateTypeId &stateTypeId, qint64 timestamp, double value)
+{
+    HistoryStore *store = m_historyStores.value(stateTypeId);
+    if (store) {
+        store->addValue(timestamp, value);
+    }
+}
+
+void AirQualityMonitor::updateStates(bool periodic)
+{
+    // Note: states of missing chips keep their default value
+    qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+    if (m_adc)
+        m_statePublishers.value(sensorStationCo2StateTypeId)->update(m_currentPpmFiltered, timestamp, periodic);
+
+    if (m_temperatureHumiditySensor) {
+        m_statePublishers.value(sensorStationTemperatureStateTypeId)->update(m_currentTemperatureFiltered, timestamp, periodic);
+        m_statePublishers.value(sensorStationHumidityStateTypeId)->update(m_currentHumidityFiltered, timestamp, periodic);
+    }
+
+    if (m_pressureSensor)
+        m_statePublishers.value(sensorStationPressureStateTypeId)->update(m_currentPressureFiltered, timestamp, periodic);
+
+    if (m_lightSensor)
+        m_statePublishers.value(sensorStationLightIntensityStateTypeId)->update(m_currentLuxFiltered, timestamp, periodic);
+
+    updateDerivedStates(timestamp, periodic);
+}
+
+void AirQualityMonitor::updateDerivedStates(qint64 timestamp, bool periodic)
+{
+    // Note: calculated from the latest filtered values, constant cost per update
+    if (m_temperatureHumiditySensor) {
+        m_statePublishers.value(sensorStationDewPointStateTypeId)->update(DerivedValues::dewPoint(m_currentTemperatureFiltered, m_currentHumidityFiltered), timestamp, periodic);
+        m_statePublishers.value(sensorStationAbsoluteHumidityStateTypeId)->update(DerivedValues::absoluteHumidity(m_currentTemperatureFiltered, m_currentHumidityFiltered), timestamp, periodic);
+        m_statePublishers.value(sensorStationHeatIndexStateTypeId)->update(DerivedValues::heatIndex(m_currentTemperatureFiltered, m_currentHumidityFiltered), timestamp, periodic);
+    }
+
+    if (m_pressureSensor) {
+        // Without the SHT30 the standard atmosphere temperature gets used
+        double temperature = m_temperatureHumiditySensor && m_temperatureFilter->isReady() ? m_currentTemperatureFiltered : 15.0;
+        m_statePublishers.value(sensorStationSeaLevelPressureStateTypeId)->update(DerivedValues::seaLevelPressure(m_currentPressureFiltered, m_altitude, temperature), timestamp, periodic);
+
+        if (m_pressureTendency.isValid()) {
+            m_statePublishers.value(sensorStationPressureTendencyStateTypeId)->update(m_pressureTendency.tendency(), timestamp, periodic);
+        }
+    }
+}
+
+void AirQualityMonitor::onStartupTimeout()
+{
+    evaluate();
+
+    // Evaluate quickly until every state of the chips found on the bus has a value.
+    // Note: a sensor without samples must not keep the fast evaluation running, the 10 s evaluation takes over after one minute.
+    QList<StateTypeId> stateTypeIds;
+    if (m_adc)
+        stateTypeIds << sensorStationCo2StateTypeId;
+
+    if (m_temperatureHumiditySensor)
+        stateTypeIds << sensorStationTemperatureStateTypeId << sensorStationHumidityStateTypeId;
+
+    if (m_pressureSensor)
+        stateTypeIds << sensorStationPressureStateTypeId;
+
+    if (m_lightSensor)
+        stateTypeIds << sensorStationLightIntensityStateTypeId;
+
+    m_startupEvaluations++;
+    foreach (const StateTypeId &stateTypeId, stateTypeIds) {
+        if (!m_statePublishers.value(stateTypeId)->isPublished() && m_startupEvaluations < 120) {
+            return;
+        }
+    }
+
+    qCDebug(dcSensorStation()) << "Initial values published after" << m_startupEvaluations * m_startupTimer->interval() << "ms";
+    m_startupTimer->stop();
+}
+
+void AirQualityMonitor::evaluate()
+{
+    processSamples();
+    updateAvailability();
+    updateStates(false);
+
+    // A sensor thread gave up (e.g. the bus could not be opened), start probing again
+    if (m_enabled && !m_probeTimer->isActive() && missingChips() != ChipDiscovery::ChipNone) {
+        scheduleProbe(true);
     }
 }
+
+void AirQualityMonitor::onProbeTimeout()
+{
+    ChipDiscovery::Chips missing = missingChips();
+    if (missing == ChipDiscovery::ChipNone || m_probeWatcher->isRunning())
+        return;
+
+    // Note: only the chip IDs of the missing chips get read, the running sensors are not touched
+    m_probeWatcher->setFuture(QtConcurrent::run(&ChipDiscovery::discover, m_i2cPortName, m_addresses, m_muxAddress, m_muxChannel, missing));
+}
+
+void AirQualityMonitor::onProbeFinished()
+{
+    // The station could have been disabled while the probe was running
+    if (!m_enabled)
+        return;
+
+    ChipDiscovery::Chips found = m_probeWatcher->result() & missingChips();
+    bool created = false;
+    foreach (ChipDiscovery::Chip chip, supportedChips()) {
+        if (!found.testFlag(chip))
+            continue;
+
+        SensorThread *chipSensor = sensor(chip);
+        if (!chipSensor) {
+            chipSensor = createSensor(chip);
+            m_chips |= chip;
+            created = true;
+        }
+
+        // The sensor head could have been replaced, the cached calibration belongs to the old chip
+        if (chip == ChipDiscovery::ChipBMP180)
+            m_pressureSensor->invalidateCalibration();
+
+        qCDebug(dcSensorStation()) << qPrintable(chipSensor->sensorName() + ":") << "Chip appeared on" << m_i2cPortName << "starting measurements";
+        chipSensor->enable();
+    }
+
+    if (created) {
+        openHistoryStores();
+
+        // The capture writer only knows the sensors it has been created with
+        if (captureEnabled()) {
+            setCaptureEnabled(false);
+            setCaptureEnabled(true);
+        }
+
+        emit chipsChanged(m_chips);
+    }
+
+    if (found != ChipDiscovery::ChipNone) {
+        m_startupEvaluations = 0;
+        m_startupTimer->start();
+    }
+
+    scheduleProbe(found != ChipDiscovery::ChipNone);
+}
+
+SensorThread *AirQualityMonitor::createSensor(ChipDiscovery::Chip chip)
+{
+    SensorThread *chipSensor = nullptr;
+    switch (chip) {
+    case ChipDiscovery::ChipSHT30:
+        m_temperatureHumiditySensor = new SHT30(m_i2cPortName, m_addresses.sht30, this);
+        chipSensor = m_temperatureHumiditySensor;
+        break;
+    case ChipDiscovery::ChipBMP180:
+        m_pressureSensor = new BMP180(m_i2cPortName, m_addresses.bmp180, this);
+        chipSensor = m_pressureSensor;
+        break;
+    case ChipDiscovery::ChipTSL2561:
+        m_lightSensor = new TSL2561(m_i2cPortName, m_addresses.tsl2561, this);
+        chipSensor = m_lightSensor;
+        break;
+    case ChipDiscovery::ChipADS1115:
+        m_adc = new ADS1115(m_i2cPortName, m_addresses.ads1115, this);
+        m_adc->setStreamingEnabled(m_airQualityStreaming, ADS1115::Channel1);
+        chipSensor = m_adc;
+        break;
+    default:
+        return nullptr;
+    }
+
+    // Note: sensors created later must get the current configuration
+    if (m_muxAddress > 0)
+        chipSensor->setMultiplexer(m_muxAddress, m_muxChannel);
+
+    chipSensor->setSchedulingConfiguration(m_schedulingConfiguration);
+    chipSensor->setSamplesPerWindow(windowSamples(chip));
+    chipSensor->setDutyCycleEnabled(m_dutyCycleEnabled);
+    return chipSensor;
+}
+
+SensorThread *AirQualityMonitor::sensor(ChipDiscovery::Chip chip) const
+{
+    switch (chip) {
+    case ChipDiscovery::ChipSHT30:
+        return m_temperatureHumiditySensor;
+    case ChipDiscovery::ChipBMP180:
+        return m_pressureSensor;
+    case ChipDiscovery::ChipTSL2561:
+        return m_lightSensor;
+    case ChipDiscovery::ChipADS1115:
+        return m_adc;
+    default:
+        return nullptr;
+    }
+}
+
+ChipDiscovery::Chips AirQualityMonitor::missingChips() const
+{
+    ChipDiscovery::Chips missing = ChipDiscovery::ChipNone;
+    foreach (ChipDiscovery::Chip chip, supportedChips()) {
+        SensorThread *chipSensor = sensor(chip);
+        if (!chipSensor || !chipSensor->isRunning()) {
+            missing |= chip;
+        }
+    }
+    return missing;
+}
+
+void AirQualityMonitor::scheduleProbe(bool reset)
+{
+    if (!m_enabled || missingChips() == ChipDiscovery::ChipNone) {
+        m_probeTimer->stop();
+        return;
+    }
+
+    // Exponential backoff, a chip that is not mounted at all costs one chip ID read every 10 minutes
+    m_probeInterval = reset ? 10 : qMin(m_probeInterval * 2, 600);
+    m_probeTimer->start(m_probeInterval * 1000);
+}
+
+void AirQualityMonitor::updateAvailability()
+{
+    // A chip is available while its thread is running and delivers samples
+    // Note: in duty cycle mode the sensors only sample shortly before each publish
+    qint64 timeout = (m_dutyCycleEnabled ? m_publishInterval + 60 : 60) * 1000LL;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    ChipDiscovery::Chips available = ChipDiscovery::ChipNone;
+    foreach (ChipDiscovery::Chip chip, supportedChips()) {
+        SensorThread *chipSensor = sensor(chip);
+        if (m_enabled && chipSensor && chipSensor->isRunning() && now - m_lastSampleTimestamps.value(chip, 0) < timeout) {
+            available |= chip;
+        }
+    }
+
+    if (available == m_availableChips)
+        return;
+
+    m_availableChips = available;
+    qCDebug(dcSensorStation()) << "Available chips:"
+                               << "SHT30" << available.testFlag(ChipDiscovery::ChipSHT30)
+                               << "| BMP180" << available.testFlag(ChipDiscovery::ChipBMP180)
+                               << "| TSL2561" << available.testFlag(ChipDiscovery::ChipTSL2561)
+                               << "| ADS1115" << available.testFlag(ChipDiscovery::ChipADS1115);
+
+    publishAvailability();
+}
+
+void AirQualityMonitor::publishAvailability()
+{
+    m_device->setStateValue(sensorStationSht30AvailableStateTypeId, m_availableChips.testFlag(ChipDiscovery::ChipSHT30));
+    m_device->setStateValue(sensorStationBmp180AvailableStateTypeId, m_availableChips.testFlag(ChipDiscovery::ChipBMP180));
+    m_device->setStateValue(sensorStationTsl2561AvailableStateTypeId, m_availableChips.testFlag(ChipDiscovery::ChipTSL2561));
+    m_device->setStateValue(sensorStationAds1115AvailableStateTypeId, m_availableChips.testFlag(ChipDiscovery::ChipADS1115));
+    m_device->setStateValue(sensorStationConnectedStateTypeId, m_availableChips != ChipDiscovery::ChipNone);
+}
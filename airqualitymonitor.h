@@ -23,8 +23,9 @@
 #ifndef AIRQUALITYMONITOR_H
 #define AIRQUALITYMONITOR_H
 
-#include <QFile>
+#include <QTimer>
 #include <QObject>
+#include <QFutureWatcher>
 
 #include "plugin/device.h"
 #include "sensors/mq135.h"
@@ -33,25 +34,109 @@
 #include "sensors/bmp180.h"
 #include "sensors/tsl2561.h"
 
+#include "chipdiscovery.h"
+#include "capturewriter.h"
+#include "derivedvalues.h"
+#include "filterconfiguration.h"
+#include "historystore.h"
+#include "pressuretendency.h"
+#include "rollingmaximum.h"
 #include "sensordatafilter.h"
+#include "sensorlogwriter.h"
+#include "statepublisher.h"
 
 class AirQualityMonitor : public QObject
 {
     Q_OBJECT
 public:
-    explicit AirQualityMonitor(Device *device, QObject *parent = nullptr);
-    ~AirQualityMonitor();
+    explicit AirQualityMonitor(Device *device, ChipDiscovery::Chips chips = ChipDiscovery::ChipAll, QObject *parent = nullptr);
+    ~AirQualityMonitor() override;
 
     Device *device() const;
+    ChipDiscovery::Chips chips() const;
+
+    // Chips delivering samples right now
+    ChipDiscovery::Chips availableChips() const;
+
+    static ChipDiscovery::Addresses configuredAddresses(Device *device);
+
+    QString i2cPortName() const;
+    QList<int> i2cAddresses() const;
+    int muxAddress() const;
+    int muxChannel() const;
+
+    void setSchedulingConfiguration(const SensorThread::SchedulingConfiguration &configuration);
+
+    int publishInterval() const;
+    void setPublishInterval(int publishInterval);
+
+    bool dutyCycleEnabled() const;
+    void setDutyCycleEnabled(bool enabled);
+
+    // Raw and filtered values of every publish into /tmp/sensordata-<deviceId>.slog, for the gnuplot scripts
+    bool sensorLogEnabled() const;
+    void setSensorLogEnabled(bool enabled);
+
+    // Raw capture of every sensor reading into /tmp/sensorcapture-<deviceId>-<sensor>.slog
+    bool captureEnabled() const;
+    void setCaptureEnabled(bool enabled);
+    void setCaptureSyncPolicy(CaptureWriter::SyncPolicy syncPolicy, int syncInterval);
+
+    // Long term history of the raw values, one store per state
+    void setHistoryDirectory(const QString &directory);
+    QString queryHistory(const StateTypeId &stateTypeId, qint64 from, qint64 to, int maxPoints) const;
+
+    // Automatic MQ-135 baseline: the cleanest air within the window counts as atmospheric CO2
+    void setBaselineCalibration(bool enabled, int windowDays);
+    double rZero() const;
+    QVariantMap baselineState() const;
+    void restoreBaselineState(const QVariantMap &state);
+
+    // MQ-135 channel of the ADS1115 in the streaming mode instead of single shot conversions
+    bool airQualityStreamingEnabled() const;
+    void setAirQualityStreamingEnabled(bool enabled);
+
+    // Altitude of the station for the sea level pressure [m]
+    double altitude() const;
+    void setAltitude(double altitude);
+
+    // Drivers and filters of the chips found on the bus
+    QList<SensorThread *> sensors() const;
+    QHash<QString, SensorDataFilter *> filters() const;
+
+    // Deadband and rate of change (per minute) trigger of a published state
+    void setPublishThresholds(const StateTypeId &stateTypeId, double deadband, double rateThreshold);
 
 private:
     Device *m_device = nullptr;
+    ChipDiscovery::Chips m_chips = ChipDiscovery::ChipNone;
     bool m_writeLogs = false;
+    bool m_enabled = false;
+
+    QString m_i2cPortName;
+    ChipDiscovery::Addresses m_addresses;
+    QList<int> m_i2cAddresses;
+    int m_muxAddress = -1;
+    int m_muxChannel = 0;
+    SensorThread::SchedulingConfiguration m_schedulingConfiguration;
+
+    // Availability and re-probing of missing chips
+    ChipDiscovery::Chips m_availableChips = ChipDiscovery::ChipNone;
+    QHash<int, qint64> m_lastSampleTimestamps;
+    QTimer *m_probeTimer = nullptr;
+    QFutureWatcher<ChipDiscovery::Chips> *m_probeWatcher = nullptr;
+    int m_probeInterval = 10;
 
     ADS1115 *m_adc = nullptr;
 
     MQ135 *m_airQualitySensor = nullptr;
     SensorDataFilter *m_airQualityFilter = nullptr;
+    bool m_airQualityStreaming = false;
+    qint64 m_airQualityHistoryTimestamp = 0;
+
+    // Baseline calibration
+    bool m_baselineEnabled = false;
+    RollingMaximum m_baseline;
 
     SHT30 *m_temperatureHumiditySensor = nullptr;
     SensorDataFilter *m_temperatureFilter = nullptr;
@@ -63,9 +148,70 @@ private:
     TSL2561 *m_lightSensor = nullptr;
     SensorDataFilter *m_lightFilter = nullptr;
 
-    QFile *m_logfile = nullptr;
-
-    double roundValue(double value);
+    SensorLogWriter *m_sensorLog = nullptr;
+
+    // Duty cycle
+    int m_publishInterval = 300;
+    bool m_dutyCycleEnabled = false;
+    QTimer *m_wakeUpTimer = nullptr;
+
+    // Raw capture
+    CaptureWriter *m_captureWriter = nullptr;
+    CaptureWriter::SyncPolicy m_captureSyncPolicy = CaptureWriter::SyncPolicyPeriodic;
+    int m_captureSyncInterval = 10;
+
+    // History
+    QString m_historyDirectory;
+    QHash<StateTypeId, HistoryStore *> m_historyStores;
+
+    // Derived values
+    double m_altitude = 0;
+    PressureTendency m_pressureTendency;
+
+    // Publishing
+    QTimer *m_evaluationTimer = nullptr;
+    QTimer *m_startupTimer = nullptr;
+    int m_startupEvaluations = 0;
+    QHash<StateTypeId, StatePublisher *> m_statePublishers;
+
+    // Latest raw and filtered values
+    double m_currentTemperature = 0;
+    double m_currentTemperatureFiltered = 0;
+    double m_currentHumidity = 0;
+    double m_currentHumidityFiltered = 0;
+    double m_currentPressure = 0;
+    double m_currentPressureFiltered = 0;
+    double m_currentLux = 0;
+    double m_currentLuxFiltered = 0;
+    int m_currentAirQualityAdcValue = 0;
+    double m_currentPpm = 0;
+    double m_currentPpmFiltered = 0;
+
+    SensorThread *createSensor(ChipDiscovery::Chip chip);
+    SensorThread *sensor(ChipDiscovery::Chip chip) const;
+    int windowSamples(ChipDiscovery::Chip chip) const;
+    ChipDiscovery::Chips missingChips() const;
+    void scheduleProbe(bool reset);
+    void updateAvailability();
+    void publishAvailability();
+
+    void processSamples();
+    void updateBaseline();
+    SensorDataFilter *createFilter(const FilterConfiguration::Filter &configuration);
+    void openHistoryStores();
+    void addHistoryValue(const StateTypeId &stateTypeId, qint64 timestamp, double value);
+    void updateStates(bool periodic);
+    void updateDerivedStates(qint64 timestamp, bool periodic);
+
+signals:
+    void chipsChanged(ChipDiscovery::Chips chips);
+
+private slots:
+    void onWakeUpTimeout();
+    void onStartupTimeout();
+    void onProbeTimeout();
+    void onProbeFinished();
+    void evaluate();
 
 public slots:
     void enable();
@@ -0,0 +1,178 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "capturewriter.h"
+#include "sensorlogwriter.h"
+#include "extern-plugininfo.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+CaptureWriter::CaptureWriter(const QString &filePrefix, const QList<SensorThread *> &sensors, QObject *parent) :
+    QThread(parent),
+    m_filePrefix(filePrefix),
+    m_sensors(sensors)
+{
+
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    stop();
+    wait();
+}
+
+QString CaptureWriter::filePrefix() const
+{
+    return m_filePrefix;
+}
+
+CaptureWriter::SyncPolicy CaptureWriter::syncPolicy()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_syncPolicy;
+}
+
+int CaptureWriter::syncInterval()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_syncInterval;
+}
+
+void CaptureWriter::setSyncPolicy(CaptureWriter::SyncPolicy syncPolicy, int syncInterval)
+{
+    QMutexLocker locker(&m_mutex);
+    m_syncPolicy = syncPolicy;
+    m_syncInterval = qMax(1, syncInterval);
+}
+
+int CaptureWriter::batchInterval()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_batchInterval;
+}
+
+void CaptureWriter::setBatchInterval(int batchInterval)
+{
+    QMutexLocker locker(&m_mutex);
+    m_batchInterval = qMax(10, batchInterval);
+}
+
+quint64 CaptureWriter::writtenSamples() const
+{
+    return m_writtenSamples.load(std::memory_order_relaxed);
+}
+
+quint64 CaptureWriter::droppedSamples() const
+{
+    quint64 dropped = 0;
+    foreach (SensorThread *sensor, m_sensors) {
+        dropped += sensor->droppedCaptureSamples();
+    }
+    return dropped;
+}
+
+CaptureWriter::SyncPolicy CaptureWriter::parseSyncPolicy(const QString &syncPolicy)
+{
+    if (syncPolicy == "none")
+        return SyncPolicyNone;
+
+    if (syncPolicy == "batch")
+        return SyncPolicyEveryBatch;
+
+    return SyncPolicyPeriodic;
+}
+
+void CaptureWriter::stop()
+{
+    QMutexLocker locker(&m_mutex);
+    m_stop = true;
+    m_stopCondition.wakeAll();
+}
+
+void CaptureWriter::run()
+{
+    // One log per sensor, the columns are the capture columns of the sensor
+    QList<SensorLogWriter *> logs;
+    foreach (SensorThread *sensor, m_sensors) {
+        SensorLogWriter *log = new SensorLogWriter(QString("%1-%2.slog").arg(m_filePrefix).arg(sensor->sensorName().toLower()), sensor->captureColumns());
+        log->setMaximumSize(64 * 1024 * 1024);
+        log->setBufferSize(256 * 1024);
+        if (!log->open()) {
+            qCWarning(dcSensorStation()) << "Capture: could not open" << log->fileName() << log->errorString();
+        } else {
+            qCDebug(dcSensorStation()) << "Capture: writing raw samples of" << sensor->sensorName() << "into" << log->fileName();
+        }
+        logs.append(log);
+    }
+
+    QElapsedTimer syncTimer;
+    syncTimer.start();
+
+    bool stopRequested = false;
+    while (!stopRequested) {
+        SyncPolicy syncPolicy;
+        int syncInterval;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (!m_stop)
+                m_stopCondition.wait(&m_mutex, static_cast<unsigned long>(m_batchInterval));
+
+            // Note: drain the queues one last time after stop
+            stopRequested = m_stop;
+            syncPolicy = m_syncPolicy;
+            syncInterval = m_syncInterval;
+        }
+
+        quint64 written = 0;
+        for (int i = 0; i < m_sensors.count(); i++) {
+            // Note: the log writes its buffer when it is full, on rotation, on sync and when it gets closed
+            SensorLogWriter *log = logs.at(i);
+            bool failed = false;
+            written += static_cast<quint64>(m_sensors.at(i)->consumeCaptureSamples([log, &failed](const SensorThread::CaptureSample &sample) {
+                if (log->isOpen() && !log->append(sample.timestamp, sample.values)) {
+                    failed = true;
+                }
+            }));
+
+            if (failed) {
+                qCWarning(dcSensorStation()) << "Capture: could not write" << log->fileName() << log->errorString();
+            }
+        }
+
+        m_writtenSamples.fetch_add(written, std::memory_order_relaxed);
+
+        bool syncNow = stopRequested || syncPolicy == SyncPolicyEveryBatch
+                || (syncPolicy == SyncPolicyPeriodic && syncTimer.elapsed() >= syncInterval * 1000);
+        if (syncPolicy != SyncPolicyNone && syncNow) {
+            foreach (SensorLogWriter *log, logs) {
+                if (log->isOpen() && !log->sync()) {
+                    qCWarning(dcSensorStation()) << "Capture: could not sync" << log->fileName() << log->errorString();
+                }
+            }
+            syncTimer.restart();
+        }
+    }
+
+    qDeleteAll(logs);
+    qCDebug(dcSensorStation()) << "Capture: stopped after" << writtenSamples() << "samples," << droppedSamples() << "dropped";
+}
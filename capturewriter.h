@@ -0,0 +1,92 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef CAPTUREWRITER_H
+#define CAPTUREWRITER_H
+
+#include <atomic>
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "sensors/sensorthread.h"
+
+// Writes the raw capture of the sensor threads to disk.
+//
+// Every batch interval the writer drains the capture queues of all sensors
+// and appends the samples to one binary sensor log per sensor
+// (<prefix>-<sensor>.slog). Each log collects the records in its buffer and
+// only writes it when it is full, on rotation, on sync and on stop, so the disk
+// sees one large sequential write per 256 KiB. How often the data gets synced
+// to the disk is configurable with the sync policy.
+
+class CaptureWriter : public QThread
+{
+    Q_OBJECT
+public:
+    enum SyncPolicy {
+        SyncPolicyNone, // Leave it to the kernel
+        SyncPolicyPeriodic, // Every syncInterval() seconds
+        SyncPolicyEveryBatch
+    };
+    Q_ENUM(SyncPolicy)
+
+    explicit CaptureWriter(const QString &filePrefix, const QList<SensorThread *> &sensors, QObject *parent = nullptr);
+    ~CaptureWriter() override;
+
+    QString filePrefix() const;
+
+    SyncPolicy syncPolicy();
+    int syncInterval();
+    void setSyncPolicy(SyncPolicy syncPolicy, int syncInterval = 10);
+
+    int batchInterval();
+    void setBatchInterval(int batchInterval);
+
+    quint64 writtenSamples() const;
+    quint64 droppedSamples() const;
+
+    static SyncPolicy parseSyncPolicy(const QString &syncPolicy);
+
+protected:
+    void run() override;
+
+private:
+    QString m_filePrefix;
+    QList<SensorThread *> m_sensors;
+
+    QMutex m_mutex;
+    QWaitCondition m_stopCondition;
+    bool m_stop = false;
+    SyncPolicy m_syncPolicy = SyncPolicyPeriodic;
+    int m_syncInterval = 10;
+    int m_batchInterval = 250;
+
+    std::atomic<quint64> m_writtenSamples { 0 };
+
+public slots:
+    void stop();
+
+};
+
+#endif // CAPTUREWRITER_H
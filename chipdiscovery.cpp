@@ -0,0 +1,160 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "chipdiscovery.h"
+#include "i2cport.h"
+#include "extern-plugininfo.h"
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+#include <QMutexLocker>
+
+ChipDiscovery::Chips ChipDiscovery::discover(const QString &portName, const ChipDiscovery::Addresses &addresses, int muxAddress, int muxChannel, Chips requestedChips)
+{
+    qCDebug(dcSensorStation()) << "Discover chips on" << portName << (muxAddress > 0 ? QString("mux 0x%1 channel %2").arg(muxAddress, 0, 16).arg(muxChannel) : QString());
+
+    Chips chips = ChipNone;
+    I2CPort port(portName);
+    if (!port.openPort()) {
+        qCWarning(dcSensorStation()) << "Could not open" << port.portDeviceName() << "for discovering chips";
+        return chips;
+    }
+
+    // Note: scanning is only supported on arm. Behind a multiplexer the scan would also write the
+    // control register of the mux and deselect all channels, probe the expected addresses directly there.
+    // For a few chips probing the addresses directly is cheaper than scanning the whole bus.
+    // The scan talks to every address on the bus, stations behind a mux must not run in between.
+    QMutexLocker locker(I2CPort::busMutex(portName));
+    QList<int> foundAddresses;
+    if (muxAddress <= 0 && requestedChips == ChipAll) {
+        foundAddresses = port.scanRegirsters();
+        I2CPort::invalidateMultiplexerCache(portName);
+    }
+
+    bool scanned = !foundAddresses.isEmpty();
+    int fileDescriptor = port.deviceDescriptor();
+
+    if (muxAddress > 0 && !I2CPort::selectMultiplexerChannel(portName, fileDescriptor, muxAddress, muxChannel)) {
+        qCWarning(dcSensorStation()) << "Could not select the multiplexer channel for discovering chips";
+        locker.unlock();
+        port.closePort();
+        return chips;
+    }
+
+    if (requestedChips.testFlag(ChipSHT30) && (!scanned || foundAddresses.contains(addresses.sht30)) && probeSHT30(fileDescriptor, addresses.sht30))
+        chips |= ChipSHT30;
+
+    if (requestedChips.testFlag(ChipBMP180) && (!scanned || foundAddresses.contains(addresses.bmp180)) && probeBMP180(fileDescriptor, addresses.bmp180))
+        chips |= ChipBMP180;
+
+    if (requestedChips.testFlag(ChipTSL2561) && (!scanned || foundAddresses.contains(addresses.tsl2561)) && probeTSL2561(fileDescriptor, addresses.tsl2561))
+        chips |= ChipTSL2561;
+
+    if (requestedChips.testFlag(ChipADS1115) && (!scanned || foundAddresses.contains(addresses.ads1115)) && probeADS1115(fileDescriptor, addresses.ads1115))
+        chips |= ChipADS1115;
+
+    locker.unlock();
+    port.closePort();
+
+    qCDebug(dcSensorStation()) << "Discovered chips:"
+                               << "SHT30" << chips.testFlag(ChipSHT30)
+                               << "| BMP180" << chips.testFlag(ChipBMP180)
+                               << "| TSL2561" << chips.testFlag(ChipTSL2561)
+                               << "| ADS1115" << chips.testFlag(ChipADS1115);
+    return chips;
+}
+
+bool ChipDiscovery::probeSHT30(int fileDescriptor, int address)
+{
+    // Read status register (0xF32D): 2 bytes status + CRC
+    quint8 command[2] = {0xF3, 0x2D};
+    quint8 data[3] = {0};
+    if (!readRegister(fileDescriptor, address, command, 2, data, 3))
+        return false;
+
+    return crc8(data, 2) == data[2];
+}
+
+bool ChipDiscovery::probeBMP180(int fileDescriptor, int address)
+{
+    // Chip id register 0xD0 is always 0x55
+    quint8 command[1] = {0xD0};
+    quint8 data[1] = {0};
+    if (!readRegister(fileDescriptor, address, command, 1, data, 1))
+        return false;
+
+    return data[0] == 0x55;
+}
+
+bool ChipDiscovery::probeTSL2561(int fileDescriptor, int address)
+{
+    // ID register 0x0A (command bit 0x80), part number in the upper nibble: 0001 = TSL2561CS, 0101 = TSL2561T/FN/CL
+    quint8 command[1] = {0x8A};
+    quint8 data[1] = {0};
+    if (!readRegister(fileDescriptor, address, command, 1, data, 1))
+        return false;
+
+    quint8 partNumber = data[0] >> 4;
+    return partNumber == 0x01 || partNumber == 0x05;
+}
+
+bool ChipDiscovery::probeADS1115(int fileDescriptor, int address)
+{
+    // The ADS1115 has no ID register. The threshold registers are never written by the
+    // driver and keep their reset values: Lo_thresh (0x02) 0x8000, Hi_thresh (0x03) 0x7FFF
+    quint8 command[1] = {0x02};
+    quint8 data[2] = {0};
+    if (!readRegister(fileDescriptor, address, command, 1, data, 2) || data[0] != 0x80 || data[1] != 0x00)
+        return false;
+
+    command[0] = 0x03;
+    if (!readRegister(fileDescriptor, address, command, 1, data, 2))
+        return false;
+
+    return data[0] == 0x7F && data[1] == 0xFF;
+}
+
+quint8 ChipDiscovery::crc8(const quint8 *data, int length)
+{
+    // Sensirion CRC-8: polynomial 0x31, init 0xFF
+    quint8 crc = 0xFF;
+    for (int i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? static_cast<quint8>((crc << 1) ^ 0x31) : static_cast<quint8>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+bool ChipDiscovery::readRegister(int fileDescriptor, int address, const quint8 *command, int commandLength, quint8 *data, int dataLength)
+{
+    if (ioctl(fileDescriptor, I2C_SLAVE, address) < 0)
+        return false;
+
+    if (write(fileDescriptor, command, static_cast<size_t>(commandLength)) != commandLength)
+        return false;
+
+    return read(fileDescriptor, data, static_cast<size_t>(dataLength)) == dataLength;
+}
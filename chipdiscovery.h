@@ -0,0 +1,74 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef CHIPDISCOVERY_H
+#define CHIPDISCOVERY_H
+
+#include <QFlags>
+#include <QString>
+
+// Finds out which of the supported chips are actually present on a bus.
+//
+// The bus gets scanned using I2CPort::scanRegirsters() and each expected address
+// gets verified by reading the chip ID (or a register with a known reset value).
+// Only the chips found here get a reading thread.
+//
+// Re-probing a few missing chips skips the bus scan and only reads the
+// chip IDs of the requested addresses.
+
+class ChipDiscovery
+{
+public:
+    enum Chip {
+        ChipNone = 0x00,
+        ChipSHT30 = 0x01,
+        ChipBMP180 = 0x02,
+        ChipTSL2561 = 0x04,
+        ChipADS1115 = 0x08,
+        ChipAll = 0x0F
+    };
+    Q_DECLARE_FLAGS(Chips, Chip)
+
+    struct Addresses {
+        int sht30 = 0x44;
+        int bmp180 = 0x77;
+        int tsl2561 = 0x39;
+        int ads1115 = 0x48;
+    };
+
+    static Chips discover(const QString &portName, const Addresses &addresses, int muxAddress = -1, int muxChannel = 0, Chips requestedChips = ChipAll);
+
+    // Chip ID probes, the file descriptor must be open and the bus locked
+    static bool probeSHT30(int fileDescriptor, int address);
+    static bool probeBMP180(int fileDescriptor, int address);
+    static bool probeTSL2561(int fileDescriptor, int address);
+    static bool probeADS1115(int fileDescriptor, int address);
+
+    static quint8 crc8(const quint8 *data, int length);
+
+private:
+    static bool readRegister(int fileDescriptor, int address, const quint8 *command, int commandLength, quint8 *data, int dataLength);
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(ChipDiscovery::Chips)
+
+#endif // CHIPDISCOVERY_H
@@ -0,0 +1,117 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "decimatingfilter.h"
+
+#include <QtMath>
+
+DecimatingFilter::DecimatingFilter(int decimation, int tapsPerPhase, double cutoff) :
+    m_decimation(qMax(1, decimation)),
+    m_tapsPerPhase(qMax(1, tapsPerPhase))
+{
+    // Windowed sinc, cutoff in cycles per input sample
+    int tapCount = m_decimation * m_tapsPerPhase;
+    double frequency = cutoff * 0.5 / m_decimation;
+    double center = (tapCount - 1) / 2.0;
+
+    QVector<double> coefficients(tapCount);
+    double sum = 0;
+    for (int i = 0; i < tapCount; i++) {
+        double x = i - center;
+        double sinc = qFuzzyIsNull(x) ? 2 * frequency : qSin(2 * M_PI * frequency * x) / (M_PI * x);
+        double window = tapCount > 1 ? 0.42 - 0.5 * qCos(2 * M_PI * i / (tapCount - 1)) + 0.08 * qCos(4 * M_PI * i / (tapCount - 1)) : 1;
+        coefficients[i] = sinc * window;
+        sum += coefficients[i];
+    }
+
+    // Unity gain at DC, the ADC codes keep their meaning
+    //
+    // Input number n = m * decimation - phase contributes to output m + j
+    // with the tap j * decimation + phase.
+    m_phaseCoefficients.resize(tapCount);
+    for (int phase = 0; phase < m_decimation; phase++) {
+        for (int j = 0; j < m_tapsPerPhase; j++) {
+            m_phaseCoefficients[phase * m_tapsPerPhase + j] = coefficients.at(j * m_decimation + phase) / sum;
+        }
+    }
+
+    m_accumulators.resize(m_tapsPerPhase);
+    reset();
+}
+
+int DecimatingFilter::decimation() const
+{
+    return m_decimation;
+}
+
+int DecimatingFilter::tapCount() const
+{
+    return m_decimation * m_tapsPerPhase;
+}
+
+double DecimatingFilter::groupDelay() const
+{
+    return (tapCount() - 1) / 2.0;
+}
+
+bool DecimatingFilter::addValue(double value, double *output)
+{
+    const double *coefficients = m_phaseCoefficients.constData() + m_phase * m_tapsPerPhase;
+    double *accumulators = m_accumulators.data();
+
+    // Note: two loops instead of a modulo per tap
+    int tail = m_tapsPerPhase - m_head;
+    for (int j = 0; j < tail; j++)
+        accumulators[m_head + j] += coefficients[j] * value;
+
+    for (int j = tail; j < m_tapsPerPhase; j++)
+        accumulators[j - tail] += coefficients[j] * value;
+
+    if (m_phase > 0) {
+        m_phase--;
+        return false;
+    }
+
+    // Phase 0 completes the oldest partial sum
+    double result = accumulators[m_head];
+    accumulators[m_head] = 0;
+    m_head = (m_head + 1) % m_tapsPerPhase;
+    m_phase = m_decimation - 1;
+
+    if (m_warmUp > 0) {
+        m_warmUp--;
+        return false;
+    }
+
+    if (output)
+        *output = result;
+
+    return true;
+}
+
+void DecimatingFilter::reset()
+{
+    m_accumulators.fill(0);
+    m_head = 0;
+    m_phase = m_decimation - 1;
+    m_warmUp = m_tapsPerPhase - 1;
+}
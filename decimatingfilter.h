@@ -0,0 +1,72 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef DECIMATINGFILTER_H
+#define DECIMATINGFILTER_H
+
+#include <QVector>
+
+// Low pass FIR filter and decimator in one, for the ADC streaming mode.
+//
+// The taps are a Blackman windowed sinc with decimation * tapsPerPhase
+// coefficients. The filter runs in transposed polyphase form: every input
+// sample gets multiplied into tapsPerPhase partial sums of the upcoming
+// outputs, and every decimation inputs the oldest partial sum is complete.
+// There is no history buffer and an input costs tapsPerPhase multiply-adds,
+// independent of the decimation factor.
+//
+// The cutoff is relative to the Nyquist frequency of the output rate. The
+// first tapsPerPhase - 1 outputs would only cover a part of the taps, they
+// get dropped.
+
+class DecimatingFilter
+{
+public:
+    explicit DecimatingFilter(int decimation, int tapsPerPhase = 24, double cutoff = 0.8);
+
+    int decimation() const;
+    int tapCount() const;
+
+    // Delay of the output relative to the last input [input samples]
+    double groupDelay() const;
+
+    // Returns true if the input completed an output sample
+    bool addValue(double value, double *output);
+
+    void reset();
+
+private:
+    int m_decimation;
+    int m_tapsPerPhase;
+
+    // Coefficients ordered by phase: tapsPerPhase taps per input phase
+    QVector<double> m_phaseCoefficients;
+
+    // Partial sums of the next tapsPerPhase outputs, ring starting at m_head
+    QVector<double> m_accumulators;
+    int m_head = 0;
+    int m_phase = 0;
+    int m_warmUp = 0;
+
+};
+
+#endif // DECIMATINGFILTER_H
@@ -0,0 +1,72 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "derivedvalues.h"
+
+#include <math.h>
+
+double DerivedValues::dewPoint(double temperature, double humidity)
+{
+    if (humidity <= 0)
+        humidity = 0.01;
+
+    double gamma = log(humidity / 100.0) + (17.62 * temperature) / (243.12 + temperature);
+    return 243.12 * gamma / (17.62 - gamma);
+}
+
+double DerivedValues::absoluteHumidity(double temperature, double humidity)
+{
+    // Saturation vapour pressure [hPa] times the relative humidity, converted with the gas constant of water vapour
+    double saturationPressure = 6.112 * exp((17.62 * temperature) / (243.12 + temperature));
+    return 216.7 * (humidity / 100.0 * saturationPressure) / (273.15 + temperature);
+}
+
+double DerivedValues::heatIndex(double temperature, double humidity)
+{
+    // Note: the regression is defined in °F
+    double t = temperature * 9.0 / 5.0 + 32.0;
+    double rh = humidity;
+
+    // Simple formula first, the full regression is only valid above 80 °F
+    double index = 0.5 * (t + 61.0 + (t - 68.0) * 1.2 + rh * 0.094);
+    if ((index + t) / 2.0 >= 80.0) {
+        index = -42.379 + 2.04901523 * t + 10.14333127 * rh - 0.22475541 * t * rh
+                - 0.00683783 * t * t - 0.05481717 * rh * rh + 0.00122874 * t * t * rh
+                + 0.00085282 * t * rh * rh - 0.00000199 * t * t * rh * rh;
+
+        if (rh < 13.0 && t >= 80.0 && t <= 112.0) {
+            index -= ((13.0 - rh) / 4.0) * sqrt((17.0 - fabs(t - 95.0)) / 17.0);
+        } else if (rh > 85.0 && t >= 80.0 && t <= 87.0) {
+            index += ((rh - 85.0) / 10.0) * ((87.0 - t) / 5.0);
+        }
+    } else {
+        index = (index + t) / 2.0;
+    }
+
+    return (index - 32.0) * 5.0 / 9.0;
+}
+
+double DerivedValues::seaLevelPressure(double pressure, double altitude, double temperature)
+{
+    double gradient = 0.0065 * altitude;
+    return pressure * pow(1.0 - gradient / (temperature + gradient + 273.15), -5.257);
+}
@@ -0,0 +1,46 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef DERIVEDVALUES_H
+#define DERIVEDVALUES_H
+
+// Environmental values derived from the filtered temperature, humidity and pressure.
+//
+// Temperatures in [°C], relative humidity in [%], pressure in [hPa] and altitude in [m].
+
+class DerivedValues
+{
+public:
+    // Magnus formula (Sonntag 1990 coefficients)
+    static double dewPoint(double temperature, double humidity);
+
+    // Water vapour density [g/m³]
+    static double absoluteHumidity(double temperature, double humidity);
+
+    // NOAA heat index (Rothfusz regression with the adjustments of the NWS), converted to [°C]
+    static double heatIndex(double temperature, double humidity);
+
+    // Station pressure reduced to sea level, using the station temperature (international barometric formula)
+    static double seaLevelPressure(double pressure, double altitude, double temperature = 15.0);
+};
+
+#endif // DERIVEDVALUES_H
@@ -25,6 +25,11 @@
 #include "plugin/devicedescriptor.h"
 #include "devicepluginsensorstation.h"
 
+#include <QDir>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QtConcurrent>
+
 DevicePluginAnalogSensors::DevicePluginAnalogSensors()
 {
 
@@ -32,6 +37,10 @@ DevicePluginAnalogSensors::DevicePluginAnalogSensors()
 
 DevicePluginAnalogSensors::~DevicePluginAnalogSensors()
 {
+    foreach (AirQualityMonitor *monitor, m_monitors) {
+        saveBaseline(monitor);
+    }
+
     if (m_timer) {
         hardwareManager()->pluginTimerManager()->unregisterTimer(m_timer);
         m_timer = nullptr;
@@ -40,14 +49,18 @@ DevicePluginAnalogSensors::~DevicePluginAnalogSensors()
 
 void DevicePluginAnalogSensors::init()
 {
+    connect(this, &DevicePluginAnalogSensors::configValueChanged, this, &DevicePluginAnalogSensors::onPluginConfigurationChanged);
 
+    m_metricsExporter = new MetricsExporter(this);
+    configureMetrics();
 }
 
 void DevicePluginAnalogSensors::postSetupDevice(Device *device)
 {
     qCDebug(dcSensorStation()) << "Post setup device" << device->name();
-    if (m_airQualityMonitor) {
-        m_airQualityMonitor->enable();
+    AirQualityMonitor *monitor = m_monitors.value(device);
+    if (monitor) {
+        monitor->enable();
     }
 }
 
@@ -57,12 +70,19 @@ void DevicePluginAnalogSensors::deviceRemoved(Device *device)
 
     // Clean up all data related to this device
     if (device->deviceClassId() == sensorStationDeviceClassId) {
-        if (m_airQualityMonitor) {
-            delete m_airQualityMonitor;
-            m_airQualityMonitor = nullptr;
+        // Note: a running discovery can not be aborted, its result gets dropped
+        m_discoveries.remove(device);
+
+        AirQualityMonitor *monitor = m_monitors.take(device);
+        if (monitor) {
+            m_metricsExporter->setMonitors(m_monitors.values());
+            delete monitor;
         }
 
-        if (m_timer) {
+        pluginStorage()->remove(device->id().toString());
+        QDir(historyDirectory(device)).removeRecursively();
+
+        if (m_monitors.isEmpty() && m_timer) {
             hardwareManager()->pluginTimerManager()->unregisterTimer(m_timer);
             m_timer = nullptr;
         }
@@ -71,33 +91,341 @@ void DevicePluginAnalogSensors::deviceRemoved(Device *device)
 
 DeviceManager::DeviceSetupStatus DevicePluginAnalogSensors::setupDevice(Device *device)
 {
-    qCDebug(dcSensorStation()) << "Setup device" << device->name();
+    qCDebug(dcSensorStation()) << "Setup device" << device->name() << device->params();
 
     if (device->deviceClassId() == sensorStationDeviceClassId) {
-        if (m_airQualityMonitor) {
-            qCWarning(dcSensorStation()) << "There is already an sensorstation set up. Only once sensor is allowed";
-            return DeviceManager::DeviceSetupStatusFailure;
+        // Note: probing the bus takes time and touches all chips, reuse the result of the last start if nothing changed
+        ChipDiscovery::Chips chips = cachedChips(device);
+        if (chips != ChipDiscovery::ChipNone) {
+            qCDebug(dcSensorStation()) << "Using cached chip discovery for" << device->name();
+            return setupMonitor(device, chips);
         }
 
-        m_airQualityMonitor = new AirQualityMonitor(device, this);
-        // Refresh the data values every 5 min
-        m_timer = hardwareManager()->pluginTimerManager()->registerTimer(300);
-        connect(m_timer, &PluginTimer::timeout, this, &DevicePluginAnalogSensors::onPluginTimer);
+        discoverChips(device);
+        return DeviceManager::DeviceSetupStatusAsync;
     }
 
     return DeviceManager::DeviceSetupStatusSuccess;
 }
 
+DeviceManager::DeviceSetupStatus DevicePluginAnalogSensors::setupMonitor(Device *device, ChipDiscovery::Chips chips)
+{
+    // Note: the sensor head could be plugged in later, the monitor keeps probing for the missing chips
+    if (chips == ChipDiscovery::ChipNone)
+        qCWarning(dcSensorStation()) << "Could not find any sensor chip for" << device->name() << "yet";
+
+    AirQualityMonitor *monitor = new AirQualityMonitor(device, chips, this);
+
+    // Two stations can share a bus (or a multiplexer channel), but not a chip.
+    // Chips directly on the bus and the muxes themselves are always connected,
+    // only the chips behind different mux channels never answer at the same time.
+    foreach (AirQualityMonitor *existingMonitor, m_monitors) {
+        if (existingMonitor->i2cPortName() != monitor->i2cPortName())
+            continue;
+
+        bool sameSegment = existingMonitor->muxAddress() == monitor->muxAddress() && existingMonitor->muxChannel() == monitor->muxChannel();
+        bool shared = sameSegment || existingMonitor->muxAddress() < 0 || monitor->muxAddress() < 0;
+
+        QList<int> conflicts;
+        foreach (int address, monitor->i2cAddresses()) {
+            if ((shared && existingMonitor->i2cAddresses().contains(address)) || address == existingMonitor->muxAddress())
+                conflicts << address;
+        }
+
+        if (monitor->muxAddress() >= 0 && existingMonitor->i2cAddresses().contains(monitor->muxAddress()))
+            conflicts << monitor->muxAddress();
+
+        if (!conflicts.isEmpty()) {
+            qCWarning(dcSensorStation()) << "The I2C address" << QString("0x%1").arg(conflicts.first(), 0, 16) << "on" << monitor->i2cPortName() << "is already in use by" << existingMonitor->device()->name();
+            delete monitor;
+            return DeviceManager::DeviceSetupStatusFailure;
+        }
+    }
+
+    m_monitors.insert(device, monitor);
+    connect(monitor, &AirQualityMonitor::chipsChanged, this, &DevicePluginAnalogSensors::onMonitorChipsChanged);
+    monitor->setSchedulingConfiguration(schedulingConfiguration());
+    monitor->setDutyCycleEnabled(configValue(sensorStationPluginDutyCycleParamTypeId).toBool());
+    monitor->setAirQualityStreamingEnabled(configValue(sensorStationPluginAirQualityStreamingParamTypeId).toBool());
+    monitor->setSensorLogEnabled(configValue(sensorStationPluginSensorLogParamTypeId).toBool());
+    configureCapture(monitor);
+    configureBaseline(monitor);
+    configurePublishing(monitor);
+    monitor->setHistoryDirectory(historyDirectory(device));
+    m_metricsExporter->setMonitors(m_monitors.values());
+    updatePublishTimer();
+
+    return DeviceManager::DeviceSetupStatusSuccess;
+}
+
 DeviceManager::DeviceError DevicePluginAnalogSensors::executeAction(Device *device, const Action &action)
 {
     qCDebug(dcSensorStation()) << "Executing action for device" << device->name() << action.actionTypeId().toString() << action.params();
 
-    return DeviceManager::DeviceErrorNoError;
+    AirQualityMonitor *monitor = m_monitors.value(device);
+    if (!monitor)
+        return DeviceManager::DeviceErrorHardwareNotAvailable;
+
+    if (action.actionTypeId() == sensorStationQueryHistoryActionTypeId) {
+        QHash<QString, StateTypeId> series;
+        series.insert("co2", sensorStationCo2StateTypeId);
+        series.insert("temperature", sensorStationTemperatureStateTypeId);
+        series.insert("humidity", sensorStationHumidityStateTypeId);
+        series.insert("pressure", sensorStationPressureStateTypeId);
+        series.insert("lightIntensity", sensorStationLightIntensityStateTypeId);
+
+        QString seriesName = action.param(sensorStationQueryHistoryActionSeriesParamTypeId).value().toString();
+        if (!series.contains(seriesName))
+            return DeviceManager::DeviceErrorInvalidParameter;
+
+        // Note: actions can not return data, the result gets published in the historyResult state
+        qint64 to = QDateTime::currentMSecsSinceEpoch();
+        qint64 from = to - static_cast<qint64>(action.param(sensorStationQueryHistoryActionHoursParamTypeId).value().toDouble() * 3600 * 1000);
+        int maxPoints = action.param(sensorStationQueryHistoryActionPointsParamTypeId).value().toInt();
+        device->setStateValue(sensorStationHistoryResultStateTypeId, monitor->queryHistory(series.value(seriesName), from, to, maxPoints));
+        return DeviceManager::DeviceErrorNoError;
+    }
+
+    return DeviceManager::DeviceErrorActionTypeNotFound;
+}
+
+static void busConfiguration(Device *device, QString *portName, int *muxAddress, int *muxChannel)
+{
+    *portName = device->paramValue(sensorStationBusParamTypeId).toString();
+    *muxAddress = device->paramValue(sensorStationMuxAddressParamTypeId).toInt();
+    *muxChannel = device->paramValue(sensorStationMuxChannelParamTypeId).toInt();
+    if (*muxAddress <= 0) {
+        *muxAddress = -1;
+        *muxChannel = 0;
+    }
+}
+
+QString DevicePluginAnalogSensors::busMap(Device *device) const
+{
+    // The bus map identifies the configuration the cached discovery result belongs to
+    ChipDiscovery::Addresses addresses = AirQualityMonitor::configuredAddresses(device);
+    QString portName;
+    int muxAddress = -1;
+    int muxChannel = 0;
+    busConfiguration(device, &portName, &muxAddress, &muxChannel);
+    return QString("%1;%2;%3;%4;%5;%6;%7").arg(portName).arg(muxAddress).arg(muxChannel)
+            .arg(addresses.sht30).arg(addresses.bmp180).arg(addresses.tsl2561).arg(addresses.ads1115);
+}
+
+ChipDiscovery::Chips DevicePluginAnalogSensors::cachedChips(Device *device)
+{
+    pluginStorage()->beginGroup(device->id().toString());
+    ChipDiscovery::Chips chips = ChipDiscovery::ChipNone;
+    if (pluginStorage()->value("busMap").toString() == busMap(device))
+        chips = ChipDiscovery::Chips(pluginStorage()->value("chips", 0).toInt());
+
+    pluginStorage()->endGroup();
+    return chips;
+}
+
+void DevicePluginAnalogSensors::discoverChips(Device *device)
+{
+    // The scan waits for the bus lock and reads every chip, keep it away from the main thread
+    // and finish the setup once the result is there.
+    ChipDiscovery::Addresses addresses = AirQualityMonitor::configuredAddresses(device);
+    QString portName;
+    int muxAddress = -1;
+    int muxChannel = 0;
+    busConfiguration(device, &portName, &muxAddress, &muxChannel);
+
+    QFutureWatcher<ChipDiscovery::Chips> *watcher = new QFutureWatcher<ChipDiscovery::Chips>(this);
+    m_discoveries.insert(device, watcher);
+    connect(watcher, &QFutureWatcher<ChipDiscovery::Chips>::finished, this, [this, device, watcher]() {
+        watcher->deleteLater();
+        if (m_discoveries.value(device) != watcher)
+            return;
+
+        m_discoveries.remove(device);
+        ChipDiscovery::Chips chips = watcher->result();
+        if (chips != ChipDiscovery::ChipNone) {
+            pluginStorage()->beginGroup(device->id().toString());
+            pluginStorage()->setValue("busMap", busMap(device));
+            pluginStorage()->setValue("chips", static_cast<int>(chips));
+            pluginStorage()->endGroup();
+        }
+
+        emit deviceSetupFinished(device, setupMonitor(device, chips));
+    });
+
+    watcher->setFuture(QtConcurrent::run(&ChipDiscovery::discover, portName, addresses, muxAddress, muxChannel, ChipDiscovery::Chips(ChipDiscovery::ChipAll)));
+}
+
+QString DevicePluginAnalogSensors::historyDirectory(Device *device)
+{
+    QString storageDirectory = QFileInfo(pluginStorage()->fileName()).absolutePath();
+    return QDir(storageDirectory).filePath("sensorstation-history/" + device->id().toString().remove('{').remove('}'));
+}
+
+SensorThread::SchedulingConfiguration DevicePluginAnalogSensors::schedulingConfiguration() const
+{
+    SensorThread::SchedulingConfiguration configuration;
+    configuration.realtimePriority = configValue(sensorStationPluginRealtimePriorityParamTypeId).toInt();
+    configuration.niceLevel = configValue(sensorStationPluginNiceLevelParamTypeId).toInt();
+    configuration.cpuAffinity = SensorThread::parseCpuList(configValue(sensorStationPluginCpuAffinityParamTypeId).toString());
+    return configuration;
+}
+
+void DevicePluginAnalogSensors::configureCapture(AirQualityMonitor *monitor)
+{
+    monitor->setCaptureSyncPolicy(CaptureWriter::parseSyncPolicy(configValue(sensorStationPluginCaptureSyncPolicyParamTypeId).toString()),
+                                  configValue(sensorStationPluginCaptureSyncIntervalParamTypeId).toInt());
+    monitor->setCaptureEnabled(configValue(sensorStationPluginRawCaptureParamTypeId).toBool());
+}
+
+void DevicePluginAnalogSensors::configureBaseline(AirQualityMonitor *monitor)
+{
+    monitor->setBaselineCalibration(configValue(sensorStationPluginAutoBaselineParamTypeId).toBool(),
+                                    configValue(sensorStationPluginBaselineWindowParamTypeId).toInt());
+
+    // Continue with the baseline learned before the restart
+    pluginStorage()->beginGroup(monitor->device()->id().toString());
+    monitor->restoreBaselineState(pluginStorage()->value("baseline").toMap());
+    pluginStorage()->endGroup();
+}
+
+void DevicePluginAnalogSensors::saveBaseline(AirQualityMonitor *monitor)
+{
+    pluginStorage()->beginGroup(monitor->device()->id().toString());
+    pluginStorage()->setValue("baseline", monitor->baselineState());
+    pluginStorage()->endGroup();
+}
+
+void DevicePluginAnalogSensors::configurePublishing(AirQualityMonitor *monitor)
+{
+    monitor->setPublishInterval(configValue(sensorStationPluginPublishIntervalParamTypeId).toInt());
+    monitor->setAltitude(configValue(sensorStationPluginStationAltitudeParamTypeId).toDouble());
+    monitor->setPublishThresholds(sensorStationTemperatureStateTypeId,
+                                  configValue(sensorStationPluginTemperatureDeadbandParamTypeId).toDouble(),
+                                  configValue(sensorStationPluginTemperatureRateThresholdParamTypeId).toDouble());
+    monitor->setPublishThresholds(sensorStationHumidityStateTypeId,
+                                  configValue(sensorStationPluginHumidityDeadbandParamTypeId).toDouble(),
+                                  configValue(sensorStationPluginHumidityRateThresholdParamTypeId).toDouble());
+    monitor->setPublishThresholds(sensorStationPressureStateTypeId,
+                                  configValue(sensorStationPluginPressureDeadbandParamTypeId).toDouble(),
+                                  configValue(sensorStationPluginPressureRateThresholdParamTypeId).toDouble());
+    monitor->setPublishThresholds(sensorStationSeaLevelPressureStateTypeId,
+                                  configValue(sensorStationPluginPressureDeadbandParamTypeId).toDouble(),
+                                  configValue(sensorStationPluginPressureRateThresholdParamTypeId).toDouble());
+    monitor->setPublishThresholds(sensorStationLightIntensityStateTypeId,
+                                  configValue(sensorStationPluginLightIntensityDeadbandParamTypeId).toDouble(),
+                                  configValue(sensorStationPluginLightIntensityRateThresholdParamTypeId).toDouble());
+    monitor->setPublishThresholds(sensorStationCo2StateTypeId,
+                                  configValue(sensorStationPluginCo2DeadbandParamTypeId).toDouble(),
+                                  configValue(sensorStationPluginCo2RateThresholdParamTypeId).toDouble());
+}
+
+void DevicePluginAnalogSensors::configureMetrics()
+{
+    m_metricsExporter->setInterval(configValue(sensorStationPluginMetricsIntervalParamTypeId).toInt());
+    m_metricsExporter->setFileName(configValue(sensorStationPluginMetricsFileParamTypeId).toString());
+}
+
+void DevicePluginAnalogSensors::updatePublishTimer()
+{
+    // (Re)register the publish timer with the configured interval
+    int publishInterval = configValue(sensorStationPluginPublishIntervalParamTypeId).toInt();
+    if (m_timer) {
+        if (m_timer->interval() == publishInterval)
+            return;
+
+        hardwareManager()->pluginTimerManager()->unregisterTimer(m_timer);
+        m_timer = nullptr;
+    }
+
+    qCDebug(dcSensorStation()) << "Publishing the sensor values every" << publishInterval << "seconds";
+    m_timer = hardwareManager()->pluginTimerManager()->registerTimer(publishInterval);
+    connect(m_timer, &PluginTimer::timeout, this, &DevicePluginAnalogSensors::onPluginTimer);
 }
 
 void DevicePluginAnalogSensors::onPluginTimer()
 {
-    if (m_airQualityMonitor) {
-        m_airQualityMonitor->measure();
+    foreach (AirQualityMonitor *monitor, m_monitors) {
+        monitor->measure();
+        saveBaseline(monitor);
+    }
+}
+
+void DevicePluginAnalogSensors::onPluginConfigurationChanged(const ParamTypeId &paramTypeId, const QVariant &value)
+{
+    qCDebug(dcSensorStation()) << "Plugin configuration changed" << paramTypeId.toString() << value;
+
+    if (paramTypeId == sensorStationPluginRealtimePriorityParamTypeId
+            || paramTypeId == sensorStationPluginNiceLevelParamTypeId
+            || paramTypeId == sensorStationPluginCpuAffinityParamTypeId) {
+        foreach (AirQualityMonitor *monitor, m_monitors) {
+            monitor->setSchedulingConfiguration(schedulingConfiguration());
+        }
+        return;
+    }
+
+    if (paramTypeId == sensorStationPluginDutyCycleParamTypeId) {
+        foreach (AirQualityMonitor *monitor, m_monitors) {
+            monitor->setDutyCycleEnabled(value.toBool());
+        }
+        return;
+    }
+
+    if (paramTypeId == sensorStationPluginAirQualityStreamingParamTypeId) {
+        foreach (AirQualityMonitor *monitor, m_monitors) {
+            monitor->setAirQualityStreamingEnabled(value.toBool());
+        }
+        return;
+    }
+
+    if (paramTypeId == sensorStationPluginSensorLogParamTypeId) {
+        foreach (AirQualityMonitor *monitor, m_monitors) {
+            monitor->setSensorLogEnabled(value.toBool());
+        }
+        return;
+    }
+
+    if (paramTypeId == sensorStationPluginRawCaptureParamTypeId
+            || paramTypeId == sensorStationPluginCaptureSyncPolicyParamTypeId
+            || paramTypeId == sensorStationPluginCaptureSyncIntervalParamTypeId) {
+        foreach (AirQualityMonitor *monitor, m_monitors) {
+            configureCapture(monitor);
+        }
+        return;
     }
+
+    if (paramTypeId == sensorStationPluginMetricsFileParamTypeId
+            || paramTypeId == sensorStationPluginMetricsIntervalParamTypeId) {
+        configureMetrics();
+        return;
+    }
+
+    if (paramTypeId == sensorStationPluginAutoBaselineParamTypeId
+            || paramTypeId == sensorStationPluginBaselineWindowParamTypeId) {
+        foreach (AirQualityMonitor *monitor, m_monitors) {
+            saveBaseline(monitor);
+            configureBaseline(monitor);
+        }
+        return;
+    }
+
+    // All other settings configure the publishing
+    foreach (AirQualityMonitor *monitor, m_monitors) {
+        configurePublishing(monitor);
+    }
+
+    if (!m_monitors.isEmpty()) {
+        updatePublishTimer();
+    }
+}
+
+void DevicePluginAnalogSensors::onMonitorChipsChanged(ChipDiscovery::Chips chips)
+{
+    // A chip has been plugged in after the setup, keep the cached discovery up to date for the next start
+    AirQualityMonitor *monitor = qobject_cast<AirQualityMonitor *>(sender());
+    if (!monitor)
+        return;
+
+    pluginStorage()->beginGroup(monitor->device()->id().toString());
+    pluginStorage()->setValue("chips", static_cast<int>(chips));
+    pluginStorage()->endGroup();
 }
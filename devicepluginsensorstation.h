@@ -27,6 +27,9 @@
 #include "devicemanager.h"
 #include "plugin/deviceplugin.h"
 #include "airqualitymonitor.h"
+#include "metricsexporter.h"
+
+#include <QFutureWatcher>
 
 class DevicePluginAnalogSensors: public DevicePlugin
 {
@@ -48,10 +51,27 @@ public:
 
 private:
     PluginTimer *m_timer = nullptr;
-    AirQualityMonitor *m_airQualityMonitor = nullptr;
+    QHash<Device *, AirQualityMonitor *> m_monitors;
+    MetricsExporter *m_metricsExporter = nullptr;
+    QHash<Device *, QFutureWatcher<ChipDiscovery::Chips> *> m_discoveries;
+
+    QString busMap(Device *device) const;
+    ChipDiscovery::Chips cachedChips(Device *device);
+    void discoverChips(Device *device);
+    DeviceManager::DeviceSetupStatus setupMonitor(Device *device, ChipDiscovery::Chips chips);
+    QString historyDirectory(Device *device);
+    SensorThread::SchedulingConfiguration schedulingConfiguration() const;
+    void configureCapture(AirQualityMonitor *monitor);
+    void configureBaseline(AirQualityMonitor *monitor);
+    void saveBaseline(AirQualityMonitor *monitor);
+    void configurePublishing(AirQualityMonitor *monitor);
+    void configureMetrics();
+    void updatePublishTimer();
 
 private slots:
     void onPluginTimer();
+    void onPluginConfigurationChanged(const ParamTypeId &paramTypeId, const QVariant &value);
+    void onMonitorChipsChanged(ChipDiscovery::Chips chips);
 
 };
 
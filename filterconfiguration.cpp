@@ -0,0 +1,57 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "filterconfiguration.h"
+
+QHash<QString, FilterConfiguration::Filter> FilterConfiguration::monitorFilters(int airQualitySampleRate)
+{
+    // Note: the filters get every raw sample (~1-2 samples/s), the window sizes are in samples
+    QHash<QString, Filter> filters;
+
+    Filter average;
+    average.type = SensorDataFilter::TypeAverage;
+
+    average.windowSize = 60;
+    filters.insert("temperature", average);
+    filters.insert("humidity", average);
+
+    average.windowSize = 20;
+    filters.insert("lux", average);
+
+    average.windowSize = static_cast<uint>(60 * qMax(1, airQualitySampleRate));
+    filters.insert("ppm", average);
+
+    Filter lowPass;
+    lowPass.type = SensorDataFilter::TypeLowPass;
+    lowPass.windowSize = 20;
+    lowPass.alpha = 0.2;
+    filters.insert("pressure", lowPass);
+
+    return filters;
+}
+
+void FilterConfiguration::apply(SensorDataFilter *filter, const FilterConfiguration::Filter &configuration)
+{
+    filter->setFilterWindowSize(configuration.windowSize);
+    filter->setLowPassAlpha(configuration.alpha);
+    filter->setHighPassAlpha(configuration.alpha);
+}
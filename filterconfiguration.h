@@ -0,0 +1,55 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FILTERCONFIGURATION_H
+#define FILTERCONFIGURATION_H
+
+#include <QHash>
+#include <QString>
+
+#include "sensordatafilter.h"
+
+// Filter chain of AirQualityMonitor, one filter per sensor log channel
+// (temperature, humidity, pressure, lux, ppm).
+//
+// The sensorreplay tool evaluates the same chain, so tuned settings only
+// have to be changed here.
+
+class FilterConfiguration
+{
+public:
+    struct Filter {
+        SensorDataFilter::Type type = SensorDataFilter::TypeAverage;
+        uint windowSize = 20;
+        double alpha = 0.2;
+    };
+
+    // Four single shot conversions every 500 ms
+    static const int singleShotSampleRate = 2;
+
+    // Note: the CO2 average always covers 60 s, the window depends on the MQ-135 sample rate [samples/s]
+    static QHash<QString, Filter> monitorFilters(int airQualitySampleRate = singleShotSampleRate);
+
+    static void apply(SensorDataFilter *filter, const Filter &configuration);
+};
+
+#endif // FILTERCONFIGURATION_H
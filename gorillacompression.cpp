@@ -0,0 +1,271 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "gorillacompression.h"
+
+#include <cstring>
+
+static inline quint64 doubleToBits(double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline double bitsToDouble(quint64 bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline int leadingZeros(quint64 value)
+{
+    return value == 0 ? 64 : __builtin_clzll(value);
+}
+
+static inline int trailingZeros(quint64 value)
+{
+    return value == 0 ? 64 : __builtin_ctzll(value);
+}
+
+void GorillaEncoder::reset(uchar *buffer, int capacityBytes, int valueCount)
+{
+    m_buffer = buffer;
+    m_capacityBits = static_cast<qint64>(capacityBytes) * 8;
+    m_bitPosition = 0;
+    m_valueCount = qBound(1, valueCount, GORILLA_MAX_VALUES);
+    m_count = 0;
+    m_previousTimestamp = 0;
+    m_previousDelta = 0;
+    for (int i = 0; i < GORILLA_MAX_VALUES; i++) {
+        m_previousValues[i] = 0;
+        m_previousLeading[i] = 0;
+        m_previousTrailing[i] = 0;
+    }
+}
+
+bool GorillaEncoder::append(qint64 timestamp, const double *values)
+{
+    // Note: checking the worst case keeps the encoder simple, the last few bytes of a block may stay unused
+    if (m_bitPosition + maximumPointBits(m_valueCount) > m_capacityBits)
+        return false;
+
+    if (m_count == 0) {
+        writeBits(static_cast<quint64>(timestamp), 64);
+        m_previousTimestamp = timestamp;
+        for (int i = 0; i < m_valueCount; i++) {
+            m_previousValues[i] = doubleToBits(values[i]);
+            writeBits(m_previousValues[i], 64);
+        }
+    } else {
+        writeTimestamp(timestamp);
+        for (int i = 0; i < m_valueCount; i++) {
+            writeValue(i, doubleToBits(values[i]));
+        }
+    }
+
+    m_count++;
+    return true;
+}
+
+int GorillaEncoder::count() const
+{
+    return m_count;
+}
+
+int GorillaEncoder::bitLength() const
+{
+    return static_cast<int>(m_bitPosition);
+}
+
+int GorillaEncoder::maximumPointBits(int valueCount)
+{
+    // Timestamp: '1111' + 64 bit delta of delta, value: '11' + 5 bit leading + 6 bit length + 64 bit
+    return 4 + 64 + valueCount * (2 + 5 + 6 + 64);
+}
+
+void GorillaEncoder::writeBits(quint64 value, int bits)
+{
+    while (bits > 0) {
+        qint64 byteIndex = m_bitPosition >> 3;
+        int bitOffset = static_cast<int>(m_bitPosition & 7);
+        int freeBits = 8 - bitOffset;
+        int chunk = bits < freeBits ? bits : freeBits;
+
+        // Take the next chunk from the most significant end of the remaining bits
+        quint64 chunkValue = (value >> (bits - chunk)) & ((1u << chunk) - 1);
+        m_buffer[byteIndex] |= static_cast<uchar>(chunkValue << (freeBits - chunk));
+
+        bits -= chunk;
+        m_bitPosition += chunk;
+    }
+}
+
+void GorillaEncoder::writeTimestamp(qint64 timestamp)
+{
+    qint64 delta = timestamp - m_previousTimestamp;
+    qint64 deltaOfDelta = delta - m_previousDelta;
+    m_previousTimestamp = timestamp;
+    m_previousDelta = delta;
+
+    if (deltaOfDelta == 0) {
+        writeBits(0x0, 1);
+    } else if (deltaOfDelta >= -63 && deltaOfDelta <= 64) {
+        writeBits(0x2, 2);
+        writeBits(static_cast<quint64>(deltaOfDelta + 63), 7);
+    } else if (deltaOfDelta >= -255 && deltaOfDelta <= 256) {
+        writeBits(0x6, 3);
+        writeBits(static_cast<quint64>(deltaOfDelta + 255), 9);
+    } else if (deltaOfDelta >= -2047 && deltaOfDelta <= 2048) {
+        writeBits(0xE, 4);
+        writeBits(static_cast<quint64>(deltaOfDelta + 2047), 12);
+    } else {
+        writeBits(0xF, 4);
+        writeBits(static_cast<quint64>(deltaOfDelta), 64);
+    }
+}
+
+void GorillaEncoder::writeValue(int column, quint64 value)
+{
+    quint64 xorValue = value ^ m_previousValues[column];
+    m_previousValues[column] = value;
+
+    if (xorValue == 0) {
+        writeBits(0x0, 1);
+        return;
+    }
+
+    int leading = qMin(leadingZeros(xorValue), 31);
+    int trailing = trailingZeros(xorValue);
+
+    // Reuse the previous window if the meaningful bits fit into it
+    if (m_previousLeading[column] + m_previousTrailing[column] > 0 && leading >= m_previousLeading[column] && trailing >= m_previousTrailing[column]) {
+        int meaningfulBits = 64 - m_previousLeading[column] - m_previousTrailing[column];
+        writeBits(0x2, 2);
+        writeBits(xorValue >> m_previousTrailing[column], meaningfulBits);
+        return;
+    }
+
+    int meaningfulBits = 64 - leading - trailing;
+    writeBits(0x3, 2);
+    writeBits(static_cast<quint64>(leading), 5);
+    // Note: 64 meaningful bits get stored as 0
+    writeBits(static_cast<quint64>(meaningfulBits & 0x3F), 6);
+    writeBits(xorValue >> trailing, meaningfulBits);
+
+    m_previousLeading[column] = leading;
+    m_previousTrailing[column] = trailing;
+}
+
+GorillaDecoder::GorillaDecoder(const uchar *buffer, int bitLength, int valueCount, int count) :
+    m_buffer(buffer),
+    m_bitLength(bitLength),
+    m_valueCount(qBound(1, valueCount, GORILLA_MAX_VALUES)),
+    m_count(count)
+{
+
+}
+
+bool GorillaDecoder::next(qint64 *timestamp, double *values)
+{
+    if (m_index >= m_count || m_bitPosition >= m_bitLength)
+        return false;
+
+    if (m_index == 0) {
+        m_previousTimestamp = static_cast<qint64>(readBits(64));
+        for (int i = 0; i < m_valueCount; i++) {
+            m_previousValues[i] = readBits(64);
+        }
+    } else {
+        m_previousTimestamp = readTimestamp();
+        for (int i = 0; i < m_valueCount; i++) {
+            m_previousValues[i] = readValue(i);
+        }
+    }
+
+    *timestamp = m_previousTimestamp;
+    for (int i = 0; i < m_valueCount; i++) {
+        values[i] = bitsToDouble(m_previousValues[i]);
+    }
+
+    m_index++;
+    return true;
+}
+
+quint64 GorillaDecoder::readBits(int bits)
+{
+    quint64 value = 0;
+    while (bits > 0) {
+        qint64 byteIndex = m_bitPosition >> 3;
+        int bitOffset = static_cast<int>(m_bitPosition & 7);
+        int availableBits = 8 - bitOffset;
+        int chunk = bits < availableBits ? bits : availableBits;
+
+        quint64 chunkValue = (m_buffer[byteIndex] >> (availableBits - chunk)) & ((1u << chunk) - 1);
+        value = (value << chunk) | chunkValue;
+
+        bits -= chunk;
+        m_bitPosition += chunk;
+    }
+    return value;
+}
+
+qint64 GorillaDecoder::readTimestamp()
+{
+    qint64 deltaOfDelta = 0;
+    if (readBits(1) == 0) {
+        deltaOfDelta = 0;
+    } else if (readBits(1) == 0) {
+        deltaOfDelta = static_cast<qint64>(readBits(7)) - 63;
+    } else if (readBits(1) == 0) {
+        deltaOfDelta = static_cast<qint64>(readBits(9)) - 255;
+    } else if (readBits(1) == 0) {
+        deltaOfDelta = static_cast<qint64>(readBits(12)) - 2047;
+    } else {
+        deltaOfDelta = static_cast<qint64>(readBits(64));
+    }
+
+    m_previousDelta += deltaOfDelta;
+    return m_previousTimestamp + m_previousDelta;
+}
+
+quint64 GorillaDecoder::readValue(int column)
+{
+    if (readBits(1) == 0)
+        return m_previousValues[column];
+
+    if (readBits(1) == 0) {
+        int meaningfulBits = 64 - m_previousLeading[column] - m_previousTrailing[column];
+        return m_previousValues[column] ^ (readBits(meaningfulBits) << m_previousTrailing[column]);
+    }
+
+    int leading = static_cast<int>(readBits(5));
+    int meaningfulBits = static_cast<int>(readBits(6));
+    if (meaningfulBits == 0)
+        meaningfulBits = 64;
+
+    int trailing = 64 - leading - meaningfulBits;
+    m_previousLeading[column] = leading;
+    m_previousTrailing[column] = trailing;
+    return m_previousValues[column] ^ (readBits(meaningfulBits) << trailing);
+}
@@ -0,0 +1,100 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GORILLACOMPRESSION_H
+#define GORILLACOMPRESSION_H
+
+#include <QtGlobal>
+
+// Gorilla style time series compression (Pelkonen et al., VLDB 2015).
+//
+// Timestamps get stored as delta of deltas, values as XOR with the previous
+// value of the same column, both with the variable length prefixes of the paper.
+// A point consists of one timestamp [ms] and valueCount values, the bits get
+// written MSB first into a caller provided (zero initialized) buffer, so the
+// encoder can work directly on memory mapped storage.
+
+#define GORILLA_MAX_VALUES 3
+
+class GorillaEncoder
+{
+public:
+    GorillaEncoder() = default;
+
+    // Start a new stream in buffer, the buffer must be zeroed
+    void reset(uchar *buffer, int capacityBytes, int valueCount);
+
+    // Returns false and writes nothing if the point does not fit into the buffer
+    bool append(qint64 timestamp, const double *values);
+
+    int count() const;
+    int bitLength() const;
+
+    // Upper bound of the size of one point
+    static int maximumPointBits(int valueCount);
+
+private:
+    uchar *m_buffer = nullptr;
+    qint64 m_capacityBits = 0;
+    qint64 m_bitPosition = 0;
+    int m_valueCount = 1;
+    int m_count = 0;
+
+    qint64 m_previousTimestamp = 0;
+    qint64 m_previousDelta = 0;
+    quint64 m_previousValues[GORILLA_MAX_VALUES] = {0};
+    int m_previousLeading[GORILLA_MAX_VALUES] = {0};
+    int m_previousTrailing[GORILLA_MAX_VALUES] = {0};
+
+    void writeBits(quint64 value, int bits);
+    void writeTimestamp(qint64 timestamp);
+    void writeValue(int column, quint64 value);
+};
+
+class GorillaDecoder
+{
+public:
+    GorillaDecoder(const uchar *buffer, int bitLength, int valueCount, int count);
+
+    // Returns false at the end of the stream
+    bool next(qint64 *timestamp, double *values);
+
+private:
+    const uchar *m_buffer = nullptr;
+    qint64 m_bitLength = 0;
+    qint64 m_bitPosition = 0;
+    int m_valueCount = 1;
+    int m_count = 0;
+    int m_index = 0;
+
+    qint64 m_previousTimestamp = 0;
+    qint64 m_previousDelta = 0;
+    quint64 m_previousValues[GORILLA_MAX_VALUES] = {0};
+    int m_previousLeading[GORILLA_MAX_VALUES] = {0};
+    int m_previousTrailing[GORILLA_MAX_VALUES] = {0};
+
+    quint64 readBits(int bits);
+    qint64 readTimestamp();
+    quint64 readValue(int column);
+};
+
+#endif // GORILLACOMPRESSION_H
@@ -0,0 +1,444 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "historystore.h"
+
+#include <cstring>
+#include <algorithm>
+
+#include <QDir>
+
+#define HISTORY_MAGIC "NYSHIST"
+#define HISTORY_VERSION 1
+#define HISTORY_TIER_HEADER_SIZE 64
+
+HistoryTier::HistoryTier(const QString &fileName, qint64 resolution, int valueCount, int blockCount, int blockSize) :
+    m_file(fileName),
+    m_resolution(resolution),
+    m_valueCount(qBound(1, valueCount, GORILLA_MAX_VALUES)),
+    m_blockCount(qMax(2, blockCount)),
+    m_blockSize(qMax(256, blockSize))
+{
+
+}
+
+HistoryTier::~HistoryTier()
+{
+    close();
+}
+
+bool HistoryTier::open()
+{
+    if (isOpen())
+        return true;
+
+    if (!m_file.open(QFile::ReadWrite)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    // Recreate the file if the layout does not match
+    bool valid = m_file.size() == fileSize();
+    if (valid) {
+        TierHeader header;
+        valid = m_file.read(reinterpret_cast<char *>(&header), sizeof(header)) == sizeof(header)
+                && memcmp(header.magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) == 0
+                && header.version == HISTORY_VERSION
+                && header.valueCount == static_cast<quint32>(m_valueCount)
+                && header.blockSize == static_cast<quint32>(m_blockSize)
+                && header.blockCount == static_cast<quint32>(m_blockCount)
+                && header.resolution == m_resolution;
+    }
+
+    if (!valid) {
+        TierHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+        header.version = HISTORY_VERSION;
+        header.valueCount = static_cast<quint32>(m_valueCount);
+        header.blockSize = static_cast<quint32>(m_blockSize);
+        header.blockCount = static_cast<quint32>(m_blockCount);
+        header.resolution = m_resolution;
+
+        if (!m_file.resize(0) || !m_file.resize(fileSize()) || !m_file.seek(0)
+                || m_file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)) {
+            m_errorString = m_file.errorString();
+            m_file.close();
+            return false;
+        }
+        m_file.flush();
+    }
+
+    m_data = m_file.map(0, fileSize());
+    if (!m_data) {
+        m_errorString = m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    // Continue with the newest block
+    QVector<int> blocks = blocksInOrder();
+    if (blocks.isEmpty()) {
+        startBlock(0, 1);
+    } else {
+        resumeBlock(blocks.last());
+    }
+
+    return true;
+}
+
+void HistoryTier::close()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+bool HistoryTier::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+QString HistoryTier::fileName() const
+{
+    return m_file.fileName();
+}
+
+QString HistoryTier::errorString() const
+{
+    return m_errorString;
+}
+
+qint64 HistoryTier::resolution() const
+{
+    return m_resolution;
+}
+
+int HistoryTier::valueCount() const
+{
+    return m_valueCount;
+}
+
+qint64 HistoryTier::firstTimestamp() const
+{
+    if (!isOpen())
+        return 0;
+
+    QVector<int> blocks = blocksInOrder();
+    return blocks.isEmpty() ? 0 : blockHeader(blocks.first())->firstTimestamp;
+}
+
+qint64 HistoryTier::lastTimestamp() const
+{
+    if (!isOpen())
+        return 0;
+
+    BlockHeader *header = blockHeader(m_currentBlock);
+    return header->count > 0 ? header->lastTimestamp : firstTimestamp();
+}
+
+bool HistoryTier::append(qint64 timestamp, const double *values)
+{
+    if (!isOpen())
+        return false;
+
+    if (!m_encoder.append(timestamp, values)) {
+        // Block full, overwrite the oldest one
+        quint64 sequence = blockHeader(m_currentBlock)->sequence + 1;
+        startBlock((m_currentBlock + 1) % m_blockCount, sequence);
+        if (!m_encoder.append(timestamp, values))
+            return false;
+    }
+
+    // Note: the data is already in place, the header makes it visible
+    BlockHeader *header = blockHeader(m_currentBlock);
+    if (header->count == 0)
+        header->firstTimestamp = timestamp;
+
+    header->lastTimestamp = timestamp;
+    header->bitLength = static_cast<quint32>(m_encoder.bitLength());
+    header->count = static_cast<quint32>(m_encoder.count());
+    return true;
+}
+
+void HistoryTier::read(qint64 from, qint64 to, const std::function<void(qint64, const double *)> &function) const
+{
+    if (!isOpen())
+        return;
+
+    foreach (int block, blocksInOrder()) {
+        const BlockHeader *header = blockHeader(block);
+        if (header->lastTimestamp < from || header->firstTimestamp > to)
+            continue;
+
+        GorillaDecoder decoder(blockData(block), static_cast<int>(header->bitLength), m_valueCount, static_cast<int>(header->count));
+        qint64 timestamp = 0;
+        double values[GORILLA_MAX_VALUES];
+        while (decoder.next(&timestamp, values)) {
+            if (timestamp >= from && timestamp <= to) {
+                function(timestamp, values);
+            }
+        }
+    }
+}
+
+qint64 HistoryTier::fileSize() const
+{
+    return HISTORY_TIER_HEADER_SIZE + static_cast<qint64>(m_blockCount) * m_blockSize;
+}
+
+HistoryTier::BlockHeader *HistoryTier::blockHeader(int block) const
+{
+    return reinterpret_cast<BlockHeader *>(m_data + HISTORY_TIER_HEADER_SIZE + static_cast<qint64>(block) * m_blockSize);
+}
+
+uchar *HistoryTier::blockData(int block) const
+{
+    return reinterpret_cast<uchar *>(blockHeader(block)) + sizeof(BlockHeader);
+}
+
+QVector<int> HistoryTier::blocksInOrder() const
+{
+    QVector<int> blocks;
+    for (int i = 0; i < m_blockCount; i++) {
+        if (blockHeader(i)->sequence != 0 && blockHeader(i)->count > 0) {
+            blocks.append(i);
+        }
+    }
+
+    std::sort(blocks.begin(), blocks.end(), [this](int a, int b) {
+        return blockHeader(a)->sequence < blockHeader(b)->sequence;
+    });
+    return blocks;
+}
+
+void HistoryTier::startBlock(int block, quint64 sequence)
+{
+    BlockHeader *header = blockHeader(block);
+    memset(header, 0, static_cast<size_t>(m_blockSize));
+    header->sequence = sequence;
+    m_currentBlock = block;
+    m_encoder.reset(blockData(block), m_blockSize - static_cast<int>(sizeof(BlockHeader)), m_valueCount);
+}
+
+void HistoryTier::resumeBlock(int block)
+{
+    // The encoder state is not stored, decode the block and encode it again
+    BlockHeader *header = blockHeader(block);
+    QVector<qint64> timestamps;
+    QVector<double> values;
+    GorillaDecoder decoder(blockData(block), static_cast<int>(header->bitLength), m_valueCount, static_cast<int>(header->count));
+    qint64 timestamp = 0;
+    double pointValues[GORILLA_MAX_VALUES];
+    while (decoder.next(&timestamp, pointValues)) {
+        timestamps.append(timestamp);
+        for (int i = 0; i < m_valueCount; i++) {
+            values.append(pointValues[i]);
+        }
+    }
+
+    startBlock(block, header->sequence);
+    for (int i = 0; i < timestamps.count(); i++) {
+        append(timestamps.at(i), values.constData() + i * m_valueCount);
+    }
+}
+
+
+HistoryStore::HistoryStore(const QString &directory, const QString &seriesName) :
+    m_seriesName(seriesName)
+{
+    // Note: sizes per series ~2.3 MiB, retention depends on the compression:
+    // raw ~1.5 days at 1 sample/s, 1 min ~3 weeks, 15 min ~5 months, 1 h ~3 years
+    QString prefix = QDir(directory).filePath(seriesName);
+    m_rawTier = new HistoryTier(prefix + "-raw.hist", 1000, 1, 256);
+
+    Consolidation minute;
+    minute.name = "1min";
+    minute.tier = new HistoryTier(prefix + "-1min.hist", 60 * 1000, 3, 128);
+    m_consolidations.append(minute);
+
+    Consolidation quarterHour;
+    quarterHour.name = "15min";
+    quarterHour.tier = new HistoryTier(prefix + "-15min.hist", 15 * 60 * 1000, 3, 64);
+    m_consolidations.append(quarterHour);
+
+    Consolidation hour;
+    hour.name = "1h";
+    hour.tier = new HistoryTier(prefix + "-1h.hist", 60 * 60 * 1000, 3, 128);
+    m_consolidations.append(hour);
+}
+
+HistoryStore::~HistoryStore()
+{
+    delete m_rawTier;
+    foreach (const Consolidation &consolidation, m_consolidations) {
+        delete consolidation.tier;
+    }
+}
+
+QString HistoryStore::seriesName() const
+{
+    return m_seriesName;
+}
+
+bool HistoryStore::open()
+{
+    if (!m_rawTier->open())
+        return false;
+
+    foreach (const Consolidation &consolidation, m_consolidations) {
+        if (!consolidation.tier->open())
+            return false;
+    }
+
+    return true;
+}
+
+void HistoryStore::close()
+{
+    m_rawTier->close();
+    foreach (const Consolidation &consolidation, m_consolidations) {
+        consolidation.tier->close();
+    }
+}
+
+void HistoryStore::addValue(qint64 timestamp, double value)
+{
+    double storedValue = static_cast<double>(static_cast<float>(value));
+    m_rawTier->append(timestamp, &storedValue);
+
+    for (int i = 0; i < m_consolidations.count(); i++) {
+        consolidate(&m_consolidations[i], timestamp, storedValue);
+    }
+}
+
+QVector<HistoryStore::Point> HistoryStore::query(qint64 from, qint64 to, int maxPoints, QString *tierName) const
+{
+    QVector<Point> points;
+    if (to <= from || maxPoints <= 0)
+        return points;
+
+    // Finest tier covering the range which does not need to decode too many points
+    QList<QPair<QString, HistoryTier *> > tiers;
+    tiers.append(qMakePair(QString("raw"), m_rawTier));
+    foreach (const Consolidation &consolidation, m_consolidations) {
+        tiers.append(qMakePair(consolidation.name, consolidation.tier));
+    }
+
+    // On a young store no tier reaches back to from, then the tier with the earliest data within the range wins
+    int selected = -1;
+    int earliest = -1;
+    for (int i = 0; i < tiers.count(); i++) {
+        HistoryTier *tier = tiers.at(i).second;
+        if (tier->firstTimestamp() == 0 || tier->firstTimestamp() > to || tier->lastTimestamp() < from)
+            continue;
+
+        qint64 overlap = qMin(to, tier->lastTimestamp()) - qMax(from, tier->firstTimestamp());
+        if (i < tiers.count() - 1 && overlap / tier->resolution() > static_cast<qint64>(maxPoints) * 8)
+            continue;
+
+        if (tier->firstTimestamp() <= from) {
+            selected = i;
+            break;
+        }
+
+        if (earliest < 0 || tier->firstTimestamp() < tiers.at(earliest).second->firstTimestamp())
+            earliest = i;
+    }
+
+    if (selected < 0)
+        selected = earliest >= 0 ? earliest : tiers.count() - 1;
+
+    HistoryTier *tier = tiers.at(selected).second;
+    if (tierName)
+        *tierName = tiers.at(selected).first;
+
+    // Consolidate into maxPoints buckets
+    qint64 bucketSize = qMax<qint64>(1, (to - from + maxPoints - 1) / maxPoints);
+    QVector<Point> buckets(maxPoints);
+    QVector<int> counts(maxPoints, 0);
+    bool raw = tier->valueCount() == 1;
+    tier->read(from, to, [&](qint64 timestamp, const double *values) {
+        int index = qMin(maxPoints - 1, static_cast<int>((timestamp - from) / bucketSize));
+        Point &bucket = buckets[index];
+        double minimum = values[0];
+        double maximum = raw ? values[0] : values[1];
+        double average = raw ? values[0] : values[2];
+        if (counts.at(index) == 0) {
+            bucket.timestamp = from + index * bucketSize;
+            bucket.minimum = minimum;
+            bucket.maximum = maximum;
+            bucket.average = 0;
+        } else {
+            bucket.minimum = qMin(bucket.minimum, minimum);
+            bucket.maximum = qMax(bucket.maximum, maximum);
+        }
+        bucket.average += average;
+        counts[index]++;
+    });
+
+    for (int i = 0; i < maxPoints; i++) {
+        if (counts.at(i) == 0)
+            continue;
+
+        Point point = buckets.at(i);
+        point.average /= counts.at(i);
+        points.append(point);
+    }
+
+    return points;
+}
+
+void HistoryStore::consolidate(HistoryStore::Consolidation *consolidation, qint64 timestamp, double value)
+{
+    qint64 resolution = consolidation->tier->resolution();
+    qint64 bucketStart = timestamp - (timestamp % resolution);
+
+    // Bucket finished, store min/max/avg at the start of the bucket
+    if (consolidation->count > 0 && bucketStart != consolidation->bucketStart) {
+        double values[3] = {
+            consolidation->minimum,
+            consolidation->maximum,
+            static_cast<double>(static_cast<float>(consolidation->sum / consolidation->count))
+        };
+        consolidation->tier->append(consolidation->bucketStart, values);
+        consolidation->count = 0;
+    }
+
+    if (consolidation->count == 0) {
+        consolidation->bucketStart = bucketStart;
+        consolidation->minimum = value;
+        consolidation->maximum = value;
+        consolidation->sum = 0;
+    } else {
+        consolidation->minimum = qMin(consolidation->minimum, value);
+        consolidation->maximum = qMax(consolidation->maximum, value);
+    }
+
+    consolidation->sum += value;
+    consolidation->count++;
+}
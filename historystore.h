@@ -0,0 +1,151 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+#include "gorillacompression.h"
+
+// One fixed size, memory mapped ring of compressed blocks.
+//
+// The file never grows: once all blocks are used the oldest block gets
+// overwritten. Each block holds a Gorilla compressed run of points and its
+// time range, so reading a range only decodes the blocks overlapping it.
+
+class HistoryTier
+{
+public:
+    HistoryTier(const QString &fileName, qint64 resolution, int valueCount, int blockCount, int blockSize = 4096);
+    ~HistoryTier();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    QString fileName() const;
+    QString errorString() const;
+
+    // Nominal distance between two points [ms]
+    qint64 resolution() const;
+    int valueCount() const;
+
+    // Time range currently kept in the tier, 0 if empty
+    qint64 firstTimestamp() const;
+    qint64 lastTimestamp() const;
+
+    bool append(qint64 timestamp, const double *values);
+
+    // Calls function(timestamp, values) for every point within [from, to] in storage order
+    void read(qint64 from, qint64 to, const std::function<void(qint64, const double *)> &function) const;
+
+private:
+    struct TierHeader {
+        char magic[8];
+        quint32 version;
+        quint32 valueCount;
+        quint32 blockSize;
+        quint32 blockCount;
+        qint64 resolution;
+    };
+
+    struct BlockHeader {
+        quint64 sequence; // 0 = unused
+        qint64 firstTimestamp;
+        qint64 lastTimestamp;
+        quint32 count;
+        quint32 bitLength;
+    };
+
+    QFile m_file;
+    uchar *m_data = nullptr;
+    qint64 m_resolution = 0;
+    int m_valueCount = 1;
+    int m_blockCount = 0;
+    int m_blockSize = 0;
+    QString m_errorString;
+
+    int m_currentBlock = 0;
+    GorillaEncoder m_encoder;
+
+    qint64 fileSize() const;
+    BlockHeader *blockHeader(int block) const;
+    uchar *blockData(int block) const;
+    QVector<int> blocksInOrder() const;
+    void startBlock(int block, quint64 sequence);
+    void resumeBlock(int block);
+};
+
+// Bounded long term history of one value series.
+//
+// Every value goes into the raw tier and gets consolidated into min/max/avg
+// points of the 1 min, 15 min and 1 h tiers. Values are stored with float
+// precision, which leaves enough trailing zeros for the XOR compression.
+// Note: the consolidation bucket in progress is kept in memory only.
+
+class HistoryStore
+{
+public:
+    struct Point {
+        qint64 timestamp = 0;
+        double minimum = 0;
+        double maximum = 0;
+        double average = 0;
+    };
+
+    HistoryStore(const QString &directory, const QString &seriesName);
+    ~HistoryStore();
+
+    QString seriesName() const;
+
+    bool open();
+    void close();
+
+    void addValue(qint64 timestamp, double value);
+
+    // At most maxPoints points within [from, to], read from the finest tier
+    // covering the range without decoding more than a few times maxPoints points.
+    QVector<Point> query(qint64 from, qint64 to, int maxPoints, QString *tierName = nullptr) const;
+
+private:
+    struct Consolidation {
+        QString name;
+        HistoryTier *tier = nullptr;
+        qint64 bucketStart = -1;
+        double minimum = 0;
+        double maximum = 0;
+        double sum = 0;
+        int count = 0;
+    };
+
+    QString m_seriesName;
+    HistoryTier *m_rawTier = nullptr;
+    QList<Consolidation> m_consolidations;
+
+    void consolidate(Consolidation *consolidation, qint64 timestamp, double value);
+};
+
+#endif // HISTORYSTORE_H
@@ -33,11 +33,34 @@
 #include <linux/i2c-dev.h>
 
 #include <QDir>
+#include <QHash>
+#include <QMutexLocker>
+
+// Note: per bus state shared between all ports and sensor threads, the entries live until the process ends
+struct I2CBusState {
+    QMutex mutex;
+    QHash<int, int> multiplexerChannels; // Selected channel per mux, -1 = disabled, -2 = unknown
+};
+
+static QMutex s_busStatesMutex;
+static QHash<QString, I2CBusState *> s_busStates;
+
+static I2CBusState *busState(const QString &portName)
+{
+    QMutexLocker locker(&s_busStatesMutex);
+    I2CBusState *state = s_busStates.value(portName);
+    if (!state) {
+        state = new I2CBusState();
+        s_busStates.insert(portName, state);
+    }
+    return state;
+}
 
 I2CPort::I2CPort(const QString &portName, QObject *parent) :
     QObject(parent),
     d_ptr(new I2CPortPrivate(this))
 {
+    d_ptr->portName = portName;
     d_ptr->portDeviceName = "/dev/" + portName;
     d_ptr->fileDescriptor.setFileName(d_ptr->portDeviceName);
 }
@@ -82,6 +105,74 @@ bool I2CPort::isValid() const
     return d_ptr->isValid();
 }
 
+bool I2CPort::selectMultiplexerChannel(int muxAddress, int channel)
+{
+    if (!isOpen())
+        return false;
+
+    QMutexLocker locker(busMutex(d_ptr->portName));
+    return selectMultiplexerChannel(d_ptr->portName, d_ptr->deviceDescriptor, muxAddress, channel);
+}
+
+QMutex *I2CPort::busMutex(const QString &portName)
+{
+    return &busState(portName)->mutex;
+}
+
+bool I2CPort::selectMultiplexerChannel(const QString &portName, int fileDescriptor, int muxAddress, int channel)
+{
+    // Note: the bus mutex must be locked
+    I2CBusState *state = busState(portName);
+    if (state->multiplexerChannels.value(muxAddress, -2) == channel)
+        return true;
+
+    // A channel stays connected after use, only one mux on the bus may have
+    // an enabled channel or the chips behind both would answer at once
+    foreach (int otherAddress, state->multiplexerChannels.keys()) {
+        if (otherAddress == muxAddress || state->multiplexerChannels.value(otherAddress) == -1)
+            continue;
+
+        if (!writeMultiplexer(portName, fileDescriptor, otherAddress, 0x00)) {
+            state->multiplexerChannels.insert(otherAddress, -2);
+            return false;
+        }
+        state->multiplexerChannels.insert(otherAddress, -1);
+    }
+
+    // TCA9548A: one control byte, each bit enables one channel
+    if (!writeMultiplexer(portName, fileDescriptor, muxAddress, static_cast<unsigned char>(1 << channel))) {
+        state->multiplexerChannels.insert(muxAddress, -2);
+        return false;
+    }
+
+    state->multiplexerChannels.insert(muxAddress, channel);
+    return true;
+}
+
+void I2CPort::invalidateMultiplexerCache(const QString &portName)
+{
+    // Note: the muxes stay known, so they get disabled before the next selection
+    I2CBusState *state = busState(portName);
+    foreach (int muxAddress, state->multiplexerChannels.keys()) {
+        state->multiplexerChannels.insert(muxAddress, -2);
+    }
+}
+
+bool I2CPort::writeMultiplexer(const QString &portName, int fileDescriptor, int muxAddress, unsigned char mask)
+{
+    if (ioctl(fileDescriptor, I2C_SLAVE, muxAddress) < 0) {
+        qCWarning(dcHardware()) << "Could not address I2C multiplexer" << portName << QString("0x%1").arg(muxAddress, 0, 16);
+        return false;
+    }
+
+    if (write(fileDescriptor, &mask, 1) != 1) {
+        qCWarning(dcHardware()) << "Could not write the channel mask" << mask << "to the I2C multiplexer" << portName << QString("0x%1").arg(muxAddress, 0, 16);
+        return false;
+    }
+
+    return true;
+}
+
 bool I2CPort::openPort(int i2cAddress)
 {
     return d_ptr->openPort(i2cAddress);
@@ -172,3 +263,51 @@ void I2CPortPrivate::closePort()
     deviceDescriptor = -1;
     valid = false;
 }
+
+static thread_local I2CBusStatistics *s_threadStatistics = nullptr;
+
+I2CBusLocker::I2CBusLocker(const QString &portName, int fileDescriptor, int muxAddress, int muxChannel, int chipAddress) :
+    m_statistics(s_threadStatistics)
+{
+    if (m_statistics)
+        m_timer.start();
+
+    if (muxAddress >= 0) {
+        m_mutex = I2CPort::busMutex(portName);
+        m_mutex->lock();
+        if (!I2CPort::selectMultiplexerChannel(portName, fileDescriptor, muxAddress, muxChannel))
+            return;
+    }
+
+    m_valid = ioctl(fileDescriptor, I2C_SLAVE, chipAddress) >= 0;
+}
+
+I2CBusLocker::~I2CBusLocker()
+{
+    if (m_mutex) {
+        m_mutex->unlock();
+    }
+
+    if (m_statistics) {
+        qint64 duration = m_timer.nsecsElapsed();
+        m_statistics->transactions.fetch_add(1, std::memory_order_relaxed);
+        m_statistics->durationSum.fetch_add(duration, std::memory_order_relaxed);
+        if (duration > m_statistics->durationMax.load(std::memory_order_relaxed)) {
+            m_statistics->durationMax.store(duration, std::memory_order_relaxed);
+        }
+
+        if (!m_valid) {
+            m_statistics->failures.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool I2CBusLocker::isValid() const
+{
+    return m_valid;
+}
+
+void I2CBusLocker::setThreadStatistics(I2CBusStatistics *statistics)
+{
+    s_threadStatistics = statistics;
+}
@@ -23,7 +23,11 @@
 #ifndef I2CPORT_H
 #define I2CPORT_H
 
+#include <atomic>
+
+#include <QMutex>
 #include <QObject>
+#include <QElapsedTimer>
 
 class I2CPortPrivate;
 
@@ -45,6 +49,15 @@ public:
     bool isOpen() const;
     bool isValid() const;
 
+    // TCA9548A I2C multiplexer, shared between all ports on the same bus
+    bool selectMultiplexerChannel(int muxAddress, int channel);
+
+    static QMutex *busMutex(const QString &portName);
+    // The bus mutex must be locked, selecting a channel disables all other known muxes on the bus
+    static bool selectMultiplexerChannel(const QString &portName, int fileDescriptor, int muxAddress, int channel);
+    // The bus mutex must be locked, call this after anything wrote the mux control registers behind the cache
+    static void invalidateMultiplexerCache(const QString &portName);
+
 public slots:
     bool openPort(int i2cAddress = 0);
     void closePort();
@@ -52,6 +65,43 @@ public slots:
 private:
     I2CPortPrivate *d_ptr = nullptr;
 
+    static bool writeMultiplexer(const QString &portName, int fileDescriptor, int muxAddress, unsigned char mask);
+
+};
+
+// Bus transaction statistics of one thread, filled by the I2CBusLocker
+struct I2CBusStatistics {
+    std::atomic<quint64> transactions { 0 };
+    std::atomic<quint64> failures { 0 };
+    std::atomic<qint64> durationSum { 0 }; // [ns], including the wait for the bus lock
+    std::atomic<qint64> durationMax { 0 }; // [ns]
+};
+
+// Locks the bus of a chip behind a TCA9548A multiplexer and selects its channel.
+//
+// The mux channel gets cached per bus, the switch write only happens if the
+// channel actually changes. Group all transactions of one measurement cycle
+// within one locker. Chips without multiplexer (muxAddress < 0) do not lock.
+
+class I2CBusLocker
+{
+public:
+    I2CBusLocker(const QString &portName, int fileDescriptor, int muxAddress, int muxChannel, int chipAddress);
+    ~I2CBusLocker();
+
+    // False if the mux channel or the chip address could not be selected
+    bool isValid() const;
+
+    // Lockers created in the calling thread record their lifetime into the given statistics
+    static void setThreadStatistics(I2CBusStatistics *statistics);
+
+private:
+    QMutex *m_mutex = nullptr;
+    bool m_valid = false;
+    I2CBusStatistics *m_statistics = nullptr;
+    QElapsedTimer m_timer;
+
+    Q_DISABLE_COPY(I2CBusLocker)
 };
 
 #endif // I2CPORT_H
@@ -0,0 +1,234 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "metricsexporter.h"
+#include "airqualitymonitor.h"
+#include "extern-plugininfo.h"
+
+#include <QSaveFile>
+#include <QElapsedTimer>
+
+MetricsExporter::MetricsExporter(QObject *parent) :
+    QObject(parent)
+{
+    m_timer = new QTimer(this);
+    m_timer->setInterval(15000);
+    connect(m_timer, &QTimer::timeout, this, &MetricsExporter::exportMetrics);
+}
+
+QString MetricsExporter::fileName() const
+{
+    return m_fileName;
+}
+
+void MetricsExporter::setFileName(const QString &fileName)
+{
+    m_fileName = fileName;
+    updateTimer();
+}
+
+int MetricsExporter::interval() const
+{
+    return m_timer->interval() / 1000;
+}
+
+void MetricsExporter::setInterval(int interval)
+{
+    m_timer->setInterval(qMax(1, interval) * 1000);
+}
+
+void MetricsExporter::setMonitors(const QList<AirQualityMonitor *> &monitors)
+{
+    m_monitors = monitors;
+    m_rateStates.clear();
+    updateTimer();
+}
+
+static QByteArray escapeLabel(const QString &value)
+{
+    QString escaped = value;
+    escaped.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return escaped.toUtf8();
+}
+
+QByteArray MetricsExporter::render()
+{
+    struct SensorEntry {
+        QByteArray labels;
+        SensorThread::Metrics metrics;
+        quint64 droppedCaptureSamples = 0;
+        double sampleRate = 0;
+        bool adc = false;
+        quint64 droppedConversions = 0;
+    };
+
+    struct FilterEntry {
+        QByteArray labels;
+        double fill = 0;
+        bool ready = false;
+    };
+
+    // Collect everything first, each metric family has to be written in one block
+    QElapsedTimer clock;
+    clock.start();
+    qint64 now = clock.msecsSinceReference();
+
+    QList<QByteArray> deviceLabels;
+    QList<SensorEntry> sensorEntries;
+    QList<FilterEntry> filterEntries;
+    foreach (AirQualityMonitor *monitor, m_monitors) {
+        QByteArray device = "device=\"" + escapeLabel(monitor->device()->id().toString().remove('{').remove('}')) + "\"";
+        deviceLabels.append(device + ",name=\"" + escapeLabel(monitor->device()->name()) + "\"");
+
+        foreach (SensorThread *sensor, monitor->sensors()) {
+            SensorEntry entry;
+            entry.labels = device + ",sensor=\"" + escapeLabel(sensor->sensorName()) + "\"";
+            entry.metrics = sensor->metrics();
+            entry.droppedCaptureSamples = sensor->droppedCaptureSamples();
+
+            ADS1115 *adc = qobject_cast<ADS1115 *>(sensor);
+            if (adc) {
+                entry.adc = true;
+                entry.droppedConversions = adc->droppedConversions();
+            }
+
+            RateState &state = m_rateStates[sensor];
+            if (state.timestamp > 0 && now > state.timestamp && entry.metrics.samples >= state.samples)
+                entry.sampleRate = (entry.metrics.samples - state.samples) * 1000.0 / (now - state.timestamp);
+
+            state.samples = entry.metrics.samples;
+            state.timestamp = now;
+            sensorEntries.append(entry);
+        }
+
+        QHash<QString, SensorDataFilter *> filters = monitor->filters();
+        foreach (const QString &filterName, filters.keys()) {
+            SensorDataFilter *filter = filters.value(filterName);
+            FilterEntry entry;
+            entry.labels = device + ",filter=\"" + escapeLabel(filterName) + "\"";
+            entry.fill = qMin(1.0, static_cast<double>(filter->inputData().size()) / filter->windowSize());
+            entry.ready = filter->isReady();
+            filterEntries.append(entry);
+        }
+    }
+
+    QByteArray data;
+    auto family = [&data](const char *name, const char *type, const char *help) {
+        data += QByteArray("# HELP ") + name + " " + help + "\n";
+        data += QByteArray("# TYPE ") + name + " " + type + "\n";
+    };
+
+    auto sample = [&data](const char *name, const QByteArray &labels, double value) {
+        data += QByteArray(name) + "{" + labels + "} " + QByteArray::number(value, 'g', 12) + "\n";
+    };
+
+    family("sensorstation_info", "gauge", "Configured sensor stations.");
+    foreach (const QByteArray &labels, deviceLabels)
+        sample("sensorstation_info", labels, 1);
+
+    family("sensorstation_samples_total", "counter", "Samples read from the sensor.");
+    foreach (const SensorEntry &entry, sensorEntries)
+        sample("sensorstation_samples_total", entry.labels, entry.metrics.samples);
+
+    family("sensorstation_sample_rate_hertz", "gauge", "Samples per second since the last export.");
+    foreach (const SensorEntry &entry, sensorEntries)
+        sample("sensorstation_sample_rate_hertz", entry.labels, entry.sampleRate);
+
+    family("sensorstation_errors_total", "counter", "Failed sensor readings and configurations.");
+    foreach (const SensorEntry &entry, sensorEntries)
+        sample("sensorstation_errors_total", entry.labels, entry.metrics.errors);
+
+    family("sensorstation_recoveries_total", "counter", "Chip re-initializations after a failed health check.");
+    foreach (const SensorEntry &entry, sensorEntries)
+        sample("sensorstation_recoveries_total", entry.labels, entry.metrics.recoveries);
+
+    family("sensorstation_capture_dropped_total", "counter", "Raw capture samples dropped because the writer fell behind.");
+    foreach (const SensorEntry &entry, sensorEntries)
+        sample("sensorstation_capture_dropped_total", entry.labels, entry.droppedCaptureSamples);
+
+    family("sensorstation_streaming_dropped_total", "counter", "ADC conversions missed while streaming, replaced by the previous value.");
+    foreach (const SensorEntry &entry, sensorEntries) {
+        if (entry.adc)
+            sample("sensorstation_streaming_dropped_total", entry.labels, entry.droppedConversions);
+    }
+
+    family("sensorstation_i2c_transaction_seconds", "summary", "Duration of the I2C bus transactions, including the wait for the bus lock.");
+    foreach (const SensorEntry &entry, sensorEntries) {
+        sample("sensorstation_i2c_transaction_seconds_sum", entry.labels, entry.metrics.i2cDurationSum / 1e9);
+        sample("sensorstation_i2c_transaction_seconds_count", entry.labels, entry.metrics.i2cTransactions);
+    }
+
+    family("sensorstation_i2c_transaction_max_seconds", "gauge", "Longest I2C bus transaction since the last export.");
+    foreach (const SensorEntry &entry, sensorEntries)
+        sample("sensorstation_i2c_transaction_max_seconds", entry.labels, entry.metrics.i2cDurationMax / 1e9);
+
+    family("sensorstation_i2c_failures_total", "counter", "I2C transactions where the multiplexer channel or the chip address could not be selected.");
+    foreach (const SensorEntry &entry, sensorEntries)
+        sample("sensorstation_i2c_failures_total", entry.labels, entry.metrics.i2cFailures);
+
+    family("sensorstation_thread_cpu_seconds_total", "counter", "CPU time used by the sensor thread.");
+    foreach (const SensorEntry &entry, sensorEntries)
+        sample("sensorstation_thread_cpu_seconds_total", entry.labels, entry.metrics.cpuTime / 1e9);
+
+    family("sensorstation_thread_wakeups_total", "counter", "Wake ups of the sensor thread.");
+    foreach (const SensorEntry &entry, sensorEntries)
+        sample("sensorstation_thread_wakeups_total", entry.labels, entry.metrics.wakeUps);
+
+    family("sensorstation_filter_fill_ratio", "gauge", "Fill level of the filter window.");
+    foreach (const FilterEntry &entry, filterEntries)
+        sample("sensorstation_filter_fill_ratio", entry.labels, entry.fill);
+
+    family("sensorstation_filter_ready", "gauge", "Whether the filter has enough samples for a valid value.");
+    foreach (const FilterEntry &entry, filterEntries)
+        sample("sensorstation_filter_ready", entry.labels, entry.ready ? 1 : 0);
+
+    return data;
+}
+
+bool MetricsExporter::exportMetrics()
+{
+    if (m_fileName.isEmpty())
+        return false;
+
+    QSaveFile file(m_fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcSensorStation()) << "Could not open the metrics file" << m_fileName << file.errorString();
+        return false;
+    }
+
+    file.write(render());
+    if (!file.commit()) {
+        qCWarning(dcSensorStation()) << "Could not write the metrics file" << m_fileName << file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+void MetricsExporter::updateTimer()
+{
+    if (m_fileName.isEmpty() || m_monitors.isEmpty()) {
+        m_timer->stop();
+    } else if (!m_timer->isActive()) {
+        m_timer->start();
+    }
+}
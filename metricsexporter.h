@@ -0,0 +1,75 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <QHash>
+#include <QTimer>
+#include <QObject>
+
+class AirQualityMonitor;
+class SensorThread;
+
+// Periodically writes the runtime metrics of all sensor stations in the
+// Prometheus text format, e.g. for the textfile collector of node_exporter.
+//
+// The sensor threads only bump relaxed atomic counters, all the formatting
+// happens here in the main thread. The file gets replaced atomically, so a
+// scraper never reads a partially written file.
+
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsExporter(QObject *parent = nullptr);
+
+    // Empty file name disables the export
+    QString fileName() const;
+    void setFileName(const QString &fileName);
+
+    int interval() const;
+    void setInterval(int interval);
+
+    void setMonitors(const QList<AirQualityMonitor *> &monitors);
+
+    QByteArray render();
+
+public slots:
+    bool exportMetrics();
+
+private:
+    QTimer *m_timer = nullptr;
+    QString m_fileName;
+    QList<AirQualityMonitor *> m_monitors;
+
+    // Sample counters of the last export, for the current sample rate
+    struct RateState {
+        quint64 samples = 0;
+        qint64 timestamp = 0;
+    };
+    QHash<SensorThread *, RateState> m_rateStates;
+
+    void updateTimer();
+};
+
+#endif // METRICSEXPORTER_H
@@ -1,10 +1,16 @@
 #/bin/bash
 
-scp root@10.10.10.120:/tmp/sensordata.log .
+# Usage: ./plot-all.sh <sensor station device id>
+# Note: build tools/plotdownsample first, or set PLOTDOWNSAMPLE to the binary
+PLOTDOWNSAMPLE=${PLOTDOWNSAMPLE:-../tools/plotdownsample/plotdownsample}
+
+scp root@10.10.10.120:/tmp/sensordata-$1.slog sensordata.slog
+
+# Read the log once and reduce every plot to a constant number of points
+$PLOTDOWNSAMPLE --points 2000 sensordata.slog
 
 gnuplot plot-temperature.plot
 gnuplot plot-lux.plot
 gnuplot plot-pressure.plot
 gnuplot plot-humidity.plot
 gnuplot plot-ppm.plot
-gnuplot plot-temperature.plot
@@ -17,5 +17,6 @@ set grid
 # labels
 set label "Humidity smoothing"
 
-plot 'sensordata.log' using 1:4 with points title 'Measurment', \
-     'sensordata.log' using 1:5 with lines title 'Smoothed'
+# Note: humidity.dat gets written by tools/plotdownsample, index 0 = measurement, index 1 = smoothed
+plot 'humidity.dat' index 0 using 1:2 with points title 'Measurment', \
+     'humidity.dat' index 1 using 1:2 with lines title 'Smoothed'
@@ -17,5 +17,6 @@ set grid
 # labels
 set label "Light intensity smoothing"
 
-plot 'sensordata.log' using 1:8 with points title 'Measurment', \
-     'sensordata.log' using 1:9 with lines title 'Smoothed'
+# Note: lux.dat gets written by tools/plotdownsample, index 0 = measurement, index 1 = smoothed
+plot 'lux.dat' index 0 using 1:2 with points title 'Measurment', \
+     'lux.dat' index 1 using 1:2 with lines title 'Smoothed'
@@ -17,5 +17,6 @@ set grid
 # labels
 set label "Air quality smoothing"
 
-plot 'sensordata.log' using 1:10 with points title 'Measurment', \
-     'sensordata.log' using 1:11 with lines title 'Smoothed'
+# Note: ppm.dat gets written by tools/plotdownsample, index 0 = measurement, index 1 = smoothed
+plot 'ppm.dat' index 0 using 1:2 with points title 'Measurment', \
+     'ppm.dat' index 1 using 1:2 with lines title 'Smoothed'
@@ -17,5 +17,6 @@ set grid
 # labels
 set label "Pressure smoothing"
 
-plot 'sensordata.log' using 1:6 with points title 'Measurment', \
-     'sensordata.log' using 1:7 with lines title 'Smoothed'
+# Note: pressure.dat gets written by tools/plotdownsample, index 0 = measurement, index 1 = smoothed
+plot 'pressure.dat' index 0 using 1:2 with points title 'Measurment', \
+     'pressure.dat' index 1 using 1:2 with lines title 'Smoothed'
@@ -17,5 +17,6 @@ set grid
 # labels
 set label "Temperature smoothing"
 
-plot 'sensordata.log' using 1:2 with points title 'Measurment', \
-     'sensordata.log' using 1:3 with lines title 'Smoothed'
+# Note: temperature.dat gets written by tools/plotdownsample, index 0 = measurement, index 1 = smoothed
+plot 'temperature.dat' index 0 using 1:2 with points title 'Measurment', \
+     'temperature.dat' index 1 using 1:2 with lines title 'Smoothed'
@@ -0,0 +1,132 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "pressuretendency.h"
+
+PressureTendency::PressureTendency(qint64 window, qint64 resolution) :
+    m_window(window),
+    m_resolution(qMax<qint64>(1, resolution))
+{
+    // One bucket more than the window, the oldest one leaves once the newest one is complete
+    m_points.resize(static_cast<int>(m_window / m_resolution) + 2);
+}
+
+void PressureTendency::addValue(qint64 timestamp, double pressure)
+{
+    qint64 bucketStart = timestamp - (timestamp % m_resolution);
+    if (m_bucketStart >= 0 && bucketStart != m_bucketStart)
+        closeBucket();
+
+    if (m_bucketStart < 0) {
+        m_bucketStart = bucketStart;
+        m_bucketSum = 0;
+        m_bucketCount = 0;
+    }
+
+    m_bucketSum += pressure;
+    m_bucketCount++;
+}
+
+bool PressureTendency::isValid() const
+{
+    if (m_count < 3)
+        return false;
+
+    const Point &first = m_points.at(m_first);
+    const Point &last = m_points.at((m_first + m_count - 1) % m_points.count());
+    return (last.x - first.x) * m_resolution >= m_window / 3;
+}
+
+double PressureTendency::tendency() const
+{
+    double n = m_count;
+    double denominator = n * m_sumXX - m_sumX * m_sumX;
+    if (m_count < 2 || qFuzzyIsNull(denominator))
+        return 0;
+
+    double slope = (n * m_sumXY - m_sumX * m_sumY) / denominator;
+    return slope * m_window / m_resolution;
+}
+
+void PressureTendency::clear()
+{
+    m_first = 0;
+    m_count = 0;
+    m_originTime = -1;
+    m_sumX = m_sumY = m_sumXX = m_sumXY = 0;
+    m_bucketStart = -1;
+}
+
+void PressureTendency::closeBucket()
+{
+    double value = m_bucketSum / m_bucketCount;
+    if (m_originTime < 0) {
+        m_originTime = m_bucketStart;
+        m_originValue = value;
+    }
+
+    Point point;
+    point.x = static_cast<double>(m_bucketStart - m_originTime) / m_resolution;
+    point.y = value - m_originValue;
+    m_bucketStart = -1;
+
+    // Drop the buckets which left the window
+    double windowStart = point.x - static_cast<double>(m_window) / m_resolution;
+    while (m_count > 0 && (m_points.at(m_first).x < windowStart || m_count == m_points.count())) {
+        const Point &oldest = m_points.at(m_first);
+        m_sumX -= oldest.x;
+        m_sumY -= oldest.y;
+        m_sumXX -= oldest.x * oldest.x;
+        m_sumXY -= oldest.x * oldest.y;
+        m_first = (m_first + 1) % m_points.count();
+        m_count--;
+    }
+
+    m_points[(m_first + m_count) % m_points.count()] = point;
+    m_count++;
+    m_sumX += point.x;
+    m_sumY += point.y;
+    m_sumXX += point.x * point.x;
+    m_sumXY += point.x * point.y;
+
+    // Move the origin along with the window, happens once every few windows (amortized O(1))
+    if (point.x > 4.0 * m_points.count())
+        rebase();
+}
+
+void PressureTendency::rebase()
+{
+    const Point first = m_points.at(m_first);
+    m_originTime += static_cast<qint64>(first.x + 0.5) * m_resolution;
+    m_originValue += first.y;
+
+    m_sumX = m_sumY = m_sumXX = m_sumXY = 0;
+    for (int i = 0; i < m_count; i++) {
+        Point &point = m_points[(m_first + i) % m_points.count()];
+        point.x -= first.x;
+        point.y -= first.y;
+        m_sumX += point.x;
+        m_sumY += point.y;
+        m_sumXX += point.x * point.x;
+        m_sumXY += point.x * point.y;
+    }
+}
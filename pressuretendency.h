@@ -0,0 +1,82 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PRESSURETENDENCY_H
+#define PRESSURETENDENCY_H
+
+#include <QVector>
+
+// Pressure change over a time window (by default the 3 hour tendency of the WMO),
+// as the slope of a least squares line through the recent pressure values.
+//
+// The samples get averaged into buckets (1 minute by default), the buckets are kept
+// in a ring buffer of fixed size. The regression sums get updated when a bucket
+// enters or leaves the window, so every sample costs O(1) independent of the
+// window length. Times and values are relative to an origin, which moves with
+// the window to keep the sums well conditioned.
+
+class PressureTendency
+{
+public:
+    explicit PressureTendency(qint64 window = 3 * 3600 * 1000, qint64 resolution = 60 * 1000);
+
+    void addValue(qint64 timestamp, double pressure);
+
+    // True once the buckets cover at least a third of the window
+    bool isValid() const;
+
+    // Change over the whole window [hPa / window] according to the regression line
+    double tendency() const;
+
+    void clear();
+
+private:
+    struct Point {
+        double x = 0; // [resolution] since the origin
+        double y = 0; // [hPa] relative to the origin
+    };
+
+    qint64 m_window;
+    qint64 m_resolution;
+
+    QVector<Point> m_points;
+    int m_first = 0;
+    int m_count = 0;
+
+    qint64 m_originTime = -1;
+    double m_originValue = 0;
+
+    double m_sumX = 0;
+    double m_sumY = 0;
+    double m_sumXX = 0;
+    double m_sumXY = 0;
+
+    // Bucket in progress
+    qint64 m_bucketStart = -1;
+    double m_bucketSum = 0;
+    int m_bucketCount = 0;
+
+    void closeBucket();
+    void rebase();
+};
+
+#endif // PRESSURETENDENCY_H
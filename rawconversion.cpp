@@ -0,0 +1,180 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "rawconversion.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define RAWCONVERSION_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RAWCONVERSION_NEON
+#endif
+
+// Note: the frames get loaded as 32 bit lanes (first code in the low half), little endian only
+Q_STATIC_ASSERT(sizeof(Sht30Frame) == 4);
+Q_STATIC_ASSERT(sizeof(Tsl2561Frame) == 4);
+
+void RawConversion::convertSht30(const Sht30Frame *frames, double *temperature, double *humidity, int count)
+{
+    int i = 0;
+
+    // Note: (double)raw * 175.0 is exact and equals (double)(175 * raw) of the scalar formula
+#if defined(RAWCONVERSION_SSE2)
+    const __m128i mask = _mm_set1_epi32(0xFFFF);
+    const __m128d temperatureScale = _mm_set1_pd(175.0);
+    const __m128d temperatureOffset = _mm_set1_pd(-45.0);
+    const __m128d humidityScale = _mm_set1_pd(100.0);
+    const __m128d fullScale = _mm_set1_pd(65535.0);
+    for (; i + 4 <= count; i += 4) {
+        __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(frames + i));
+        __m128i temperatureRaw = _mm_and_si128(lanes, mask);
+        __m128i humidityRaw = _mm_srli_epi32(lanes, 16);
+
+        __m128d temperatureLow = _mm_cvtepi32_pd(temperatureRaw);
+        __m128d temperatureHigh = _mm_cvtepi32_pd(_mm_shuffle_epi32(temperatureRaw, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_storeu_pd(temperature + i, _mm_add_pd(temperatureOffset, _mm_div_pd(_mm_mul_pd(temperatureLow, temperatureScale), fullScale)));
+        _mm_storeu_pd(temperature + i + 2, _mm_add_pd(temperatureOffset, _mm_div_pd(_mm_mul_pd(temperatureHigh, temperatureScale), fullScale)));
+
+        __m128d humidityLow = _mm_cvtepi32_pd(humidityRaw);
+        __m128d humidityHigh = _mm_cvtepi32_pd(_mm_shuffle_epi32(humidityRaw, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_storeu_pd(humidity + i, _mm_div_pd(_mm_mul_pd(humidityLow, humidityScale), fullScale));
+        _mm_storeu_pd(humidity + i + 2, _mm_div_pd(_mm_mul_pd(humidityHigh, humidityScale), fullScale));
+    }
+#elif defined(RAWCONVERSION_NEON)
+    const float64x2_t temperatureScale = vdupq_n_f64(175.0);
+    const float64x2_t temperatureOffset = vdupq_n_f64(-45.0);
+    const float64x2_t humidityScale = vdupq_n_f64(100.0);
+    const float64x2_t fullScale = vdupq_n_f64(65535.0);
+    for (; i + 4 <= count; i += 4) {
+        // Deinterleaves the temperature and humidity codes
+        uint16x4x2_t codes = vld2_u16(reinterpret_cast<const uint16_t *>(frames + i));
+        uint32x4_t temperatureRaw = vmovl_u16(codes.val[0]);
+        uint32x4_t humidityRaw = vmovl_u16(codes.val[1]);
+
+        float64x2_t temperatureLow = vcvtq_f64_u64(vmovl_u32(vget_low_u32(temperatureRaw)));
+        float64x2_t temperatureHigh = vcvtq_f64_u64(vmovl_u32(vget_high_u32(temperatureRaw)));
+        vst1q_f64(temperature + i, vaddq_f64(temperatureOffset, vdivq_f64(vmulq_f64(temperatureLow, temperatureScale), fullScale)));
+        vst1q_f64(temperature + i + 2, vaddq_f64(temperatureOffset, vdivq_f64(vmulq_f64(temperatureHigh, temperatureScale), fullScale)));
+
+        float64x2_t humidityLow = vcvtq_f64_u64(vmovl_u32(vget_low_u32(humidityRaw)));
+        float64x2_t humidityHigh = vcvtq_f64_u64(vmovl_u32(vget_high_u32(humidityRaw)));
+        vst1q_f64(humidity + i, vdivq_f64(vmulq_f64(humidityLow, humidityScale), fullScale));
+        vst1q_f64(humidity + i + 2, vdivq_f64(vmulq_f64(humidityHigh, humidityScale), fullScale));
+    }
+#endif
+
+    convertSht30Reference(frames + i, temperature + i, humidity + i, count - i);
+}
+
+void RawConversion::convertAds1115(const qint16 *raw, double *voltage, int count)
+{
+    int i = 0;
+
+#if defined(RAWCONVERSION_SSE2)
+    const __m128d scale = _mm_set1_pd(4.096);
+    const __m128d fullScale = _mm_set1_pd(32767.0);
+    for (; i + 8 <= count; i += 8) {
+        // Sign extend the codes to 32 bit
+        __m128i codes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i));
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(codes, codes), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(codes, codes), 16);
+
+        _mm_storeu_pd(voltage + i, _mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(low), scale), fullScale));
+        _mm_storeu_pd(voltage + i + 2, _mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(low, _MM_SHUFFLE(1, 0, 3, 2))), scale), fullScale));
+        _mm_storeu_pd(voltage + i + 4, _mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(high), scale), fullScale));
+        _mm_storeu_pd(voltage + i + 6, _mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(high, _MM_SHUFFLE(1, 0, 3, 2))), scale), fullScale));
+    }
+#elif defined(RAWCONVERSION_NEON)
+    const float64x2_t scale = vdupq_n_f64(4.096);
+    const float64x2_t fullScale = vdupq_n_f64(32767.0);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t codes = vld1q_s16(raw + i);
+        int32x4_t low = vmovl_s16(vget_low_s16(codes));
+        int32x4_t high = vmovl_s16(vget_high_s16(codes));
+
+        vst1q_f64(voltage + i, vdivq_f64(vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(low))), scale), fullScale));
+        vst1q_f64(voltage + i + 2, vdivq_f64(vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_high_s32(low))), scale), fullScale));
+        vst1q_f64(voltage + i + 4, vdivq_f64(vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(high))), scale), fullScale));
+        vst1q_f64(voltage + i + 6, vdivq_f64(vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_high_s32(high))), scale), fullScale));
+    }
+#endif
+
+    convertAds1115Reference(raw + i, voltage + i, count - i);
+}
+
+void RawConversion::convertTsl2561(const Tsl2561Frame *frames, double *visible, int count)
+{
+    int i = 0;
+
+#if defined(RAWCONVERSION_SSE2)
+    const __m128i mask = _mm_set1_epi32(0xFFFF);
+    for (; i + 4 <= count; i += 4) {
+        __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(frames + i));
+        __m128i difference = _mm_sub_epi32(_mm_and_si128(lanes, mask), _mm_srli_epi32(lanes, 16));
+        _mm_storeu_pd(visible + i, _mm_cvtepi32_pd(difference));
+        _mm_storeu_pd(visible + i + 2, _mm_cvtepi32_pd(_mm_shuffle_epi32(difference, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+#elif defined(RAWCONVERSION_NEON)
+    for (; i + 4 <= count; i += 4) {
+        uint16x4x2_t channels = vld2_u16(reinterpret_cast<const uint16_t *>(frames + i));
+        int32x4_t difference = vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(channels.val[0])), vreinterpretq_s32_u32(vmovl_u16(channels.val[1])));
+        vst1q_f64(visible + i, vcvtq_f64_s64(vmovl_s32(vget_low_s32(difference))));
+        vst1q_f64(visible + i + 2, vcvtq_f64_s64(vmovl_s32(vget_high_s32(difference))));
+    }
+#endif
+
+    convertTsl2561Reference(frames + i, visible + i, count - i);
+}
+
+void RawConversion::convertSht30Reference(const Sht30Frame *frames, double *temperature, double *humidity, int count)
+{
+    for (int i = 0; i < count; i++) {
+        temperature[i] = sht30Temperature(frames[i].temperature);
+        humidity[i] = sht30Humidity(frames[i].humidity);
+    }
+}
+
+void RawConversion::convertAds1115Reference(const qint16 *raw, double *voltage, int count)
+{
+    for (int i = 0; i < count; i++) {
+        voltage[i] = ads1115Voltage(raw[i]);
+    }
+}
+
+void RawConversion::convertTsl2561Reference(const Tsl2561Frame *frames, double *visible, int count)
+{
+    for (int i = 0; i < count; i++) {
+        visible[i] = tsl2561Visible(frames[i].channel0, frames[i].channel1);
+    }
+}
+
+QString RawConversion::kernelName()
+{
+#if defined(RAWCONVERSION_SSE2)
+    return "SSE2";
+#elif defined(RAWCONVERSION_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,73 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef RAWCONVERSION_H
+#define RAWCONVERSION_H
+
+#include <QString>
+
+// Conversion of the raw chip readings into engineering units.
+//
+// The single value functions are used by the sensor threads, the batch
+// kernels convert whole arrays of raw frames (capture, replay, benchmarks).
+// The SSE2 (x86-64) and NEON (AArch64) kernels evaluate the same double
+// precision operations in the same order as the scalar reference, so the
+// results are bit identical. NEON on 32 bit ARM has no double precision,
+// the scalar reference gets used there.
+
+// Raw codes of one reading, in host byte order
+struct Sht30Frame {
+    quint16 temperature;
+    quint16 humidity;
+};
+
+struct Tsl2561Frame {
+    quint16 channel0; // Full spectrum
+    quint16 channel1; // Infrared
+};
+
+class RawConversion
+{
+public:
+    // Single readings
+    static inline double sht30Temperature(quint16 raw) { return -45 + (175 * raw / 65535.0); }
+    static inline double sht30Humidity(quint16 raw) { return 100 * raw / 65535.0; }
+    static inline double ads1115Voltage(int raw) { return static_cast<double>(raw) * 4.096 / 32767.0; }
+
+    // Negative if the infrared part exceeds the full spectrum, i.e. an invalid reading
+    static inline int tsl2561Visible(quint16 channel0, quint16 channel1) { return static_cast<int>(channel0) - static_cast<int>(channel1); }
+
+    // Batch kernels, vectorized if supported by the target
+    static void convertSht30(const Sht30Frame *frames, double *temperature, double *humidity, int count);
+    static void convertAds1115(const qint16 *raw, double *voltage, int count);
+    static void convertTsl2561(const Tsl2561Frame *frames, double *visible, int count);
+
+    // Scalar reference of the batch kernels
+    static void convertSht30Reference(const Sht30Frame *frames, double *temperature, double *humidity, int count);
+    static void convertAds1115Reference(const qint16 *raw, double *voltage, int count);
+    static void convertTsl2561Reference(const Tsl2561Frame *frames, double *visible, int count);
+
+    // SSE2, NEON or scalar
+    static QString kernelName();
+};
+
+#endif // RAWCONVERSION_H
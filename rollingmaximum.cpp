@@ -0,0 +1,158 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "rollingmaximum.h"
+
+#include <QVariantList>
+
+RollingMaximum::RollingMaximum(qint64 window, int bucketCount) :
+    m_window(window),
+    m_bucketCount(qMax(1, bucketCount))
+{
+    m_bucketDuration = qMax<qint64>(1, m_window / m_bucketCount);
+}
+
+qint64 RollingMaximum::window() const
+{
+    return m_window;
+}
+
+void RollingMaximum::setWindow(qint64 window)
+{
+    if (m_window == window)
+        return;
+
+    // Note: the bucket duration changes, the collected buckets do not fit any more
+    m_window = window;
+    m_bucketDuration = qMax<qint64>(1, m_window / m_bucketCount);
+    clear();
+}
+
+void RollingMaximum::addValue(qint64 timestamp, double value)
+{
+    qint64 bucketStart = timestamp - (timestamp % m_bucketDuration);
+    if (m_currentStart >= 0 && bucketStart != m_currentStart)
+        closeBucket();
+
+    if (m_currentStart < 0) {
+        m_currentStart = bucketStart;
+        m_currentMaximum = value;
+    } else if (value > m_currentMaximum) {
+        m_currentMaximum = value;
+    }
+
+    if (m_firstTimestamp < 0)
+        m_firstTimestamp = timestamp;
+
+    m_lastTimestamp = timestamp;
+    expire(timestamp);
+}
+
+bool RollingMaximum::isEmpty() const
+{
+    return m_currentStart < 0 && m_buckets.isEmpty();
+}
+
+double RollingMaximum::maximum() const
+{
+    if (m_buckets.isEmpty())
+        return m_currentMaximum;
+
+    if (m_currentStart < 0)
+        return m_buckets.head().second;
+
+    return qMax(m_buckets.head().second, m_currentMaximum);
+}
+
+qint64 RollingMaximum::coverage() const
+{
+    if (isEmpty())
+        return 0;
+
+    return qMin(m_window, m_lastTimestamp - m_firstTimestamp);
+}
+
+void RollingMaximum::clear()
+{
+    m_buckets.clear();
+    m_currentStart = -1;
+    m_currentMaximum = 0;
+    m_firstTimestamp = -1;
+    m_lastTimestamp = -1;
+}
+
+QVariantMap RollingMaximum::saveState() const
+{
+    QVariantList buckets;
+    for (int i = 0; i < m_buckets.count(); i++) {
+        buckets.append(QVariantList() << m_buckets.at(i).first << m_buckets.at(i).second);
+    }
+
+    QVariantMap state;
+    state.insert("window", m_window);
+    state.insert("buckets", buckets);
+    state.insert("currentStart", m_currentStart);
+    state.insert("currentMaximum", m_currentMaximum);
+    state.insert("firstTimestamp", m_firstTimestamp);
+    state.insert("lastTimestamp", m_lastTimestamp);
+    return state;
+}
+
+void RollingMaximum::restoreState(const QVariantMap &state)
+{
+    clear();
+    if (state.value("window").toLongLong() != m_window)
+        return;
+
+    foreach (const QVariant &bucket, state.value("buckets").toList()) {
+        QVariantList values = bucket.toList();
+        if (values.count() == 2) {
+            m_buckets.enqueue(qMakePair(values.at(0).toLongLong(), values.at(1).toDouble()));
+        }
+    }
+
+    m_currentStart = state.value("currentStart", -1).toLongLong();
+    m_currentMaximum = state.value("currentMaximum").toDouble();
+    m_firstTimestamp = state.value("firstTimestamp", -1).toLongLong();
+    m_lastTimestamp = state.value("lastTimestamp", -1).toLongLong();
+}
+
+void RollingMaximum::closeBucket()
+{
+    // Buckets with a smaller maximum can never become the window maximum again
+    while (!m_buckets.isEmpty() && m_buckets.last().second <= m_currentMaximum) {
+        m_buckets.removeLast();
+    }
+
+    m_buckets.enqueue(qMakePair(m_currentStart, m_currentMaximum));
+    m_currentStart = -1;
+}
+
+void RollingMaximum::expire(qint64 timestamp)
+{
+    while (!m_buckets.isEmpty() && m_buckets.head().first + m_bucketDuration <= timestamp - m_window) {
+        m_buckets.dequeue();
+    }
+
+    if (m_firstTimestamp < timestamp - m_window)
+        m_firstTimestamp = timestamp - m_window;
+}
@@ -0,0 +1,76 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef ROLLINGMAXIMUM_H
+#define ROLLINGMAXIMUM_H
+
+#include <QPair>
+#include <QQueue>
+#include <QVariantMap>
+
+// Maximum of all values within a sliding time window.
+//
+// The window gets split into a fixed number of buckets. A new value only
+// updates the maximum of the current bucket, closed buckets go into a
+// monotonic deque (decreasing maxima), so the window maximum is always at
+// the front. Memory is bounded by the bucket count, independent of the
+// sample rate, and every operation is amortized O(1).
+
+class RollingMaximum
+{
+public:
+    explicit RollingMaximum(qint64 window = 7 * 24 * 3600 * 1000LL, int bucketCount = 168);
+
+    qint64 window() const;
+    void setWindow(qint64 window);
+
+    void addValue(qint64 timestamp, double value);
+
+    bool isEmpty() const;
+    double maximum() const;
+
+    // Time span covered by the values within the window
+    qint64 coverage() const;
+
+    void clear();
+
+    QVariantMap saveState() const;
+    void restoreState(const QVariantMap &state);
+
+private:
+    qint64 m_window;
+    int m_bucketCount;
+    qint64 m_bucketDuration;
+
+    // Closed buckets: start timestamp and maximum
+    QQueue<QPair<qint64, double> > m_buckets;
+
+    qint64 m_currentStart = -1;
+    double m_currentMaximum = 0;
+    qint64 m_firstTimestamp = -1;
+    qint64 m_lastTimestamp = -1;
+
+    void closeBucket();
+    void expire(qint64 timestamp);
+};
+
+#endif // ROLLINGMAXIMUM_H
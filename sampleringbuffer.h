@@ -0,0 +1,121 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SAMPLERINGBUFFER_H
+#define SAMPLERINGBUFFER_H
+
+#include <atomic>
+#include <QtGlobal>
+
+// Bounded single producer / single consumer ring buffer.
+//
+// The sensor thread pushes every sample it reads, the main thread drains all
+// samples collected since the last publish in one batch. No locks are involved
+// and the memory is allocated once. If the consumer falls behind, new samples
+// are dropped and counted instead of overwriting data the consumer might read.
+
+template <typename T, quint32 Capacity>
+class SampleRingBuffer
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "The ring buffer capacity must be a power of 2");
+
+public:
+    SampleRingBuffer() = default;
+    SampleRingBuffer(const SampleRingBuffer &) = delete;
+    SampleRingBuffer &operator=(const SampleRingBuffer &) = delete;
+
+    // Producer side
+    bool push(const T &sample)
+    {
+        quint32 head = m_head.load(std::memory_order_relaxed);
+        quint32 tail = m_tail.load(std::memory_order_acquire);
+        if (head - tail >= Capacity) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_buffer[head & (Capacity - 1)] = sample;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, calls function(const T &) for each available sample in order
+    template <typename Function>
+    int consume(Function function, int maxCount = Capacity)
+    {
+        quint32 tail = m_tail.load(std::memory_order_relaxed);
+        quint32 head = m_head.load(std::memory_order_acquire);
+
+        int count = 0;
+        while (tail != head && count < maxCount) {
+            function(m_buffer[tail & (Capacity - 1)]);
+            tail++;
+            count++;
+        }
+
+        m_tail.store(tail, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side
+    bool pop(T *sample)
+    {
+        return consume([sample](const T &value) { *sample = value; }, 1) == 1;
+    }
+
+    void clear()
+    {
+        m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    int size() const
+    {
+        return static_cast<int>(m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire));
+    }
+
+    bool isEmpty() const
+    {
+        return size() == 0;
+    }
+
+    static constexpr int capacity()
+    {
+        return Capacity;
+    }
+
+    quint64 droppedCount() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Note: keep producer and consumer indices on separate cache lines. Padding instead
+    // of alignas, the drivers are heap allocated and over aligned new requires C++17.
+    std::atomic<quint32> m_head { 0 };
+    char m_headPadding[64 - sizeof(std::atomic<quint32>)];
+    std::atomic<quint32> m_tail { 0 };
+    char m_tailPadding[64 - sizeof(std::atomic<quint32>)];
+    std::atomic<quint64> m_dropped { 0 };
+    T m_buffer[Capacity];
+};
+
+#endif // SAMPLERINGBUFFER_H
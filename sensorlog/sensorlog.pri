@@ -0,0 +1,11 @@
+INCLUDEPATH += $$PWD
+
+HEADERS += \
+    $$PWD/sensorlogformat.h \
+    $$PWD/sensorlogcolumns.h \
+    $$PWD/sensorlogwriter.h \
+    $$PWD/sensorlogreader.h
+
+SOURCES += \
+    $$PWD/sensorlogwriter.cpp \
+    $$PWD/sensorlogreader.cpp
@@ -0,0 +1,48 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SENSORLOGCOLUMNS_H
+#define SENSORLOGCOLUMNS_H
+
+#include <QStringList>
+
+// Columns of the sensor log written by AirQualityMonitor (sensordata-<deviceId>.slog).
+//
+// Every channel has a raw and a filtered column: column 2n is the raw and
+// column 2n + 1 the filtered value of channel n. The text log of the gnuplot
+// scripts has the same columns after the timestamp.
+
+static inline QStringList sensorLogChannels()
+{
+    return QStringList() << "temperature" << "humidity" << "pressure" << "lux" << "ppm";
+}
+
+static inline QStringList sensorLogColumns()
+{
+    QStringList columns;
+    foreach (const QString &channel, sensorLogChannels()) {
+        columns << channel << channel + "Filtered";
+    }
+    return columns;
+}
+
+#endif // SENSORLOGCOLUMNS_H
@@ -0,0 +1,70 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SENSORLOGFORMAT_H
+#define SENSORLOGFORMAT_H
+
+#include <QtGlobal>
+
+// Binary columnar sensor log.
+//
+//   SensorLogHeader
+//   SensorLogColumn x columnCount
+//   padding up to headerSize (multiple of 8)
+//   record x n: qint64 timestamp [ms since epoch], float x columnCount, padding up to recordSize
+//
+// All values are stored in host byte order, the byte order mark tells the reader.
+// Records are appended only, a partially written last record gets ignored.
+
+#define SENSORLOG_MAGIC "NYSSLOG"
+#define SENSORLOG_VERSION 1
+#define SENSORLOG_BYTE_ORDER_MARK 0x01020304
+
+struct SensorLogHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrderMark;
+    quint32 headerSize;
+    quint32 recordSize;
+    quint32 columnCount;
+    quint32 reserved;
+    qint64 created;
+};
+
+struct SensorLogColumn {
+    char name[32];
+};
+
+static inline quint32 sensorLogHeaderSize(int columnCount)
+{
+    quint32 size = sizeof(SensorLogHeader) + static_cast<quint32>(columnCount) * sizeof(SensorLogColumn);
+    return (size + 7) & ~7u;
+}
+
+static inline quint32 sensorLogRecordSize(int columnCount)
+{
+    // Keep every record 8 byte aligned, the reader hands out pointers into the mapped file
+    quint32 size = sizeof(qint64) + static_cast<quint32>(columnCount) * sizeof(float);
+    return (size + 7) & ~7u;
+}
+
+#endif // SENSORLOGFORMAT_H
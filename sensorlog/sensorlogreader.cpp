@@ -0,0 +1,174 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "sensorlogreader.h"
+
+#include <cstring>
+
+SensorLogReader::SensorLogReader(const QString &fileName) :
+    m_file(fileName)
+{
+
+}
+
+SensorLogReader::~SensorLogReader()
+{
+    close();
+}
+
+bool SensorLogReader::open()
+{
+    if (isOpen())
+        return true;
+
+    if (!m_file.open(QFile::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    qint64 size = m_file.size();
+    if (size < static_cast<qint64>(sizeof(SensorLogHeader))) {
+        m_errorString = "The file is too small for a sensor log";
+        m_file.close();
+        return false;
+    }
+
+    m_data = m_file.map(0, size);
+    if (!m_data) {
+        m_errorString = m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    SensorLogHeader header;
+    memcpy(&header, m_data, sizeof(header));
+    if (memcmp(header.magic, SENSORLOG_MAGIC, sizeof(SENSORLOG_MAGIC)) != 0) {
+        m_errorString = "Not a sensor log";
+        close();
+        return false;
+    }
+
+    if (header.byteOrderMark != SENSORLOG_BYTE_ORDER_MARK || header.version != SENSORLOG_VERSION) {
+        m_errorString = QString("Unsupported sensor log version %1 or byte order").arg(header.version);
+        close();
+        return false;
+    }
+
+    if (header.headerSize < sensorLogHeaderSize(static_cast<int>(header.columnCount)) || header.headerSize > size
+            || header.recordSize < sensorLogRecordSize(static_cast<int>(header.columnCount))) {
+        m_errorString = "Invalid sensor log header";
+        close();
+        return false;
+    }
+
+    m_headerSize = header.headerSize;
+    m_recordSize = header.recordSize;
+    m_created = header.created;
+    m_recordCount = (size - m_headerSize) / m_recordSize;
+
+    const SensorLogColumn *columns = reinterpret_cast<const SensorLogColumn *>(m_data + sizeof(SensorLogHeader));
+    for (quint32 i = 0; i < header.columnCount; i++) {
+        m_columns.append(QString::fromUtf8(columns[i].name, static_cast<int>(strnlen(columns[i].name, sizeof(columns[i].name)))));
+    }
+
+    return true;
+}
+
+void SensorLogReader::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_data = nullptr;
+    }
+
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+
+    m_recordCount = 0;
+    m_columns.clear();
+}
+
+bool SensorLogReader::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+QString SensorLogReader::fileName() const
+{
+    return m_file.fileName();
+}
+
+QString SensorLogReader::errorString() const
+{
+    return m_errorString;
+}
+
+qint64 SensorLogReader::created() const
+{
+    return m_created;
+}
+
+int SensorLogReader::columnCount() const
+{
+    return m_columns.count();
+}
+
+QStringList SensorLogReader::columns() const
+{
+    return m_columns;
+}
+
+int SensorLogReader::columnIndex(const QString &name) const
+{
+    return m_columns.indexOf(name);
+}
+
+qint64 SensorLogReader::recordCount() const
+{
+    return m_recordCount;
+}
+
+qint64 SensorLogReader::timestamp(qint64 record) const
+{
+    return *reinterpret_cast<const qint64 *>(this->record(record));
+}
+
+float SensorLogReader::value(qint64 record, int column) const
+{
+    return values(record)[column];
+}
+
+const float *SensorLogReader::values(qint64 record) const
+{
+    return reinterpret_cast<const float *>(this->record(record) + sizeof(qint64));
+}
+
+bool SensorLogReader::isSensorLog(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    QByteArray magic = file.read(sizeof(SENSORLOG_MAGIC));
+    return magic.size() == static_cast<int>(sizeof(SENSORLOG_MAGIC)) && memcmp(magic.constData(), SENSORLOG_MAGIC, sizeof(SENSORLOG_MAGIC)) == 0;
+}
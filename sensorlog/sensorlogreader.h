@@ -0,0 +1,80 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SENSORLOGREADER_H
+#define SENSORLOGREADER_H
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+#include "sensorlogformat.h"
+
+// Read only view on a binary sensor log.
+//
+// The file gets memory mapped, timestamps and values are read directly from
+// the mapping without copying or parsing. Records appended after open() are
+// not visible until the log gets opened again.
+
+class SensorLogReader
+{
+public:
+    explicit SensorLogReader(const QString &fileName);
+    ~SensorLogReader();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    QString fileName() const;
+    QString errorString() const;
+
+    qint64 created() const;
+    int columnCount() const;
+    QStringList columns() const;
+    int columnIndex(const QString &name) const;
+
+    qint64 recordCount() const;
+    qint64 timestamp(qint64 record) const;
+    float value(qint64 record, int column) const;
+
+    // Pointer into the mapping, valid until close()
+    const float *values(qint64 record) const;
+
+    static bool isSensorLog(const QString &fileName);
+
+private:
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_recordCount = 0;
+    quint32 m_headerSize = 0;
+    quint32 m_recordSize = 0;
+    qint64 m_created = 0;
+    QStringList m_columns;
+    QString m_errorString;
+
+    inline const uchar *record(qint64 record) const {
+        return m_data + m_headerSize + record * m_recordSize;
+    }
+};
+
+#endif // SENSORLOGREADER_H
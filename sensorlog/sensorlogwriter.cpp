@@ -0,0 +1,287 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "sensorlogwriter.h"
+
+#include <errno.h>
+#include <cstring>
+#include <unistd.h>
+
+#include <QDateTime>
+
+SensorLogWriter::SensorLogWriter(const QString &fileName, const QStringList &columns) :
+    m_file(fileName),
+    m_columns(columns)
+{
+    m_headerSize = sensorLogHeaderSize(m_columns.count());
+    m_recordSize = sensorLogRecordSize(m_columns.count());
+    setBufferSize(64 * 1024);
+}
+
+SensorLogWriter::~SensorLogWriter()
+{
+    close();
+}
+
+QString SensorLogWriter::fileName() const
+{
+    return m_file.fileName();
+}
+
+QStringList SensorLogWriter::columns() const
+{
+    return m_columns;
+}
+
+qint64 SensorLogWriter::maximumSize() const
+{
+    return m_maximumSize;
+}
+
+void SensorLogWriter::setMaximumSize(qint64 maximumSize)
+{
+    m_maximumSize = maximumSize;
+}
+
+int SensorLogWriter::maximumFiles() const
+{
+    return m_maximumFiles;
+}
+
+void SensorLogWriter::setMaximumFiles(int maximumFiles)
+{
+    m_maximumFiles = qMax(1, maximumFiles);
+}
+
+int SensorLogWriter::bufferSize() const
+{
+    return m_bufferSize;
+}
+
+void SensorLogWriter::setBufferSize(int bufferSize)
+{
+    if (m_file.isOpen())
+        flush();
+
+    int recordSize = static_cast<int>(m_recordSize);
+    m_bufferSize = qMax(1, bufferSize / recordSize) * recordSize;
+    m_buffer.fill(0, m_bufferSize);
+}
+
+bool SensorLogWriter::open()
+{
+    if (m_file.isOpen())
+        return true;
+
+    // Continue an existing log with the same columns, otherwise move it out of the way
+    if (m_file.exists() && !headerMatches()) {
+        if (!rotate())
+            return false;
+    }
+
+    return openFile();
+}
+
+void SensorLogWriter::close()
+{
+    if (m_file.isOpen()) {
+        flush();
+        m_file.close();
+    }
+}
+
+bool SensorLogWriter::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+bool SensorLogWriter::flush()
+{
+    if (!m_file.isOpen())
+        return false;
+
+    if (m_bufferUsed == 0)
+        return true;
+
+    qint64 written = m_file.write(m_buffer.constData(), m_bufferUsed);
+    if (written != m_bufferUsed) {
+        // Drop the whole batch, a partially written record would shift all following records
+        m_errorString = m_file.errorString();
+        m_size -= m_bufferUsed;
+        m_bufferUsed = 0;
+        m_file.resize(m_size);
+        m_file.seek(m_size);
+        return false;
+    }
+
+    m_bufferUsed = 0;
+    return true;
+}
+
+bool SensorLogWriter::sync()
+{
+    if (!flush())
+        return false;
+
+    if (fdatasync(m_file.handle()) < 0) {
+        m_errorString = QString("Could not sync %1: %2").arg(m_file.fileName()).arg(strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+QString SensorLogWriter::errorString() const
+{
+    return m_errorString;
+}
+
+bool SensorLogWriter::append(qint64 timestamp, const float *values)
+{
+    if (!m_file.isOpen())
+        return false;
+
+    if (m_maximumSize > 0 && m_size + m_recordSize > m_maximumSize && m_size > m_headerSize) {
+        close();
+        if (!rotate() || !openFile())
+            return false;
+    }
+
+    char *record = m_buffer.data() + m_bufferUsed;
+    memcpy(record, &timestamp, sizeof(qint64));
+    memcpy(record + sizeof(qint64), values, static_cast<size_t>(m_columns.count()) * sizeof(float));
+    m_bufferUsed += static_cast<int>(m_recordSize);
+    m_size += m_recordSize;
+
+    if (m_bufferUsed >= m_bufferSize)
+        return flush();
+
+    return true;
+}
+
+bool SensorLogWriter::openFile()
+{
+    // Note: the batch buffer replaces the buffering of QFile
+    if (!m_file.open(QFile::ReadWrite | QFile::Unbuffered)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    if (m_size < m_headerSize) {
+        if (!m_file.resize(0) || !writeHeader()) {
+            m_errorString = m_file.errorString();
+            m_file.close();
+            return false;
+        }
+        m_size = m_headerSize;
+    } else {
+        // Drop a partially written record from an interrupted write
+        qint64 records = (m_size - m_headerSize) / m_recordSize;
+        m_size = m_headerSize + records * m_recordSize;
+        if (m_size != m_file.size() && !m_file.resize(m_size)) {
+            m_errorString = m_file.errorString();
+            m_file.close();
+            return false;
+        }
+    }
+
+    m_file.seek(m_size);
+    return true;
+}
+
+bool SensorLogWriter::writeHeader()
+{
+    QByteArray header(static_cast<int>(m_headerSize), 0);
+
+    SensorLogHeader fileHeader;
+    memset(&fileHeader, 0, sizeof(fileHeader));
+    memcpy(fileHeader.magic, SENSORLOG_MAGIC, sizeof(SENSORLOG_MAGIC));
+    fileHeader.version = SENSORLOG_VERSION;
+    fileHeader.byteOrderMark = SENSORLOG_BYTE_ORDER_MARK;
+    fileHeader.headerSize = m_headerSize;
+    fileHeader.recordSize = m_recordSize;
+    fileHeader.columnCount = static_cast<quint32>(m_columns.count());
+    fileHeader.created = QDateTime::currentMSecsSinceEpoch();
+    memcpy(header.data(), &fileHeader, sizeof(fileHeader));
+
+    for (int i = 0; i < m_columns.count(); i++) {
+        SensorLogColumn column;
+        memset(&column, 0, sizeof(column));
+        QByteArray name = m_columns.at(i).toUtf8().left(sizeof(column.name) - 1);
+        memcpy(column.name, name.constData(), static_cast<size_t>(name.size()));
+        memcpy(header.data() + sizeof(SensorLogHeader) + i * sizeof(SensorLogColumn), &column, sizeof(column));
+    }
+
+    return m_file.write(header) == header.size();
+}
+
+bool SensorLogWriter::headerMatches()
+{
+    QFile file(m_file.fileName());
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    QByteArray header = file.read(m_headerSize);
+    if (header.size() != static_cast<int>(m_headerSize))
+        return false;
+
+    SensorLogHeader fileHeader;
+    memcpy(&fileHeader, header.constData(), sizeof(fileHeader));
+    if (memcmp(fileHeader.magic, SENSORLOG_MAGIC, sizeof(SENSORLOG_MAGIC)) != 0
+            || fileHeader.version != SENSORLOG_VERSION
+            || fileHeader.byteOrderMark != SENSORLOG_BYTE_ORDER_MARK
+            || fileHeader.headerSize != m_headerSize
+            || fileHeader.recordSize != m_recordSize
+            || fileHeader.columnCount != static_cast<quint32>(m_columns.count()))
+        return false;
+
+    for (int i = 0; i < m_columns.count(); i++) {
+        const SensorLogColumn *column = reinterpret_cast<const SensorLogColumn *>(header.constData() + sizeof(SensorLogHeader) + i * sizeof(SensorLogColumn));
+        if (QString::fromUtf8(column->name) != m_columns.at(i))
+            return false;
+    }
+
+    return true;
+}
+
+bool SensorLogWriter::rotate()
+{
+    // name.<n-2> -> name.<n-1>, ..., name -> name.1
+    QString fileName = m_file.fileName();
+    QFile::remove(QString("%1.%2").arg(fileName).arg(m_maximumFiles - 1));
+    for (int i = m_maximumFiles - 2; i >= 1; i--) {
+        QFile::rename(QString("%1.%2").arg(fileName).arg(i), QString("%1.%2").arg(fileName).arg(i + 1));
+    }
+
+    if (m_maximumFiles > 1) {
+        if (!QFile::rename(fileName, fileName + ".1")) {
+            m_errorString = QString("Could not rotate %1").arg(fileName);
+            return false;
+        }
+    } else if (!QFile::remove(fileName)) {
+        m_errorString = QString("Could not remove %1").arg(fileName);
+        return false;
+    }
+
+    return true;
+}
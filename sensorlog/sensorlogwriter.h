@@ -0,0 +1,93 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SENSORLOGWRITER_H
+#define SENSORLOGWRITER_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QStringList>
+
+#include "sensorlogformat.h"
+
+// Appends fixed size records to a binary sensor log.
+//
+// Appending a record is a copy into the preallocated batch buffer, the file
+// only gets written once the buffer is full or on flush(). If the file would
+// grow beyond the maximum size it gets rotated: name.1 ... name.<maximumFiles - 1>
+// keep the older records.
+
+class SensorLogWriter
+{
+public:
+    SensorLogWriter(const QString &fileName, const QStringList &columns);
+    ~SensorLogWriter();
+
+    QString fileName() const;
+    QStringList columns() const;
+
+    qint64 maximumSize() const;
+    void setMaximumSize(qint64 maximumSize);
+
+    int maximumFiles() const;
+    void setMaximumFiles(int maximumFiles);
+
+    // Bytes collected before writing, rounded down to whole records
+    int bufferSize() const;
+    void setBufferSize(int bufferSize);
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    // Write the collected records, sync() additionally waits until the data is on the disk
+    bool flush();
+    bool sync();
+
+    QString errorString() const;
+
+    // The values array must contain one value per column
+    bool append(qint64 timestamp, const float *values);
+
+private:
+    QFile m_file;
+    QStringList m_columns;
+    QByteArray m_buffer;
+    int m_bufferSize = 0;
+    int m_bufferUsed = 0;
+    quint32 m_headerSize = 0;
+    quint32 m_recordSize = 0;
+    qint64 m_size = 0;
+
+    qint64 m_maximumSize = 16 * 1024 * 1024;
+    int m_maximumFiles = 4;
+
+    QString m_errorString;
+
+    bool openFile();
+    bool writeHeader();
+    bool headerMatches();
+    bool rotate();
+};
+
+#endif // SENSORLOGWRITER_H
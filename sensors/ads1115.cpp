@@ -22,23 +22,44 @@
 
 #include "ads1115.h"
 #include "i2cport.h"
+#include "rawconversion.h"
+#include "decimatingfilter.h"
 #include "extern-plugininfo.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/syscall.h>
 #include <linux/i2c-dev.h>
 
 #include <QFile>
+#include <QDateTime>
+
+static const int s_dataRate = 860;
+static const int s_sampleRate = 10;
+
+static qint64 monotonicTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<qint64>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+static void sleepUntil(qint64 monotonicNanoSeconds)
+{
+    struct timespec time;
+    time.tv_sec = monotonicNanoSeconds / 1000000000;
+    time.tv_nsec = monotonicNanoSeconds % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) == EINTR) { }
+}
 
 ADS1115::ADS1115(const QString &i2cPortName, int i2cAddress, QObject *parent) :
-    QThread(parent),
-    m_i2cPortName(i2cPortName),
-    m_i2cAddress(i2cAddress)
+    SensorThread("ADS1115", i2cPortName, i2cAddress, parent)
 {
 
 }
@@ -49,30 +70,47 @@ ADS1115::~ADS1115()
     wait();
 }
 
-double ADS1115::getChannelVoltage(ADS1115::Channel channel)
+double ADS1115::convertToVoltage(int value)
 {
-    return static_cast<double>(getChannelValue(channel)) * 4.096 / 32767.0;
+    return RawConversion::ads1115Voltage(value);
 }
 
-int ADS1115::getChannelValue(ADS1115::Channel channel)
+bool ADS1115::streamingEnabled() const
 {
-    QMutexLocker locker(&m_valueMutex);
-    int value = 0;
-    switch (channel) {
-    case Channel1:
-        value = m_channel1Value;
-        break;
-    case Channel2:
-        value =  m_channel2Value;
-        break;
-    case Channel3:
-        value =  m_channel3Value;
-        break;
-    case Channel4:
-        value =  m_channel4Value;
-        break;
-    }
-    return value;
+    return m_streamingChannel.load() >= 0;
+}
+
+ADS1115::Channel ADS1115::streamingChannel() const
+{
+    int channel = m_streamingChannel.load();
+    return channel >= 0 ? static_cast<Channel>(channel) : Channel1;
+}
+
+void ADS1115::setStreamingEnabled(bool enabled, ADS1115::Channel channel)
+{
+    // Note: the reading loop picks up the change with its next cycle
+    qCDebug(dcSensorStation()) << "ADS1115: streaming" << (enabled ? "enabled" : "disabled") << channel;
+    m_streamingChannel.store(enabled ? static_cast<int>(channel) : -1);
+}
+
+quint64 ADS1115::droppedConversions() const
+{
+    return m_droppedConversions.load(std::memory_order_relaxed);
+}
+
+int ADS1115::streamingDataRate()
+{
+    return s_dataRate;
+}
+
+int ADS1115::streamingSampleRate()
+{
+    return s_sampleRate;
+}
+
+QStringList ADS1115::captureColumns() const
+{
+    return QStringList() << "channel1" << "channel2" << "channel3" << "channel4";
 }
 
 void ADS1115::run()
@@ -92,34 +130,215 @@ void ADS1115::run()
 
     int fileDescriptor = i2cFile.handle();
 
-    // Continuouse reading of the ADC values
+    // Continuouse reading of the ADC values, until the thread gets stopped
     qCDebug(dcSensorStation()) << "ADS1115: start reading values..." << this << "Process PID:" << syscall(SYS_gettid);
-    while (true) {
-        if (ioctl(fileDescriptor, I2C_SLAVE, m_i2cAddress) < 0) {
-            qCWarning(dcSensorStation()) << "ADS1115: Could not set I2C into slave mode" << m_i2cPortName << QString("0x%1").arg(m_i2cAddress, 0, 16);
-            msleep(500);
+    bool running = true;
+    while (running) {
+        if (streamingEnabled()) {
+            running = runStreaming(fileDescriptor);
+        } else {
+            running = runSingleShot(fileDescriptor);
+        }
+    }
+
+    i2cFile.close();
+    qCDebug(dcSensorStation()) << "ADS1115: Reading thread finished.";
+}
+
+bool ADS1115::runSingleShot(int fd)
+{
+    while (!streamingEnabled()) {
+        // Note: convert all channels first and publish them as one consistent sample
+        Sample sample;
+        // Note: a failed conversion drops the whole sample, a 0 would end up in the CO2 average
+        bool converted = readInputValue(fd, Channel1, &sample.channelValues[Channel1])
+                && readInputValue(fd, Channel2, &sample.channelValues[Channel2])
+                && readInputValue(fd, Channel3, &sample.channelValues[Channel3])
+                && readInputValue(fd, Channel4, &sample.channelValues[Channel4]);
+
+        if (!converted) {
+            countError();
+            if (!interruptibleSleep(500))
+                return false;
+
             continue;
         }
 
-        QMutexLocker valueLocker(&m_valueMutex);
-        m_channel1Value = readInputValue(fileDescriptor, Channel1);
-        m_channel2Value = readInputValue(fileDescriptor, Channel2);
-        m_channel3Value = readInputValue(fileDescriptor, Channel3);
-        m_channel4Value = readInputValue(fileDescriptor, Channel4);
+        sample.timestamp = QDateTime::currentMSecsSinceEpoch();
+        m_samples.push(sample);
+        countSample();
+        captureSample(sample.timestamp, sample.channelValues[Channel1], sample.channelValues[Channel2], sample.channelValues[Channel3], sample.channelValues[Channel4]);
 
-        //qCDebug(dcSensorStation()) << "AI0:" << m_channel1Value << "| AI1" << m_channel2Value << "| AI2" << m_channel3Value << "| AI3" << m_channel4Value;
+        //qCDebug(dcSensorStation()) << "AI0:" << sample.channelValues[Channel1] << "| AI1" << sample.channelValues[Channel2] << "| AI2" << sample.channelValues[Channel3] << "| AI3" << sample.channelValues[Channel4];
 
-        QMutexLocker stopLocker(&m_stopMutex);
-        if (m_stop) break;
-        msleep(500);
+        if (!waitForNextCycle(500))
+            return false;
     }
 
-    i2cFile.close();
-    qCDebug(dcSensorStation()) << "ADS1115: Reading thread finished.";
+    return true;
+}
+
+bool ADS1115::runStreaming(int fd)
+{
+    Channel channel = streamingChannel();
+    qCDebug(dcSensorStation()) << "ADS1115: start streaming" << channel << "with" << s_dataRate << "samples/s, output" << s_sampleRate << "samples/s";
+
+    DecimatingFilter filter(s_dataRate / s_sampleRate);
+
+    // The output belongs to the center of the filter taps
+    qint64 delay = qRound64(filter.groupDelay() * 1000 / s_dataRate);
+
+    // Note: without the ALERT/RDY pin the loop gets paced by the clock. The ADC
+    // oscillator is only accurate to ±10 %, so a conversion sometimes gets read
+    // twice or skipped, the low pass filter smooths that out.
+    const qint64 period = 1000000000LL / s_dataRate;
+    qint64 next = 0;
+    int lastValue = 0;
+    bool hasLastValue = false;
+    int iteration = 0;
+    bool configured = false;
+    bool failed = false;
+    while (m_streamingChannel.load() == static_cast<int>(channel)) {
+        if (!configured) {
+            if (!startContinuousConversion(fd, channel)) {
+                qCWarning(dcSensorStation()) << "ADS1115: Could not start the continuous conversion" << m_i2cPortName << QString("0x%1").arg(m_i2cAddress, 0, 16);
+                countError();
+                failed = true;
+                if (!interruptibleSleep(500))
+                    return false;
+
+                continue;
+            }
+
+            if (failed)
+                countRecovery();
+
+            configured = true;
+            failed = false;
+            filter.reset();
+            next = monotonicTime();
+            hasLastValue = false;
+        }
+
+        next += period;
+        sleepUntil(next);
+
+        int value = 0;
+        if (!readConversion(fd, &value)) {
+            qCWarning(dcSensorStation()) << "ADS1115: could not read ADC data";
+            countError();
+            configured = false;
+            failed = true;
+            if (!interruptibleSleep(500))
+                return false;
+
+            continue;
+        }
+
+        qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+        float captureValues[4] = { 0, 0, 0, 0 };
+        captureValues[channel] = value;
+        captureSample(timestamp, captureValues[0], captureValues[1], captureValues[2], captureValues[3]);
+
+        // Conversions missed while waiting for the bus lock or the scheduler. The register
+        // only holds the last one, the filter gets the previous value for each missed
+        // conversion to keep its input rate constant. A gap longer than one output
+        // sample restarts the filter.
+        qint64 missed = (monotonicTime() - next) / period;
+        if (missed > 0) {
+            m_droppedConversions.fetch_add(static_cast<quint64>(missed), std::memory_order_relaxed);
+            next += missed * period;
+            if (missed > filter.decimation() || !hasLastValue) {
+                filter.reset();
+            } else {
+                for (qint64 i = 0; i < missed; i++) {
+                    publishStreamingSample(&filter, channel, lastValue, timestamp - delay);
+                }
+            }
+        }
+        lastValue = value;
+        hasLastValue = true;
+        publishStreamingSample(&filter, channel, value, timestamp - delay);
+
+        // Note: the stop mutex and the metrics only once per output period
+        if (++iteration % filter.decimation() == 0) {
+            countWakeUps(static_cast<quint64>(filter.decimation()));
+            if (isStopRequested()) {
+                stopContinuousConversion(fd, channel);
+                return false;
+            }
+        }
+    }
+
+    stopContinuousConversion(fd, channel);
+    return true;
 }
 
-int ADS1115::readInputValue(int fd, ADS1115::Channel channel)
+bool ADS1115::publishStreamingSample(DecimatingFilter *filter, ADS1115::Channel channel, int value, qint64 timestamp)
 {
+    double output = 0;
+    if (!filter->addValue(value, &output))
+        return false;
+
+    Sample sample;
+    sample.timestamp = timestamp;
+    sample.channelValues[channel] = qRound(output);
+    m_samples.push(sample);
+    countSample();
+    return true;
+}
+
+bool ADS1115::startContinuousConversion(int fd, ADS1115::Channel channel)
+{
+    I2CBusLocker busLocker(m_i2cPortName, fd, m_muxAddress, m_muxChannel, m_i2cAddress);
+    if (!busLocker.isValid())
+        return false;
+
+    // AINx and GND, gain 1 = 4.096 V, continuous conversion, 860 samples/s, comparator disabled
+    unsigned char writeBuf[3];
+    writeBuf[0] = 0x01; // Config register
+    writeBuf[1] = 0x42 | (channel << 4); // 0b01cc0010
+    writeBuf[2] = 0xE3; // 0b11100011
+    if (write(fd, writeBuf, 3) != 3)
+        return false;
+
+    // The address pointer stays on the conversion register, every following read returns the latest conversion
+    writeBuf[0] = 0x00;
+    return write(fd, writeBuf, 1) == 1;
+}
+
+void ADS1115::stopContinuousConversion(int fd, ADS1115::Channel channel)
+{
+    I2CBusLocker busLocker(m_i2cPortName, fd, m_muxAddress, m_muxChannel, m_i2cAddress);
+    if (!busLocker.isValid())
+        return;
+
+    // Back to single shot mode, the chip powers down after the current conversion
+    unsigned char writeBuf[3];
+    writeBuf[0] = 0x01; // Config register
+    writeBuf[1] = 0x43 | (channel << 4); // 0b01cc0011
+    writeBuf[2] = 0x85; // 0b10000101
+    if (write(fd, writeBuf, 3) != 3)
+        qCWarning(dcSensorStation()) << "ADS1115: could not stop the continuous conversion";
+}
+
+bool ADS1115::readConversion(int fd, int *value)
+{
+    unsigned char readBuf[2] = {0};
+    {
+        I2CBusLocker busLocker(m_i2cPortName, fd, m_muxAddress, m_muxChannel, m_i2cAddress);
+        if (!busLocker.isValid() || read(fd, readBuf, 2) != 2)
+            return false;
+    }
+
+    *value = static_cast<qint16>((readBuf[0] << 8) | readBuf[1]);
+    return true;
+}
+
+bool ADS1115::readInputValue(int fd, ADS1115::Channel channel, int *value)
+{
+    *value = 0;
+
     // AIN0 and GND, gain 1 = 4.096 V, 128 samples/s
     unsigned char writeBuf[3];
     writeBuf[0] = 0x01; // Config register
@@ -138,59 +357,62 @@ int ADS1115::readInputValue(int fd, ADS1115::Channel channel)
         break;
     }
     writeBuf[2] = 0x85; // 0b10000101
-    write(fd, writeBuf, 3);
 
-    // Wait for conversion complete
-    unsigned char readBuf[2] = {0};
-    do {
-        if (read(fd, readBuf, 2) != 2) {
-            qCWarning(dcSensorStation()) << "ADS1115: could not read ADC data";
-            return 0;
+    {
+        I2CBusLocker busLocker(m_i2cPortName, fd, m_muxAddress, m_muxChannel, m_i2cAddress);
+        if (!busLocker.isValid()) {
+            qCWarning(dcSensorStation()) << "ADS1115: Could not set I2C into slave mode" << m_i2cPortName << QString("0x%1").arg(m_i2cAddress, 0, 16);
+            return false;
         }
-    } while (!(readBuf[0] & 0x80));
 
-    // Write conversion register
-    readBuf[0] = 0;
-    if (write(fd, readBuf, 1) != 1) {
-        qCWarning(dcSensorStation()) << "ADS1115: could not write select register";
-        return 0;
+        if (write(fd, writeBuf, 3) != 3) {
+            qCWarning(dcSensorStation()) << "ADS1115: could not start the conversion";
+            return false;
+        }
     }
 
-    // Read value data
-    if (read(fd, readBuf, 2) != 2) {
-        qCWarning(dcSensorStation()) << "ADS1115: could not read ADC data";
-        return 0;
-    }
+    // One conversion at 128 samples/s takes 7.8 ms (±10 %), the bus is free meanwhile
+    msleep(8);
 
-    int value = static_cast<qint16>(readBuf[0]) * 256 + static_cast<qint16>(readBuf[1]);
-    return value;
-}
+    // Wait for conversion complete, the address pointer still selects the config register
+    for (int attempt = 0; attempt < 10; attempt++) {
+        bool ready = false;
+        {
+            I2CBusLocker busLocker(m_i2cPortName, fd, m_muxAddress, m_muxChannel, m_i2cAddress);
+            if (!busLocker.isValid()) {
+                qCWarning(dcSensorStation()) << "ADS1115: Could not set I2C into slave mode" << m_i2cPortName << QString("0x%1").arg(m_i2cAddress, 0, 16);
+                return false;
+            }
 
-bool ADS1115::enable()
-{
-    // Check if this address can be opened
-    I2CPort port(m_i2cPortName);
-    if (!port.openPort(m_i2cAddress)) {
-        qCWarning(dcSensorStation()) << "ADS1115 is not available on port" << port.portDeviceName() << QString("0x%1").arg(m_i2cAddress, 0, 16);
-        return false;
-    }
-    port.closePort();
+            unsigned char readBuf[2] = {0};
+            if (read(fd, readBuf, 2) != 2) {
+                qCWarning(dcSensorStation()) << "ADS1115: could not read ADC data";
+                return false;
+            }
 
-    // Start the reading thread
-    QMutexLocker locker(&m_stopMutex);
-    m_stop = false;
-    start();
-    return true;
-}
+            ready = readBuf[0] & 0x80;
+            if (ready) {
+                // Write conversion register
+                readBuf[0] = 0;
+                if (write(fd, readBuf, 1) != 1) {
+                    qCWarning(dcSensorStation()) << "ADS1115: could not write select register";
+                    return false;
+                }
 
-void ADS1115::disable()
-{
-    // Stop the thread if not already disabled
-    QMutexLocker locker(&m_stopMutex);
-    if (m_stop)
-        return;
+                // Read value data
+                if (read(fd, readBuf, 2) != 2) {
+                    qCWarning(dcSensorStation()) << "ADS1115: could not read ADC data";
+                    return false;
+                }
 
-    qCDebug(dcSensorStation()) << "ADS1115: Disable measurements";
-    m_stop = true;
-}
+                *value = static_cast<qint16>(readBuf[0]) * 256 + static_cast<qint16>(readBuf[1]);
+                return true;
+            }
+        }
 
+        msleep(1);
+    }
+
+    qCWarning(dcSensorStation()) << "ADS1115: conversion did not complete";
+    return false;
+}
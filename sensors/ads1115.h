@@ -23,12 +23,16 @@
 #ifndef ADS1115_H
 #define ADS1115_H
 
-#include <QMutex>
+#include <atomic>
+
 #include <QObject>
-#include <QThread>
-#include <QMutexLocker>
 
-class ADS1115 : public QThread
+#include "sensorthread.h"
+#include "sampleringbuffer.h"
+
+class DecimatingFilter;
+
+class ADS1115 : public SensorThread
 {
     Q_OBJECT
 public:
@@ -40,34 +44,62 @@ public:
     };
     Q_ENUM(Channel)
 
+    struct Sample {
+        qint64 timestamp = 0;
+        int channelValues[4] = { 0, 0, 0, 0 };
+    };
+
     explicit ADS1115(const QString &i2cPortName, int i2cAddress = 0x48, QObject *parent = nullptr);
     ~ADS1115() override;
 
-    double getChannelVoltage(Channel channel);
-    int getChannelValue(Channel channel);
+    static double convertToVoltage(int value);
+
+    // Streaming: continuous conversion of one channel at 860 samples/s, only the
+    // conversion register gets read. A decimating FIR filter delivers
+    // streamingSampleRate() samples/s with only the streaming channel set.
+    // The duty cycle does not apply while streaming.
+    bool streamingEnabled() const;
+    Channel streamingChannel() const;
+    void setStreamingEnabled(bool enabled, Channel channel = Channel1);
+
+    // Conversions missed while streaming (bus lock or scheduler delays), replaced by the previous value
+    quint64 droppedConversions() const;
+
+    static int streamingDataRate();
+    static int streamingSampleRate();
+
+    // Raw samples collected since the last call, consumer side of the ring buffer
+    template <typename Function>
+    int consumeSamples(Function function) { return m_samples.consume(function); }
+    quint64 droppedSamples() const { return m_samples.droppedCount(); }
+
+    bool injectSample(const Sample &sample) { return m_samples.push(sample); }
+
+    QStringList captureColumns() const override;
 
 protected:
     void run() override;
 
 private:
-    QString m_i2cPortName;
-    int m_i2cAddress;
+    SampleRingBuffer<Sample, 1024> m_samples;
+
+    // Streaming channel, -1 = single shot conversions of all channels
+    std::atomic<int> m_streamingChannel { -1 };
+    std::atomic<quint64> m_droppedConversions { 0 };
 
-    // Thread stuff
-    QMutex m_stopMutex;
-    bool m_stop = false;
+    // Return false if the thread has been requested to stop, true if the mode changed
+    bool runSingleShot(int fd);
+    bool runStreaming(int fd);
 
-    QMutex m_valueMutex;
-    int m_channel1Value = 0;
-    int m_channel2Value = 0;
-    int m_channel3Value = 0;
-    int m_channel4Value = 0;
+    // Returns true if the filter delivered an output sample
+    bool publishStreamingSample(DecimatingFilter *filter, Channel channel, int value, qint64 timestamp);
 
-    int readInputValue(int fd, Channel channel);
+    // Returns false if the chip could not be addressed or the conversion could not be read
+    bool readInputValue(int fd, Channel channel, int *value);
 
-public slots:
-    bool enable();
-    void disable();
+    bool startContinuousConversion(int fd, Channel channel);
+    void stopContinuousConversion(int fd, Channel channel);
+    bool readConversion(int fd, int *value);
 
 };
 
@@ -23,6 +23,7 @@
 #include "bmp180.h"
 #include "i2cport.h"
 #include "extern-plugininfo.h"
+#include "sensorhealthcheck.h"
 
 #include <math.h>
 #include <fcntl.h>
@@ -35,12 +36,18 @@
 #include <linux/i2c-dev.h>
 
 #include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QDateTime>
 #include <QtEndian>
+#include <QMutexLocker>
+
+// The calibration EEPROM never changes, every chip only gets read once per process
+static QMutex s_calibrationCacheMutex;
+static QHash<QString, QByteArray> s_calibrationCache;
 
 BMP180::BMP180(const QString &i2cPortName, int i2cAddress, QObject *parent) :
-    QThread(parent),
-    m_i2cPortName(i2cPortName),
-    m_i2cAddress(i2cAddress)
+    SensorThread("BMP180", i2cPortName, i2cAddress, parent)
 {
 
 }
@@ -51,16 +58,15 @@ BMP180::~BMP180()
     wait();
 }
 
-double BMP180::currentPressureValue()
+QStringList BMP180::captureColumns() const
 {
-    QMutexLocker valueLocker(&m_valueMutex);
-    return m_pressure;
+    return QStringList() << "pressure" << "altitude";
 }
 
-double BMP180::currentAltitudeValue()
+void BMP180::invalidateCalibration()
 {
-    QMutexLocker valueLocker(&m_valueMutex);
-    return m_altitude;
+    QMutexLocker cacheLocker(&s_calibrationCacheMutex);
+    s_calibrationCache.remove(calibrationCacheKey());
 }
 
 void BMP180::run()
@@ -78,63 +84,202 @@ void BMP180::run()
     }
 
     int fileDescriptor = i2cFile.handle();
-    qCDebug(dcSensorStation()) << "BMP180: start reading calibration values...";
-    if (ioctl(fileDescriptor, I2C_SLAVE, m_i2cAddress) < 0) {
-        qCWarning(dcSensorStation()) << "BMP180: Could not set I2C into slave mode" << i2cFile.fileName() << QString("0x%1").arg(m_i2cAddress, 0, 16);
-        return;
-    }
 
-    // Load the calibration data from the sensors EEPROM
-    loadCalibrationData(fileDescriptor);
+    // Measurement range of the chip, a frozen chip returns the same raw values forever (1 min at 2 Hz)
+    SensorHealthCheck pressureCheck(300, 1100, 0);
+    SensorHealthCheck frameCheck(0, 1e12, 120);
+    bool initialized = false;
+    bool useCache = true;
 
     // Continuouse reading of the ADC values
     qCDebug(dcSensorStation()) << "BMP180: start measuring..." << this << "Process PID:" << syscall(SYS_gettid);
     while (true) {
-        if (ioctl(fileDescriptor, I2C_SLAVE, m_i2cAddress) < 0) {
-            qCWarning(dcSensorStation()) << "BMP180: Could not set I2C into slave mode" << i2cFile.fileName() << QString("0x%1").arg(m_i2cAddress, 0, 16);
-            continue;
+        if (!initialized) {
+            // Retry until the calibration could be read
+            if (!loadCalibration(fileDescriptor, useCache)) {
+                if (!interruptibleSleep(500))
+                    break;
+
+                continue;
+            }
+
+            initialized = true;
+            useCache = true;
+            pressureCheck.reset();
+            frameCheck.reset();
         }
 
-        // Read temperature
-        long rawTemperature = readRawTemperature(fileDescriptor);
+        // Note: the bus gets locked per command and result, not during the conversions
+        long rawTemperature = 0;
+        long rawPressure = 0;
+        if (!readRawTemperature(fileDescriptor, &rawTemperature) || !readRawPressure(fileDescriptor, &rawPressure)) {
+            qCWarning(dcSensorStation()) << "BMP180: Could not read the raw values";
+            countError();
+            SensorHealthCheck::Fault fault = frameCheck.addFailure();
+            if (fault != SensorHealthCheck::FaultNone) {
+                recover(fileDescriptor, fault);
+                useCache = false;
+                initialized = false;
+            }
+
+            if (!interruptibleSleep(500))
+                break;
+
+            continue;
+        }
 
-        // Read pressure
-        long rawPressure = readRawPressure(fileDescriptor);
         long pressure = calculatePressure(rawTemperature, rawPressure);
         double pressureConverted = pressure * 0.01;
         double altitude = calculateAltitude(pressure);
 
+        // Raw temperature (16 bit) and pressure (up to 19 bit) as one frame
+        SensorHealthCheck::Fault fault = frameCheck.addValue(static_cast<double>(rawTemperature) * 524288.0 + rawPressure);
+        if (fault == SensorHealthCheck::FaultNone)
+            fault = pressureCheck.addValue(pressureConverted);
+
+        if (fault != SensorHealthCheck::FaultNone) {
+            // Note: implausible values usually come from a corrupted calibration, read it again
+            recover(fileDescriptor, fault);
+            useCache = false;
+            initialized = false;
+            continue;
+        }
+
+        if (!pressureCheck.isValid()) {
+            qCWarning(dcSensorStation()) << "BMP180: Dropping implausible pressure" << pressureConverted << "[hPa]";
+            countError();
+            if (!waitForNextCycle(500))
+                break;
+
+            continue;
+        }
+
         // For debugging
         //double temperature = calculateTemperature(rawTemperature);
         //qCDebug(dcSensorStation()) << "BMP180: Temperature" << temperature <<  "[°C] | Pressure" << pressure << "[Pa]" << pressureConverted << "[hPa ]" << altitude << "[m]";
 
-        QMutexLocker valueLocker(&m_valueMutex);
-        m_altitude = altitude;
-        m_pressure = pressureConverted;
+        Sample sample;
+        sample.timestamp = QDateTime::currentMSecsSinceEpoch();
+        sample.pressure = pressureConverted;
+        sample.altitude = altitude;
+        m_samples.push(sample);
+        countSample();
+        captureSample(sample.timestamp, static_cast<float>(pressureConverted), static_cast<float>(altitude));
 
-        QMutexLocker stopLocker(&m_stopMutex);
-        if (m_stop) break;
-        msleep(500);
+        if (!waitForNextCycle(500))
+            break;
     }
 
     i2cFile.close();
     qCDebug(dcSensorStation()) << "BMP180: Reading thread finished.";
 }
 
-void BMP180::loadCalibrationData(int fileDescriptor)
+bool BMP180::loadCalibration(int fileDescriptor, bool useCache)
 {
-#ifdef __arm__
-    m_calibrationAc1 = qToBigEndian(static_cast<qint16>(i2c_smbus_read_word_data(fileDescriptor, 0xAA)));
-    m_calibrationAc2 = qToBigEndian(static_cast<qint16>(i2c_smbus_read_word_data(fileDescriptor, 0xAC)));
-    m_calibrationAc3 = qToBigEndian(static_cast<qint16>(i2c_smbus_read_word_data(fileDescriptor, 0xAE)));
-    m_calibrationAc4 = qToBigEndian(static_cast<quint16>(i2c_smbus_read_word_data(fileDescriptor, 0xB0)));
-    m_calibrationAc5 = qToBigEndian(static_cast<quint16>(i2c_smbus_read_word_data(fileDescriptor, 0xB2)));
-    m_calibrationAc6 = qToBigEndian(static_cast<quint16>(i2c_smbus_read_word_data(fileDescriptor, 0xB4)));
-    m_calibrationB1 = qToBigEndian(static_cast<qint16>(i2c_smbus_read_word_data(fileDescriptor, 0xB6)));
-    m_calibrationB2 = qToBigEndian(static_cast<qint16>(i2c_smbus_read_word_data(fileDescriptor, 0xB8)));
-    m_calibrationMB = qToBigEndian(static_cast<qint16>(i2c_smbus_read_word_data(fileDescriptor, 0xBA)));
-    m_calibrationMC = qToBigEndian(static_cast<qint16>(i2c_smbus_read_word_data(fileDescriptor, 0xBC)));
-    m_calibrationMD = qToBigEndian(static_cast<qint16>(i2c_smbus_read_word_data(fileDescriptor, 0xBE)));
+    QByteArray eeprom;
+    if (useCache) {
+        QMutexLocker cacheLocker(&s_calibrationCacheMutex);
+        eeprom = s_calibrationCache.value(calibrationCacheKey());
+    }
+
+    if (eeprom.isEmpty()) {
+        qCDebug(dcSensorStation()) << "BMP180: start reading calibration values...";
+        {
+            I2CBusLocker busLocker(m_i2cPortName, fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+            if (!busLocker.isValid()) {
+                qCWarning(dcSensorStation()) << "BMP180: Could not set I2C into slave mode" << m_i2cPortName << QString("0x%1").arg(m_i2cAddress, 0, 16);
+                countError();
+                return false;
+            }
+
+            // Load the calibration data from the sensors EEPROM
+            eeprom = readCalibrationData(fileDescriptor);
+        }
+
+        if (eeprom.isEmpty()) {
+            qCWarning(dcSensorStation()) << "BMP180: Could not read the calibration data";
+            countError();
+            return false;
+        }
+
+        QMutexLocker cacheLocker(&s_calibrationCacheMutex);
+        s_calibrationCache.insert(calibrationCacheKey(), eeprom);
+    } else {
+        qCDebug(dcSensorStation()) << "BMP180: using cached calibration values";
+    }
+
+    applyCalibrationData(eeprom);
+    return true;
+}
+
+bool BMP180::recover(int fileDescriptor, SensorHealthCheck::Fault fault)
+{
+    qCWarning(dcSensorStation()) << "BMP180: Health check failed:" << SensorHealthCheck::faultToString(fault) << "Resetting the sensor and reloading the calibration.";
+    countRecovery();
+
+    bool written = false;
+    {
+        I2CBusLocker busLocker(m_i2cPortName, fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+        if (busLocker.isValid()) {
+            // Soft reset: write 0xB6 into register 0xE0
+            quint8 command[2] = {0xE0, 0xB6};
+            written = write(fileDescriptor, command, 2) == 2;
+        }
+    }
+
+    if (!written) {
+        qCWarning(dcSensorStation()) << "BMP180: Could not reset the sensor.";
+        countError();
+        return false;
+    }
+
+    // Start up time after the reset: 10 ms
+    return interruptibleSleep(10);
+}
+
+QString BMP180::calibrationCacheKey() const
+{
+    return QString("%1;%2;%3;%4").arg(m_i2cPortName).arg(m_muxAddress).arg(m_muxChannel).arg(m_i2cAddress);
+}
+
+QByteArray BMP180::readCalibrationData(int fileDescriptor)
+{
+    // Note: the EEPROM auto increments the register, all 11 words can be read in one transfer
+    quint8 reg = 0xAA;
+    if (write(fileDescriptor, &reg, 1) != 1)
+        return QByteArray();
+
+    QByteArray eeprom(22, 0);
+    if (read(fileDescriptor, eeprom.data(), eeprom.size()) != eeprom.size())
+        return QByteArray();
+
+    // According to the datasheet no word is 0x0000 or 0xFFFF, otherwise the communication failed
+    const uchar *data = reinterpret_cast<const uchar *>(eeprom.constData());
+    for (int i = 0; i < eeprom.size(); i += 2) {
+        quint16 word = qFromBigEndian<quint16>(data + i);
+        if (word == 0x0000 || word == 0xFFFF) {
+            qCWarning(dcSensorStation()) << "BMP180: Invalid calibration word" << QString("0x%1").arg(0xAA + i, 0, 16) << word;
+            return QByteArray();
+        }
+    }
+
+    return eeprom;
+}
+
+void BMP180::applyCalibrationData(const QByteArray &eeprom)
+{
+    const uchar *data = reinterpret_cast<const uchar *>(eeprom.constData());
+    m_calibrationAc1 = qFromBigEndian<qint16>(data);
+    m_calibrationAc2 = qFromBigEndian<qint16>(data + 2);
+    m_calibrationAc3 = qFromBigEndian<qint16>(data + 4);
+    m_calibrationAc4 = qFromBigEndian<quint16>(data + 6);
+    m_calibrationAc5 = qFromBigEndian<quint16>(data + 8);
+    m_calibrationAc6 = qFromBigEndian<quint16>(data + 10);
+    m_calibrationB1 = qFromBigEndian<qint16>(data + 12);
+    m_calibrationB2 = qFromBigEndian<qint16>(data + 14);
+    m_calibrationMB = qFromBigEndian<qint16>(data + 16);
+    m_calibrationMC = qFromBigEndian<qint16>(data + 18);
+    m_calibrationMD = qFromBigEndian<qint16>(data + 20);
 
     qCDebug(dcSensorStation()) << "BMP180: AC1" << m_calibrationAc1;
     qCDebug(dcSensorStation()) << "BMP180: AC2" << m_calibrationAc2;
@@ -147,9 +292,6 @@ void BMP180::loadCalibrationData(int fileDescriptor)
     qCDebug(dcSensorStation()) << "BMP180: MB" << m_calibrationMB;
     qCDebug(dcSensorStation()) << "BMP180: MC" << m_calibrationMC;
     qCDebug(dcSensorStation()) << "BMP180: MD" << m_calibrationMD;
-#else
-    Q_UNUSED(fileDescriptor)
-#endif // __arm__
 }
 
 bool BMP180::sendCommand(int fileDescriptor, quint8 command)
@@ -174,21 +316,36 @@ bool BMP180::sendCommand(int fileDescriptor, quint8 command)
 #endif // __arm__
 }
 
-long BMP180::readRawTemperature(int fileDescriptor)
+bool BMP180::readRawTemperature(int fileDescriptor, long *rawTemperature)
 {
-    long rawTemperature = 0;
+    *rawTemperature = 0;
 #ifdef __arm__
     // Send command to measure temperature (0x2E)
-    if (!sendCommand(fileDescriptor, 0x2E)) {
-        return rawTemperature;
+    {
+        I2CBusLocker busLocker(m_i2cPortName, fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+        if (!busLocker.isValid() || !sendCommand(fileDescriptor, 0x2E)) {
+            return false;
+        }
     }
+
     msleep(5);
-    qint16 rawValue = i2c_smbus_read_word_data(fileDescriptor, 0xF6);
-    rawTemperature = static_cast<long>(qToBigEndian(rawValue));
+    I2CBusLocker busLocker(m_i2cPortName, fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+    if (!busLocker.isValid()) {
+        return false;
+    }
+
+    // Note: the SMBus calls return -1 on failure, which would be a valid looking raw value
+    int rawValue = i2c_smbus_read_word_data(fileDescriptor, 0xF6);
+    if (rawValue < 0) {
+        return false;
+    }
+
+    *rawTemperature = static_cast<long>(qToBigEndian(static_cast<quint16>(rawValue)));
+    return true;
 #else
     Q_UNUSED(fileDescriptor)
+    return false;
 #endif // __arm__
-    return rawTemperature;
 }
 
 double BMP180::calculateTemperature(long rawTemperature)
@@ -200,13 +357,16 @@ double BMP180::calculateTemperature(long rawTemperature)
     return static_cast<double>((b5 + 8) >> 4) / 10.0;
 }
 
-long BMP180::readRawPressure(int fileDescriptor)
+bool BMP180::readRawPressure(int fileDescriptor, long *rawPressure)
 {
-    long rawPressure = 0;
+    *rawPressure = 0;
 #ifdef __arm__
     // Send command to measure pressure (0x34)
-    if (!sendCommand(fileDescriptor, 0x34 + (static_cast<quint8>(m_mode) << 6))) {
-        return rawPressure;
+    {
+        I2CBusLocker busLocker(m_i2cPortName, fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+        if (!busLocker.isValid() || !sendCommand(fileDescriptor, 0x34 + (static_cast<quint8>(m_mode) << 6))) {
+            return false;
+        }
     }
 
     switch (m_mode) {
@@ -223,17 +383,28 @@ long BMP180::readRawPressure(int fileDescriptor)
         msleep(26);
         break;
     }
-    quint8 rawMsb = i2c_smbus_read_byte_data(fileDescriptor, 0xF6);
-    quint8 rawLsb = i2c_smbus_read_byte_data(fileDescriptor, 0xF7);
-    quint8 rawXlsb = i2c_smbus_read_byte_data(fileDescriptor, 0xF8);
+
+    I2CBusLocker busLocker(m_i2cPortName, fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+    if (!busLocker.isValid()) {
+        return false;
+    }
+
+    int rawMsb = i2c_smbus_read_byte_data(fileDescriptor, 0xF6);
+    int rawLsb = i2c_smbus_read_byte_data(fileDescriptor, 0xF7);
+    int rawXlsb = i2c_smbus_read_byte_data(fileDescriptor, 0xF8);
+    if (rawMsb < 0 || rawLsb < 0 || rawXlsb < 0) {
+        return false;
+    }
+
     long msb = static_cast<long>(rawMsb);
     long lsb = static_cast<long>(rawLsb);
     long xlsb = static_cast<long>(rawXlsb);
-    rawPressure = ((msb << 16) + (lsb << 8) + xlsb) >> (8 - static_cast<quint8>(m_mode));
+    *rawPressure = ((msb << 16) + (lsb << 8) + xlsb) >> (8 - static_cast<quint8>(m_mode));
+    return true;
 #else
     Q_UNUSED(fileDescriptor)
+    return false;
 #endif // __arm__
-    return rawPressure;
 }
 
 long BMP180::calculatePressure(long rawTemperature, long rawPressure)
@@ -288,32 +459,3 @@ double BMP180::calculateAltitude(long pressure)
     // altitude = 44330.0 * (1.0 - pow(pressure / sealevel-pressure, (1.0/5.255)))
     return 44330.0 * (1.0 - pow(pressure / 101325.0, (1.0/5.255)));
 }
-
-bool BMP180::enable()
-{
-    // Check if this address can be opened
-    I2CPort port(m_i2cPortName);
-    if (!port.openPort(m_i2cAddress)) {
-        qCWarning(dcSensorStation()) << "BMP180 is not available on port" << port.portDeviceName() << QString("0x%1").arg(m_i2cAddress, 0, 16);;
-        return false;
-    }
-    port.closePort();
-
-    // Start the reading thread
-    QMutexLocker locker(&m_stopMutex);
-    m_stop = false;
-    start();
-    return true;
-}
-
-void BMP180::disable()
-{
-    // Stop the thread if not already disabled
-    QMutexLocker locker(&m_stopMutex);
-    if (m_stop)
-        return;
-
-    qCDebug(dcSensorStation()) << "BMP180: Disable measurements";
-    m_stop = true;
-}
-
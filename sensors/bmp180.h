@@ -23,12 +23,13 @@
 #ifndef BMP180_H
 #define BMP180_H
 
-#include <QMutex>
 #include <QObject>
-#include <QThread>
-#include <QMutexLocker>
 
-class BMP180 : public QThread
+#include "sensorthread.h"
+#include "sensorhealthcheck.h"
+#include "sampleringbuffer.h"
+
+class BMP180 : public SensorThread
 {
     Q_OBJECT
 public:
@@ -40,24 +41,33 @@ public:
     };
     Q_ENUM(OperationMode)
 
+    struct Sample {
+        qint64 timestamp = 0;
+        double pressure = 0;
+        double altitude = 0;
+    };
+
     explicit BMP180(const QString &i2cPortName = "i2c-1", int i2cAddress = 0x77, QObject *parent = nullptr);
     ~BMP180() override;
 
-    double currentPressureValue();
-    double currentAltitudeValue();
+    // Raw samples collected since the last call, consumer side of the ring buffer
+    template <typename Function>
+    int consumeSamples(Function function) { return m_samples.consume(function); }
+    quint64 droppedSamples() const { return m_samples.droppedCount(); }
+
+    bool injectSample(const Sample &sample) { return m_samples.push(sample); }
+
+    QStringList captureColumns() const override;
+
+    // Read the calibration EEPROM again on the next start, e.g. after a different sensor head got plugged in
+    void invalidateCalibration();
 
 protected:
     void run() override;
 
 private:
-    QString m_i2cPortName;
-    int m_i2cAddress;
     bool m_available = false;
 
-    // Thread stuff
-    QMutex m_stopMutex;
-    bool m_stop = false;
-
     qint16 m_calibrationAc1 = 0;
     qint16 m_calibrationAc2 = 0;
     qint16 m_calibrationAc3 = 0;
@@ -72,28 +82,30 @@ private:
 
     OperationMode m_mode = OperationModeStandard;
 
-    QMutex m_valueMutex;
-    double m_pressure = 0;
-    double m_altitude = 0;
+    SampleRingBuffer<Sample, 1024> m_samples;
+
+    // Calibration EEPROM (0xAA - 0xBF), read in one block and cached per bus and address
+    QString calibrationCacheKey() const;
+    bool loadCalibration(int fileDescriptor, bool useCache);
+    QByteArray readCalibrationData(int fileDescriptor);
+    void applyCalibrationData(const QByteArray &eeprom);
 
-    // Read methods for the sensor
-    void loadCalibrationData(int fileDescriptor);
+    // Soft reset after a failed health check
+    bool recover(int fileDescriptor, SensorHealthCheck::Fault fault);
+
+    // Read methods for the sensor, return false if a transfer failed. The caller counts the error.
     bool sendCommand(int fileDescriptor, quint8 command);
 
     // Temperature calculation
-    long readRawTemperature(int fileDescriptor);
+    bool readRawTemperature(int fileDescriptor, long *rawTemperature);
     double calculateTemperature(long rawTemperature);
 
     // Pressure calculation
-    long readRawPressure(int fileDescriptor);
+    bool readRawPressure(int fileDescriptor, long *rawPressure);
     long calculatePressure(long rawTemperature, long rawPressure);
     double calculateAltitude(long pressure);
     double convertPressureValue();
 
-public slots:
-    bool enable();
-    void disable();
-
 };
 
 #endif // BMP180_H
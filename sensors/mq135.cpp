@@ -23,10 +23,12 @@
 #include "mq135.h"
 #include "math.h"
 
+#include <vector>
+
 /// The load resistance on the board
 #define RLOAD 10.0
 
-/// Calibration resistance at atmospheric CO2 level
+/// Default calibration resistance at atmospheric CO2 level
 #define RZERO 350 //76.63
 
 /// Parameters for calculating ppm of CO2 from sensor resistance
@@ -40,13 +42,16 @@
 #define CORD 0.0018
 
 /// Atmospheric CO2 level for calibration purposes
-#define ATMOCO2 397.13
+#define ATMOCO2 400.0
+
+/// Highest code of the ADC with gain 1
+#define ADCMAX 32767
 
-MQ135::MQ135(QObject *parent) : QObject(parent)
+MQ135::MQ135(QObject *parent) :
+    QObject(parent),
+    m_rZero(RZERO)
 {
-    m_filter = new SensorDataFilter(SensorDataFilter::TypeLowPass, this);
-    m_filter->setLowPassAlpha(0.4);
-    m_filter->setFilterWindowSize(5);
+
 }
 
 void MQ135::setAdcValue(int adcValue)
@@ -56,17 +61,40 @@ void MQ135::setAdcValue(int adcValue)
 
 void MQ135::setTemperature(double temperature)
 {
-    m_temperature = temperature;
+    if (!qFuzzyCompare(m_temperature, temperature)) {
+        m_temperature = temperature;
+        m_scaleValid = false;
+    }
 }
 
 void MQ135::setHumidity(double humidity)
 {
-    m_humidity = humidity;
+    if (!qFuzzyCompare(m_humidity, humidity)) {
+        m_humidity = humidity;
+        m_scaleValid = false;
+    }
 }
 
 double MQ135::calculatePpmValue()
 {
-    return qRound(m_filter->filterValue(PARA * pow((getResistance() / RZERO), -PARB)));
+    if (m_adcValue <= 0 || m_adcValue > ADCMAX)
+        return 0;
+
+    // PARA * (Rs / (Cf * R0))^-PARB = Rs^-PARB * PARA * (Cf * R0)^PARB
+    if (!m_scaleValid) {
+        m_scale = PARA * pow(getCorrectionFactor() * m_rZero, PARB);
+        m_scaleValid = true;
+    }
+
+    return static_cast<double>(powerTable()[m_adcValue]) * m_scale;
+}
+
+double MQ135::calculateReferencePpmValue()
+{
+    if (m_adcValue <= 0 || m_adcValue > ADCMAX)
+        return 0;
+
+    return getCorrectedPPM();
 }
 
 double MQ135::getCalibrationRestistance()
@@ -74,11 +102,66 @@ double MQ135::getCalibrationRestistance()
     return getRZero();
 }
 
-double MQ135::getCorrectionFactor()
+double MQ135::getCorrectionFactor() const
 {
     return CORA * m_temperature * m_temperature - CORB * m_temperature + CORC - (m_humidity - 33.0) * CORD;
 }
 
+double MQ135::rZero() const
+{
+    return m_rZero;
+}
+
+void MQ135::setRZero(double rZero)
+{
+    if (!qFuzzyCompare(m_rZero, rZero)) {
+        m_rZero = rZero;
+        m_scaleValid = false;
+    }
+}
+
+double MQ135::defaultRZero()
+{
+    return RZERO;
+}
+
+double MQ135::validate()
+{
+    MQ135 sensor;
+    double maximumError = 0;
+    for (int temperature = -20; temperature <= 50; temperature += 10) {
+        for (int humidity = 10; humidity <= 90; humidity += 20) {
+            sensor.setTemperature(temperature);
+            sensor.setHumidity(humidity);
+            for (int adcValue = 1; adcValue <= ADCMAX; adcValue++) {
+                sensor.setAdcValue(adcValue);
+                double reference = sensor.calculateReferencePpmValue();
+                double error = fabs(sensor.calculatePpmValue() - reference) / reference;
+                if (error > maximumError) {
+                    maximumError = error;
+                }
+            }
+        }
+    }
+
+    return maximumError;
+}
+
+const float *MQ135::powerTable()
+{
+    // Rs^-PARB for every ADC code, 128 KiB shared by all instances
+    static const std::vector<float> table = [] {
+        std::vector<float> values(ADCMAX + 1, 0);
+        for (int adcValue = 1; adcValue <= ADCMAX; adcValue++) {
+            double resistance = ((32767.0 * 4.096 / adcValue) - 1.0) * RLOAD;
+            values[static_cast<size_t>(adcValue)] = static_cast<float>(pow(resistance, -PARB));
+        }
+        return values;
+    }();
+
+    return table.data();
+}
+
 double MQ135::getResistance()
 {
     // Note: 32767 is the max value of the the ADC with gain 1
@@ -92,7 +175,7 @@ double MQ135::getCorrectedResistance()
 
 double MQ135::getCorrectedPPM()
 {
-    return PARA * pow((getCorrectedResistance() / RZERO), -PARB);
+    return PARA * pow((getCorrectedResistance() / m_rZero), -PARB);
 }
 
 double MQ135::getRZero()
@@ -102,5 +185,6 @@ double MQ135::getRZero()
 
 double MQ135::getCorrectedRZero()
 {
-    return getCorrectedResistance() * pow((ATMOCO2 / PARA), (1.0 / PARB));
+    static const double factor = pow((ATMOCO2 / PARA), (1.0 / PARB));
+    return getCorrectedResistance() * factor;
 }
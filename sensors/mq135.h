@@ -25,9 +25,13 @@
 
 #include <QObject>
 
-#include "sensordatafilter.h"
-
 // Reference: https://github.com/GeorgK/MQ135
+//
+// The ppm value follows the power law ppm = PARA * (Rs / (Cf * R0))^-PARB, with Rs the
+// sensor resistance and Cf the temperature/humidity correction factor. Rs only depends on
+// the ADC value, so Rs^-PARB gets precomputed once for every ADC code. The remaining factor
+// PARA * (Cf * R0)^PARB only changes with temperature and humidity. A ppm value costs one
+// table lookup and one multiplication, the pow() reference is kept for validation.
 
 class MQ135 : public QObject
 {
@@ -39,22 +43,41 @@ public:
     void setTemperature(double temperature);
     void setHumidity(double humidity);
 
+    // Temperature and humidity corrected ppm, 0 for invalid ADC values
     double calculatePpmValue();
+    double calculateReferencePpmValue();
+
     double getCalibrationRestistance();
+    double getCorrectionFactor() const;
 
-private:
-    SensorDataFilter *m_filter = nullptr;
+    // Sensor resistance at the atmospheric CO2 level, the calibration of the ppm conversion
+    double rZero() const;
+    void setRZero(double rZero);
+
+    // RZero assuming the current reading is atmospheric CO2, input of the baseline calibration
+    double getCorrectedRZero();
+
+    static double defaultRZero();
 
+    // Maximum relative error of calculatePpmValue() against calculateReferencePpmValue()
+    // over all ADC codes and the operating range of temperature and humidity
+    static double validate();
+
+private:
     int m_adcValue = 0;
     double m_temperature = 22.0;
     double m_humidity = 50.0;
+    double m_rZero;
+
+    bool m_scaleValid = false;
+    double m_scale = 0;
+
+    static const float *powerTable();
 
-    double getCorrectionFactor();
     double getResistance();
     double getCorrectedResistance();
     double getCorrectedPPM();
     double getRZero();
-    double getCorrectedRZero();
 
 };
 
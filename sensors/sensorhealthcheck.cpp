@@ -0,0 +1,92 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "sensorhealthcheck.h"
+
+SensorHealthCheck::SensorHealthCheck(double minimum, double maximum, int stuckLimit, int failureLimit) :
+    m_minimum(minimum),
+    m_maximum(maximum),
+    m_stuckLimit(stuckLimit),
+    m_failureLimit(failureLimit)
+{
+
+}
+
+SensorHealthCheck::Fault SensorHealthCheck::addValue(double value)
+{
+    // Note: a successful reading ends a series of communication failures
+    m_failureCount = 0;
+
+    m_valid = value >= m_minimum && value <= m_maximum;
+    if (!m_valid) {
+        m_outOfRangeCount++;
+        return m_outOfRangeCount == m_failureLimit ? FaultOutOfRange : FaultNone;
+    }
+    m_outOfRangeCount = 0;
+
+    // Zero variance over the last stuckLimit samples
+    if (m_hasPreviousValue && value == m_previousValue) {
+        m_identicalCount++;
+    } else {
+        m_identicalCount = 1;
+    }
+    m_hasPreviousValue = true;
+    m_previousValue = value;
+
+    return (m_stuckLimit > 0 && m_identicalCount == m_stuckLimit) ? FaultStuck : FaultNone;
+}
+
+SensorHealthCheck::Fault SensorHealthCheck::addFailure()
+{
+    m_failureCount++;
+    return m_failureCount == m_failureLimit ? FaultCommunication : FaultNone;
+}
+
+bool SensorHealthCheck::isValid() const
+{
+    return m_valid;
+}
+
+void SensorHealthCheck::reset()
+{
+    m_valid = false;
+    m_hasPreviousValue = false;
+    m_previousValue = 0;
+    m_identicalCount = 0;
+    m_outOfRangeCount = 0;
+    m_failureCount = 0;
+}
+
+QString SensorHealthCheck::faultToString(SensorHealthCheck::Fault fault)
+{
+    switch (fault) {
+    case FaultNone:
+        return "none";
+    case FaultOutOfRange:
+        return "value out of range";
+    case FaultStuck:
+        return "value stuck";
+    case FaultCommunication:
+        return "communication failures";
+    }
+    return QString();
+}
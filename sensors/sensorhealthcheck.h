@@ -0,0 +1,77 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SENSORHEALTHCHECK_H
+#define SENSORHEALTHCHECK_H
+
+#include <QString>
+
+// Streaming plausibility check of one sensor channel.
+//
+// Every reading gets checked against the physically possible range, the
+// number of identical readings in a row (a frozen chip returns the same
+// frame forever, real sensors always have some noise in the last bit) and
+// the number of failed readings in a row (e.g. CRC errors). Only counters
+// and the previous value are kept, so each check is O(1).
+//
+// A fault gets reported once when the limit is reached, the driver then
+// re-initializes the chip and calls reset().
+
+class SensorHealthCheck
+{
+public:
+    enum Fault {
+        FaultNone,
+        FaultOutOfRange,
+        FaultStuck,
+        FaultCommunication
+    };
+
+    // A stuckLimit of 0 disables the stuck detection
+    SensorHealthCheck(double minimum, double maximum, int stuckLimit, int failureLimit = 10);
+
+    // Returns FaultNone if the value is plausible or the limits are not reached yet
+    Fault addValue(double value);
+    Fault addFailure();
+
+    // False if the last value was out of range and should not be used
+    bool isValid() const;
+
+    void reset();
+
+    static QString faultToString(Fault fault);
+
+private:
+    double m_minimum;
+    double m_maximum;
+    int m_stuckLimit;
+    int m_failureLimit;
+
+    bool m_valid = false;
+    bool m_hasPreviousValue = false;
+    double m_previousValue = 0;
+    int m_identicalCount = 0;
+    int m_outOfRangeCount = 0;
+    int m_failureCount = 0;
+};
+
+#endif // SENSORHEALTHCHECK_H
@@ -0,0 +1,466 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "sensorthread.h"
+#include "i2cport.h"
+#include "extern-plugininfo.h"
+
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include <QStringList>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+
+SensorThread::SensorThread(const QString &sensorName, const QString &i2cPortName, int i2cAddress, QObject *parent) :
+    QThread(parent),
+    m_sensorName(sensorName),
+    m_i2cPortName(i2cPortName),
+    m_i2cAddress(i2cAddress)
+{
+    // Note: both signals are emitted from within the new thread
+    connect(this, &QThread::started, this, &SensorThread::onThreadStarted, Qt::DirectConnection);
+    connect(this, &QThread::finished, this, &SensorThread::onThreadFinished, Qt::DirectConnection);
+}
+
+QString SensorThread::sensorName() const
+{
+    return m_sensorName;
+}
+
+QString SensorThread::i2cPortName() const
+{
+    return m_i2cPortName;
+}
+
+int SensorThread::i2cAddress() const
+{
+    return m_i2cAddress;
+}
+
+void SensorThread::setSchedulingConfiguration(const SensorThread::SchedulingConfiguration &configuration)
+{
+    QMutexLocker locker(&m_schedulingMutex);
+    m_schedulingConfiguration = configuration;
+    if (m_threadRunning) {
+        applySchedulingConfiguration();
+    }
+}
+
+SensorThread::SchedulingStatus SensorThread::schedulingStatus() const
+{
+    return static_cast<SchedulingStatus>(m_schedulingStatus.load(std::memory_order_relaxed));
+}
+
+SensorThread::WakeUpLatency SensorThread::wakeUpLatency() const
+{
+    WakeUpLatency latency;
+    latency.count = m_wakeUpCount.load(std::memory_order_relaxed);
+    if (latency.count > 0) {
+        latency.averageMicroSeconds = m_wakeUpLatencySum.load(std::memory_order_relaxed) / 1000.0 / latency.count;
+        latency.maxMicroSeconds = m_wakeUpLatencyMax.load(std::memory_order_relaxed) / 1000.0;
+    }
+    return latency;
+}
+
+void SensorThread::resetWakeUpLatency()
+{
+    m_wakeUpCount.store(0, std::memory_order_relaxed);
+    m_wakeUpLatencySum.store(0, std::memory_order_relaxed);
+    m_wakeUpLatencyMax.store(0, std::memory_order_relaxed);
+}
+
+QList<int> SensorThread::parseCpuList(const QString &cpuList)
+{
+    // Same syntax as taskset -c, e.g. "0,2-3"
+    QList<int> cpus;
+    foreach (const QString &entry, cpuList.split(',', QString::SkipEmptyParts)) {
+        QStringList range = entry.trimmed().split('-');
+        bool firstOk = false;
+        bool lastOk = false;
+        int first = range.first().toInt(&firstOk);
+        int last = range.last().toInt(&lastOk);
+        if (!firstOk || !lastOk || range.count() > 2 || first < 0 || last < first || last >= CPU_SETSIZE) {
+            qCWarning(dcSensorStation()) << "Invalid CPU list entry" << entry << "in" << cpuList;
+            continue;
+        }
+
+        for (int cpu = first; cpu <= last; cpu++) {
+            if (!cpus.contains(cpu)) {
+                cpus.append(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+SensorThread::Metrics SensorThread::metrics()
+{
+    Metrics metrics;
+    metrics.samples = m_sampleCount.load(std::memory_order_relaxed);
+    metrics.errors = m_errorCount.load(std::memory_order_relaxed);
+    metrics.recoveries = m_recoveryCount.load(std::memory_order_relaxed);
+    metrics.wakeUps = m_wakeUpTotal.load(std::memory_order_relaxed);
+    metrics.cpuTime = m_cpuTime.load(std::memory_order_relaxed);
+    metrics.i2cTransactions = m_busStatistics.transactions.load(std::memory_order_relaxed);
+    metrics.i2cFailures = m_busStatistics.failures.load(std::memory_order_relaxed);
+    metrics.i2cDurationSum = m_busStatistics.durationSum.load(std::memory_order_relaxed);
+    metrics.i2cDurationMax = m_busStatistics.durationMax.exchange(0, std::memory_order_relaxed);
+    return metrics;
+}
+
+int SensorThread::muxAddress() const
+{
+    return m_muxAddress;
+}
+
+int SensorThread::muxChannel() const
+{
+    return m_muxChannel;
+}
+
+void SensorThread::setMultiplexer(int muxAddress, int muxChannel)
+{
+    m_muxAddress = muxAddress;
+    m_muxChannel = muxChannel;
+}
+
+bool SensorThread::dutyCycleEnabled()
+{
+    QMutexLocker locker(&m_stopMutex);
+    return m_dutyCycleEnabled;
+}
+
+void SensorThread::setDutyCycleEnabled(bool enabled)
+{
+    QMutexLocker locker(&m_stopMutex);
+    m_dutyCycleEnabled = enabled;
+    m_stopCondition.wakeAll();
+}
+
+int SensorThread::samplesPerWindow()
+{
+    QMutexLocker locker(&m_stopMutex);
+    return m_samplesPerWindow;
+}
+
+void SensorThread::setSamplesPerWindow(int samplesPerWindow)
+{
+    QMutexLocker locker(&m_stopMutex);
+    m_samplesPerWindow = qMax(1, samplesPerWindow);
+}
+
+int SensorThread::cyclePeriod()
+{
+    QMutexLocker locker(&m_stopMutex);
+    return m_cyclePeriod;
+}
+
+QStringList SensorThread::captureColumns() const
+{
+    return QStringList();
+}
+
+bool SensorThread::captureEnabled() const
+{
+    return m_captureEnabled.load(std::memory_order_relaxed);
+}
+
+void SensorThread::setCaptureEnabled(bool enabled)
+{
+    // Note: samples left over from the last capture would end up in the new files
+    if (enabled && !m_captureEnabled.load(std::memory_order_relaxed))
+        m_captureSamples.clear();
+
+    m_captureEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool SensorThread::interruptibleSleep(unsigned long msecs)
+{
+    QMutexLocker locker(&m_stopMutex);
+    if (m_stop)
+        return false;
+
+    // Note: spurious wake ups only shorten one cycle, no need to loop here
+    QElapsedTimer timer;
+    timer.start();
+    bool woken = m_stopCondition.wait(&m_stopMutex, msecs);
+    m_wakeUpTotal.fetch_add(1, std::memory_order_relaxed);
+    if (!woken) {
+        // Timed out as requested, measure how late we got the CPU back
+        qint64 latency = qMax(Q_INT64_C(0), timer.nsecsElapsed() - static_cast<qint64>(msecs) * 1000000);
+        m_wakeUpCount.fetch_add(1, std::memory_order_relaxed);
+        m_wakeUpLatencySum.fetch_add(latency, std::memory_order_relaxed);
+        if (latency > m_wakeUpLatencyMax.load(std::memory_order_relaxed)) {
+            m_wakeUpLatencyMax.store(latency, std::memory_order_relaxed);
+        }
+    }
+    return !m_stop;
+}
+
+bool SensorThread::isStopRequested()
+{
+    QMutexLocker locker(&m_stopMutex);
+    return m_stop;
+}
+
+bool SensorThread::waitForNextCycle(unsigned long msecs)
+{
+    updateCpuTime();
+
+    {
+        QMutexLocker locker(&m_stopMutex);
+
+        // Note: the first sample of a window would include the power down sleep, smooth the rest over a few cycles
+        if (m_windowSamples > 0 && m_cycleTimer.isValid()) {
+            int period = static_cast<int>(m_cycleTimer.elapsed());
+            m_cyclePeriod = m_cyclePeriod > 0 ? (m_cyclePeriod * 3 + period) / 4 : period;
+        }
+        m_cycleTimer.start();
+
+        m_windowSamples++;
+        if (!m_dutyCycleEnabled || m_windowSamples < m_samplesPerWindow) {
+            locker.unlock();
+            return interruptibleSleep(msecs);
+        }
+
+        // From now on a wake up starts the next window
+        m_windowComplete = true;
+    }
+
+    // Window complete, nothing to do on the bus until the next window
+    qCDebug(dcSensorStation()) << qPrintable(m_sensorName + ":") << "Window complete, powering down";
+    powerDown();
+
+    {
+        QMutexLocker locker(&m_stopMutex);
+        while (!m_stop && !m_wakeUpRequested && m_dutyCycleEnabled) {
+            m_stopCondition.wait(&m_stopMutex);
+            m_wakeUpTotal.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        m_wakeUpRequested = false;
+        m_windowComplete = false;
+        m_windowSamples = 0;
+        if (m_stop) {
+            return false;
+        }
+    }
+
+    qCDebug(dcSensorStation()) << qPrintable(m_sensorName + ":") << "Starting new window, powering up";
+    if (!powerUp() && !isStopRequested()) {
+        qCWarning(dcSensorStation()) << qPrintable(m_sensorName + ":") << "Could not power up the sensor";
+    }
+
+    return !isStopRequested();
+}
+
+void SensorThread::countSample()
+{
+    m_sampleCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SensorThread::countError()
+{
+    m_errorCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SensorThread::countRecovery()
+{
+    m_recoveryCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SensorThread::countWakeUps(quint64 wakeUps)
+{
+    m_wakeUpTotal.fetch_add(wakeUps, std::memory_order_relaxed);
+    updateCpuTime();
+}
+
+void SensorThread::powerDown()
+{
+    // Note: most of the chips go idle by themselves after a single shot measurement
+}
+
+bool SensorThread::powerUp()
+{
+    return true;
+}
+
+void SensorThread::captureSample(qint64 timestamp, float value0, float value1, float value2, float value3)
+{
+    if (!m_captureEnabled.load(std::memory_order_relaxed))
+        return;
+
+    CaptureSample sample;
+    sample.timestamp = timestamp;
+    sample.values[0] = value0;
+    sample.values[1] = value1;
+    sample.values[2] = value2;
+    sample.values[3] = value3;
+    m_captureSamples.push(sample);
+}
+
+bool SensorThread::enable()
+{
+    // Check if this address can be opened
+    I2CPort port(m_i2cPortName);
+    if (!port.openPort(m_i2cAddress)) {
+        qCWarning(dcSensorStation()) << qPrintable(m_sensorName) << "is not available on port" << port.portDeviceName() << QString("0x%1").arg(m_i2cAddress, 0, 16);
+        return false;
+    }
+    port.closePort();
+
+    // Start the reading thread
+    QMutexLocker locker(&m_stopMutex);
+    m_stop = false;
+    m_wakeUpRequested = false;
+    m_windowComplete = false;
+    m_windowSamples = 0;
+    m_cycleTimer.invalidate();
+    start();
+    return true;
+}
+
+void SensorThread::disable()
+{
+    // Stop the thread if not already disabled
+    QMutexLocker locker(&m_stopMutex);
+    if (m_stop)
+        return;
+
+    qCDebug(dcSensorStation()) << qPrintable(m_sensorName + ":") << "Disable measurements";
+    m_stop = true;
+    m_stopCondition.wakeAll();
+}
+
+void SensorThread::wakeUp()
+{
+    // Note: a wake up for a running window would skip the next power down
+    QMutexLocker locker(&m_stopMutex);
+    if (!m_windowComplete)
+        return;
+
+    m_wakeUpRequested = true;
+    m_stopCondition.wakeAll();
+}
+
+void SensorThread::applySchedulingConfiguration()
+{
+    // Note: m_schedulingMutex must be locked and the thread must be running
+    SchedulingStatus status = SchedulingStatusDefault;
+    bool failed = false;
+
+    // Note: an empty list allows all CPUs again, the affinity of a previous configuration must not stay
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (m_schedulingConfiguration.cpuAffinity.isEmpty()) {
+        long cpuCount = qBound(1L, sysconf(_SC_NPROCESSORS_CONF), static_cast<long>(CPU_SETSIZE));
+        for (int cpu = 0; cpu < cpuCount; cpu++) {
+            CPU_SET(cpu, &cpuSet);
+        }
+    } else {
+        foreach (int cpu, m_schedulingConfiguration.cpuAffinity) {
+            CPU_SET(cpu, &cpuSet);
+        }
+    }
+
+    int affinityError = pthread_setaffinity_np(m_threadHandle, sizeof(cpu_set_t), &cpuSet);
+    if (affinityError != 0) {
+        qCWarning(dcSensorStation()) << qPrintable(m_sensorName + ":") << "Could not set CPU affinity" << m_schedulingConfiguration.cpuAffinity << strerror(affinityError);
+        failed = true;
+    }
+
+    struct sched_param parameter;
+    memset(&parameter, 0, sizeof(parameter));
+    if (m_schedulingConfiguration.realtimePriority > 0) {
+        parameter.sched_priority = qBound(sched_get_priority_min(SCHED_FIFO), m_schedulingConfiguration.realtimePriority, sched_get_priority_max(SCHED_FIFO));
+        int error = pthread_setschedparam(m_threadHandle, SCHED_FIFO, &parameter);
+        if (error == 0) {
+            status = SchedulingStatusRealtime;
+        } else {
+            qCWarning(dcSensorStation()) << qPrintable(m_sensorName + ":") << "Could not enable SCHED_FIFO with priority" << parameter.sched_priority << strerror(error) << "Falling back to nice level" << m_schedulingConfiguration.niceLevel;
+            status = SchedulingStatusFailed;
+        }
+    } else {
+        // Back to normal scheduling in case realtime has been enabled before
+        int error = pthread_setschedparam(m_threadHandle, SCHED_OTHER, &parameter);
+        if (error != 0) {
+            qCWarning(dcSensorStation()) << qPrintable(m_sensorName + ":") << "Could not switch back to SCHED_OTHER" << strerror(error);
+            failed = true;
+        }
+    }
+
+    // Note: the nice level is per thread on linux and ignored for SCHED_FIFO threads
+    if (status != SchedulingStatusRealtime) {
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(m_threadId), m_schedulingConfiguration.niceLevel) < 0) {
+            qCWarning(dcSensorStation()) << qPrintable(m_sensorName + ":") << "Could not set nice level" << m_schedulingConfiguration.niceLevel << strerror(errno);
+            failed = true;
+        } else if (m_schedulingConfiguration.niceLevel != 0) {
+            // The nice level is the documented fall back of a failed SCHED_FIFO
+            status = SchedulingStatusNice;
+        }
+    }
+
+    // A failed affinity or nice level must never look like a working configuration
+    if (failed)
+        status = SchedulingStatusFailed;
+
+    m_schedulingStatus.store(status, std::memory_order_relaxed);
+    qCDebug(dcSensorStation()) << qPrintable(m_sensorName + ":") << "Thread scheduling" << status << "| realtime priority" << m_schedulingConfiguration.realtimePriority << "| nice" << m_schedulingConfiguration.niceLevel << "| CPUs" << m_schedulingConfiguration.cpuAffinity;
+}
+
+void SensorThread::updateCpuTime()
+{
+    // Note: the thread clock starts at 0 for every run, keep the counter monotonic over restarts
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0) {
+        m_cpuTime.store(m_cpuTimeBase + static_cast<qint64>(time.tv_sec) * 1000000000 + time.tv_nsec, std::memory_order_relaxed);
+    }
+}
+
+void SensorThread::onThreadStarted()
+{
+    QMutexLocker locker(&m_schedulingMutex);
+    m_threadHandle = pthread_self();
+    m_threadId = static_cast<pid_t>(syscall(SYS_gettid));
+    m_threadRunning = true;
+    resetWakeUpLatency();
+    applySchedulingConfiguration();
+
+    I2CBusLocker::setThreadStatistics(&m_busStatistics);
+}
+
+void SensorThread::onThreadFinished()
+{
+    updateCpuTime();
+    m_cpuTimeBase = m_cpuTime.load(std::memory_order_relaxed);
+    I2CBusLocker::setThreadStatistics(nullptr);
+
+    QMutexLocker locker(&m_schedulingMutex);
+    m_threadRunning = false;
+    m_threadId = 0;
+}
@@ -0,0 +1,233 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SENSORTHREAD_H
+#define SENSORTHREAD_H
+
+#include <atomic>
+#include <pthread.h>
+
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QWaitCondition>
+
+#include "i2cport.h"
+#include "sampleringbuffer.h"
+
+// Common base for the I2C sensor reading threads.
+//
+// Instead of msleep() the reading loops wait on a condition variable, so
+// disable() wakes every sensor thread immediately and the destructors
+// do not have to wait for the current sleep cycle to finish.
+//
+// Optionally the thread runs with SCHED_FIFO, a nice level and a CPU affinity.
+// If the scheduler can not be changed (e.g. missing CAP_SYS_NICE) the thread
+// falls back to the nice level and reports it in schedulingStatus().
+//
+// In duty cycle mode the thread takes samplesPerWindow() samples, puts the chip
+// into its low power state and sleeps until wakeUp() starts the next window.
+// A wakeUp() while a window is still running gets ignored.
+//
+// In capture mode every raw reading additionally goes into a second lock-free
+// queue, which gets drained by the CaptureWriter thread. The sensor thread
+// never touches the disk, if the writer falls behind samples get dropped.
+//
+// The runtime metrics are plain counters updated with relaxed atomics by the
+// sensor thread and read by the metrics exporter once per export interval.
+//
+// Every sensor keeps its raw samples in a lock-free ring buffer, read with
+// consumeSamples(). injectSample() is the producer side for runs without a
+// chip (e.g. simulations and benchmarks). The ring buffer has a single
+// producer, so only inject samples while the thread is not running.
+
+class SensorThread : public QThread
+{
+    Q_OBJECT
+public:
+    struct SchedulingConfiguration {
+        int realtimePriority = 0; // SCHED_FIFO priority 1 - 99, 0 = normal scheduling
+        int niceLevel = 0;
+        QList<int> cpuAffinity; // Empty = all CPUs
+    };
+
+    enum SchedulingStatus {
+        SchedulingStatusDefault,
+        SchedulingStatusRealtime,
+        SchedulingStatusNice,
+        SchedulingStatusFailed
+    };
+    Q_ENUM(SchedulingStatus)
+
+    struct WakeUpLatency {
+        quint64 count = 0;
+        double averageMicroSeconds = 0;
+        double maxMicroSeconds = 0;
+    };
+
+    struct Metrics {
+        quint64 samples = 0;
+        quint64 errors = 0;
+        quint64 recoveries = 0;
+        quint64 wakeUps = 0;
+        qint64 cpuTime = 0; // [ns]
+        quint64 i2cTransactions = 0;
+        quint64 i2cFailures = 0;
+        qint64 i2cDurationSum = 0; // [ns]
+        qint64 i2cDurationMax = 0; // [ns] since the last call of metrics()
+    };
+
+    // One raw reading for the capture, the meaning of the values depends on captureColumns()
+    struct CaptureSample {
+        qint64 timestamp = 0;
+        float values[4];
+    };
+
+    explicit SensorThread(const QString &sensorName, const QString &i2cPortName, int i2cAddress, QObject *parent = nullptr);
+
+    QString sensorName() const;
+    QString i2cPortName() const;
+    int i2cAddress() const;
+
+    // Chip behind a TCA9548A multiplexer, must be set before enable()
+    int muxAddress() const;
+    int muxChannel() const;
+    void setMultiplexer(int muxAddress, int muxChannel);
+
+    // Applied immediately if the thread is running, otherwise once it starts
+    void setSchedulingConfiguration(const SchedulingConfiguration &configuration);
+    SchedulingStatus schedulingStatus() const;
+
+    // Delay between the requested and the actual end of interruptibleSleep()
+    WakeUpLatency wakeUpLatency() const;
+    void resetWakeUpLatency();
+
+    static QList<int> parseCpuList(const QString &cpuList);
+
+    // Counters since the thread has been created, resets the maximum I2C transaction duration
+    Metrics metrics();
+
+    // Duty cycling between the publish windows
+    bool dutyCycleEnabled();
+    void setDutyCycleEnabled(bool enabled);
+
+    int samplesPerWindow();
+    void setSamplesPerWindow(int samplesPerWindow);
+
+    // Measured duration of one sample within a window [ms], 0 until measured
+    int cyclePeriod();
+
+    // Raw capture, at most 4 columns
+    virtual QStringList captureColumns() const;
+    bool captureEnabled() const;
+    void setCaptureEnabled(bool enabled);
+
+    template <typename Function>
+    int consumeCaptureSamples(Function function) { return m_captureSamples.consume(function); }
+    quint64 droppedCaptureSamples() const { return m_captureSamples.droppedCount(); }
+
+protected:
+    QString m_sensorName;
+    QString m_i2cPortName;
+    int m_i2cAddress;
+    int m_muxAddress = -1;
+    int m_muxChannel = 0;
+
+    // Returns false if the thread has been requested to stop
+    bool interruptibleSleep(unsigned long msecs);
+    bool isStopRequested();
+
+    // Call once per measurement cycle, sleeps for msecs or until the next
+    // duty cycle window. Returns false if the thread has been requested to stop.
+    bool waitForNextCycle(unsigned long msecs);
+
+    // Duty cycle hooks, called from within the thread
+    virtual void powerDown();
+    virtual bool powerUp();
+
+    // Metrics, call once per sample pushed, once per failed reading and once per chip re-initialization
+    void countSample();
+    void countError();
+    void countRecovery();
+
+    // Metrics of loops pacing themselves instead of using waitForNextCycle(),
+    // adds the wake ups since the last call and updates the thread CPU time
+    void countWakeUps(quint64 wakeUps);
+
+    // Producer side of the raw capture, does nothing unless capture is enabled
+    void captureSample(qint64 timestamp, float value0, float value1 = 0, float value2 = 0, float value3 = 0);
+
+private:
+    QMutex m_stopMutex;
+    QWaitCondition m_stopCondition;
+    bool m_stop = false;
+
+    // Duty cycle, guarded by the stop mutex
+    bool m_dutyCycleEnabled = false;
+    bool m_wakeUpRequested = false;
+    bool m_windowComplete = false;
+    int m_samplesPerWindow = 10;
+    int m_windowSamples = 0;
+    QElapsedTimer m_cycleTimer;
+    int m_cyclePeriod = 0;
+
+    // Scheduling, the thread handle is only valid while the thread is running
+    QMutex m_schedulingMutex;
+    SchedulingConfiguration m_schedulingConfiguration;
+    bool m_threadRunning = false;
+    pthread_t m_threadHandle;
+    pid_t m_threadId = 0;
+    std::atomic<int> m_schedulingStatus { SchedulingStatusDefault };
+
+    std::atomic<bool> m_captureEnabled { false };
+    SampleRingBuffer<CaptureSample, 1024> m_captureSamples;
+
+    // Metrics
+    std::atomic<quint64> m_sampleCount { 0 };
+    std::atomic<quint64> m_errorCount { 0 };
+    std::atomic<quint64> m_recoveryCount { 0 };
+    std::atomic<quint64> m_wakeUpTotal { 0 };
+    std::atomic<qint64> m_cpuTime { 0 };
+    qint64 m_cpuTimeBase = 0; // Only touched by the thread itself
+    I2CBusStatistics m_busStatistics;
+
+    std::atomic<quint64> m_wakeUpCount { 0 };
+    std::atomic<qint64> m_wakeUpLatencySum { 0 };
+    std::atomic<qint64> m_wakeUpLatencyMax { 0 };
+
+    void applySchedulingConfiguration();
+    void updateCpuTime();
+
+private slots:
+    void onThreadStarted();
+    void onThreadFinished();
+
+public slots:
+    bool enable();
+    void disable();
+    void wakeUp();
+
+};
+
+#endif // SENSORTHREAD_H
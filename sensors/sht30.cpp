@@ -22,7 +22,9 @@
 
 #include "sht30.h"
 #include "i2cport.h"
-#include "sensordatafilter.h"
+#include "chipdiscovery.h"
+#include "rawconversion.h"
+#include "sensorhealthcheck.h"
 #include "extern-plugininfo.h"
 
 #include <fcntl.h>
@@ -35,11 +37,10 @@
 #include <linux/i2c-dev.h>
 
 #include <QFile>
+#include <QDateTime>
 
 SHT30::SHT30(const QString &i2cPortName, int i2cAddress, QObject *parent) :
-    QThread(parent),
-    m_i2cPortName(i2cPortName),
-    m_i2cAddress(i2cAddress)
+    SensorThread("SHT30", i2cPortName, i2cAddress, parent)
 {
 
 }
@@ -50,16 +51,9 @@ SHT30::~SHT30()
     wait();
 }
 
-double SHT30::currentTemperatureValue()
+QStringList SHT30::captureColumns() const
 {
-    QMutexLocker valueLocker(&m_valueMutex);
-    return m_temperature;
-}
-
-double SHT30::currentHumidityValue()
-{
-    QMutexLocker valueLocker(&m_valueMutex);
-    return m_humidity;
+    return QStringList() << "temperature" << "humidity";
 }
 
 void SHT30::run()
@@ -79,89 +73,160 @@ void SHT30::run()
 
     int fileDescriptor = i2cFile.handle();
 
-    // Data filer for smoothing sensor values
-    SensorDataFilter temperatureFilter(SensorDataFilter::TypeLowPass);
-    temperatureFilter.setFilterWindowSize(10);
-    temperatureFilter.setLowPassAlpha(0.3);
-
-    SensorDataFilter humidityFilter(SensorDataFilter::TypeLowPass);
-    humidityFilter.setFilterWindowSize(10);
-    humidityFilter.setLowPassAlpha(0.3);
-
+    // Plausibility of the readings, a frozen chip returns the same frame forever (1 min at 2 Hz)
+    SensorHealthCheck temperatureCheck(-40, 125, 0);
+    SensorHealthCheck humidityCheck(0, 100, 0);
+    SensorHealthCheck frameCheck(0, 0xFFFFFFFF, 120);
 
     // Continuouse reading of the ADC values
     qCDebug(dcSensorStation()) << "SHT30: start reading value thread..." << this << "Process PID:" << syscall(SYS_gettid);
     while (true) {
-        if (ioctl(fileDescriptor, I2C_SLAVE, m_i2cAddress) < 0) {
+        bool addressed = false;
+        bool written = false;
+        {
+            // Note: do not hold the bus lock while waiting for the measurement
+            I2CBusLocker busLocker(m_i2cPortName, fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+            addressed = busLocker.isValid();
+            if (addressed) {
+                // Send measurement command: 0x2C
+                // High repeatability measurement: 0x06
+                char config[2] = {0};
+                config[0] = 0x2C;
+                config[1] = 0x06;
+                written = write(fileDescriptor, config, 2) == 2;
+            }
+        }
+
+        if (!addressed) {
             qCWarning(dcSensorStation()) << "SHT30: Could not set I2C into slave mode" << m_i2cPortName << QString("0x%1").arg(m_i2cAddress, 0, 16);
+            countError();
+            if (!interruptibleSleep(500))
+                break;
+
             continue;
         }
         //qCDebug(dcSensorStation()) << "SHT30: set I2C address" << QString("0x%1").arg(m_i2cAddress, 0, 16);
 
-        // Send measurement command: 0x2C
-        // High repeatability measurement: 0x06
-        char config[2] = {0};
-        config[0] = 0x2C;
-        config[1] = 0x06;
-        if (write(fileDescriptor, config, 2) != 2) {
+        if (!written) {
             qCWarning(dcSensorStation()) << "SHT30: could not configure sensor.";
-            msleep(500);
+            countError();
+            SensorHealthCheck::Fault fault = frameCheck.addFailure();
+            if (fault != SensorHealthCheck::FaultNone) {
+                recover(fileDescriptor, fault);
+                frameCheck.reset();
+            }
+
+            if (!interruptibleSleep(500))
+                break;
+
             continue;
         }
-        msleep(500);
+
+        // Wait for the measurement
+        if (!interruptibleSleep(500))
+            break;
 
         // Read 6 bytes of data
         // Temperature msb, Temperature lsb, Temperature CRC, Humididty msb, Humidity lsb, Humidity CRC
-        char data[6] = {0};
-        if (read(fileDescriptor, data, 6) != 6) {
-            qCWarning(dcSensorStation()) << "SHT30: could not read sensor values.";
-            msleep(500);
+        // Note: unsigned, otherwise bytes >= 0x80 get sign extended in the conversion
+        quint8 data[6] = {0};
+        bool dataRead = false;
+        {
+            I2CBusLocker busLocker(m_i2cPortName, fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+            dataRead = busLocker.isValid() && read(fileDescriptor, data, 6) == 6;
+        }
+
+        if (!dataRead || ChipDiscovery::crc8(data, 2) != data[2] || ChipDiscovery::crc8(data + 3, 2) != data[5]) {
+            if (dataRead) {
+                qCWarning(dcSensorStation()) << "SHT30: CRC mismatch in the measurement data.";
+            } else {
+                qCWarning(dcSensorStation()) << "SHT30: could not read sensor values.";
+            }
+            countError();
+
+            SensorHealthCheck::Fault fault = frameCheck.addFailure();
+            if (fault != SensorHealthCheck::FaultNone) {
+                recover(fileDescriptor, fault);
+                frameCheck.reset();
+            }
+
+            if (!interruptibleSleep(500))
+                break;
+
             continue;
         }
 
         // Convert the data
-        int temperatureRaw = (data[0] << 8) | data[1];
-        double temperature = -45 + (175 * temperatureRaw / 65535.0);
-        double humidity = 100 * ((data[3] << 8) | data[4]) / 65535.0;
-
-        QMutexLocker valueLocker(&m_valueMutex);
-        m_temperature = temperatureFilter.filterValue(temperature);
-        m_humidity = humidityFilter.filterValue(humidity);
-        //qCDebug(dcSensorStation()) << "Temperature" << m_temperature << "°C | humidity" << m_humidity << "%";
-
-        QMutexLocker stopLocker(&m_stopMutex);
-        if (m_stop) break;
-        msleep(500);
+        quint16 temperatureRaw = static_cast<quint16>((data[0] << 8) | data[1]);
+        quint16 humidityRaw = static_cast<quint16>((data[3] << 8) | data[4]);
+        double temperature = RawConversion::sht30Temperature(temperatureRaw);
+        double humidity = RawConversion::sht30Humidity(humidityRaw);
+
+        SensorHealthCheck::Fault fault = frameCheck.addValue((static_cast<quint32>(temperatureRaw) << 16) | humidityRaw);
+        if (fault == SensorHealthCheck::FaultNone)
+            fault = temperatureCheck.addValue(temperature);
+
+        if (fault == SensorHealthCheck::FaultNone)
+            fault = humidityCheck.addValue(humidity);
+
+        if (fault != SensorHealthCheck::FaultNone) {
+            recover(fileDescriptor, fault);
+            frameCheck.reset();
+            temperatureCheck.reset();
+            humidityCheck.reset();
+            if (!interruptibleSleep(500))
+                break;
+
+            continue;
+        }
+
+        if (!temperatureCheck.isValid() || !humidityCheck.isValid()) {
+            qCWarning(dcSensorStation()) << "SHT30: Dropping implausible values" << temperature << "°C" << humidity << "%";
+            countError();
+            if (!waitForNextCycle(500))
+                break;
+
+            continue;
+        }
+
+        Sample sample;
+        sample.timestamp = QDateTime::currentMSecsSinceEpoch();
+        sample.temperature = temperature;
+        sample.humidity = humidity;
+        m_samples.push(sample);
+        countSample();
+        captureSample(sample.timestamp, static_cast<float>(temperature), static_cast<float>(humidity));
+        //qCDebug(dcSensorStation()) << "Temperature" << sample.temperature << "°C | humidity" << sample.humidity << "%";
+
+        if (!waitForNextCycle(500))
+            break;
     }
 
     i2cFile.close();
     qCDebug(dcSensorStation()) << "SHT30: Reading thread finished.";
 }
 
-bool SHT30::enable()
+bool SHT30::recover(int fileDescriptor, SensorHealthCheck::Fault fault)
 {
-    // Check if this address can be opened
-    I2CPort port(m_i2cPortName);
-    if (!port.openPort(m_i2cAddress)) {
-        qCWarning(dcSensorStation()) << "SHT30 is not available on port" << port.portDeviceName() << QString("0x%1").arg(m_i2cAddress, 0, 16);;
-        return false;
+    qCWarning(dcSensorStation()) << "SHT30: Health check failed:" << SensorHealthCheck::faultToString(fault) << "Resetting the sensor.";
+    countRecovery();
+
+    bool written = false;
+    {
+        I2CBusLocker busLocker(m_i2cPortName, fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+        if (busLocker.isValid()) {
+            // Soft reset: 0x30A2
+            quint8 command[2] = {0x30, 0xA2};
+            written = write(fileDescriptor, command, 2) == 2;
+        }
     }
-    port.closePort();
-
-    // Start the reading thread
-    QMutexLocker locker(&m_stopMutex);
-    m_stop = false;
-    start();
-    return true;
-}
 
-void SHT30::disable()
-{
-    // Stop the thread if not already disabled
-    QMutexLocker locker(&m_stopMutex);
-    if (m_stop)
-        return;
+    if (!written) {
+        qCWarning(dcSensorStation()) << "SHT30: Could not reset the sensor.";
+        countError();
+        return false;
+    }
 
-    qCDebug(dcSensorStation()) << "SHT30: Disable measurements";
-    m_stop = true;
+    // The sensor is ready again after 1.5 ms
+    return interruptibleSleep(2);
 }
@@ -23,40 +23,44 @@
 #ifndef SHT30_H
 #define SHT30_H
 
-#include <QMutex>
 #include <QObject>
-#include <QThread>
-#include <QMutexLocker>
 
-class SHT30 : public QThread
+#include "sensorthread.h"
+#include "sensorhealthcheck.h"
+#include "sampleringbuffer.h"
+
+class SHT30 : public SensorThread
 {
     Q_OBJECT
 public:
+    struct Sample {
+        qint64 timestamp = 0;
+        double temperature = 0;
+        double humidity = 0;
+    };
+
     explicit SHT30(const QString &i2cPortName = "i2c-1", int i2cAddress = 0x44, QObject *parent = nullptr);
     ~SHT30() override;
 
-    double currentTemperatureValue();
-    double currentHumidityValue();
+    // Raw samples collected since the last call, consumer side of the ring buffer
+    template <typename Function>
+    int consumeSamples(Function function) { return m_samples.consume(function); }
+    quint64 droppedSamples() const { return m_samples.droppedCount(); }
+
+    bool injectSample(const Sample &sample) { return m_samples.push(sample); }
+
+    QStringList captureColumns() const override;
 
 protected:
     void run() override;
 
 private:
-    QString m_i2cPortName;
-    int m_i2cAddress;
     bool m_available = false;
 
-    // Thread stuff
-    QMutex m_stopMutex;
-    bool m_stop = false;
-
-    QMutex m_valueMutex;
-    double m_temperature;
-    double m_humidity;
+    SampleRingBuffer<Sample, 1024> m_samples;
 
-public slots:
-    bool enable();
-    void disable();
+    // Soft reset after a failed health check
+    bool recover(int fileDescriptor, SensorHealthCheck::Fault fault);
 
 };
 
@@ -22,7 +22,8 @@
 
 #include "tsl2561.h"
 #include "i2cport.h"
-#include "sensordatafilter.h"
+#include "rawconversion.h"
+#include "sensorhealthcheck.h"
 #include "extern-plugininfo.h"
 
 #include <math.h>
@@ -36,11 +37,10 @@
 #include <linux/i2c-dev.h>
 
 #include <QFile>
+#include <QDateTime>
 
 TSL2561::TSL2561(const QString &i2cPortName, int i2cAddress, QObject *parent) :
-    QThread(parent),
-    m_i2cPortName(i2cPortName),
-    m_i2cAddress(i2cAddress)
+    SensorThread("TSL2561", i2cPortName, i2cAddress, parent)
 {
 
 }
@@ -51,10 +51,9 @@ TSL2561::~TSL2561()
     wait();
 }
 
-double TSL2561::currentLux()
+QStringList TSL2561::captureColumns() const
 {
-    QMutexLocker valueLocker(&m_valueMutex);
-    return m_currentLux;
+    return QStringList() << "fullSpectrum" << "infrared" << "lux";
 }
 
 void TSL2561::run()
@@ -73,53 +72,121 @@ void TSL2561::run()
 
     m_fileDescriptor = i2cFile.handle();
 
-    // Power up sensor and configure timing (402ms)
-    if (!setPower(true) || !setTiming())
-        return;
-
-    // Data filer for smoothing sensor values
-    SensorDataFilter luxFilter(SensorDataFilter::TypeLowPass);
-    luxFilter.setFilterWindowSize(10);
-    luxFilter.setLowPassAlpha(0.3);
+    // The infrared part can never exceed the full spectrum. Constant values are normal
+    // in the dark or in saturation, so a stuck frame only triggers a power check (1 min at 2 Hz).
+    SensorHealthCheck visibleCheck(0, 65535, 0);
+    SensorHealthCheck frameCheck(0, 0xFFFFFFFF, 120);
+    bool initialized = false;
 
     // Continuouse reading of the ADC values
     qCDebug(dcSensorStation()) << "TSL2561: start reading value thread..." << this << "Process PID:" << syscall(SYS_gettid);
     while (true) {
-        if (ioctl(m_fileDescriptor, I2C_SLAVE, m_i2cAddress) < 0) {
-            qCWarning(dcSensorStation()) << "TSL2561: Could not set I2C into slave mode" << m_i2cPortName << QString("0x%1").arg(m_i2cAddress, 0, 16);
-            msleep(500);
-            continue;
-        }
+        if (!initialized) {
+            // Power up sensor and configure timing (402ms), retry until the chip answers
+            if (!setPower(true) || !setTiming()) {
+                if (!interruptibleSleep(500))
+                    break;
 
-        // Prepare reading
-        quint8 reg[1] = {0x8C};
-        if (write(m_fileDescriptor, reg, 1) != 1) {
-            qCWarning(dcSensorStation()) << "TSL2561: could configure sensor for reading.";
-            msleep(500);
-            continue;
+                continue;
+            }
+
+            initialized = true;
+            visibleCheck.reset();
+            frameCheck.reset();
+
+            // Wait for the first integration cycle to complete
+            if (!interruptibleSleep(450))
+                break;
         }
 
-        // Read data
+        bool addressed = false;
+        bool written = false;
+        bool dataRead = false;
         quint8 data[4] = {0};
-        if (read(m_fileDescriptor, data, 4) != 4) {
-            qCWarning(dcSensorStation()) << "TSL2561: could not configure sensor for reading.";
-            msleep(500);
+        {
+            I2CBusLocker busLocker(m_i2cPortName, m_fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+            addressed = busLocker.isValid();
+            if (addressed) {
+                // Prepare reading
+                quint8 reg[1] = {0x8C};
+                written = write(m_fileDescriptor, reg, 1) == 1;
+
+                // Read data
+                if (written) {
+                    dataRead = read(m_fileDescriptor, data, 4) == 4;
+                }
+            }
+        }
+
+        // Note: every failed transfer counts for the health check, a chip that vanished never gets addressed
+        if (!dataRead) {
+            if (!addressed) {
+                qCWarning(dcSensorStation()) << "TSL2561: Could not set I2C into slave mode" << m_i2cPortName << QString("0x%1").arg(m_i2cAddress, 0, 16);
+            } else if (!written) {
+                qCWarning(dcSensorStation()) << "TSL2561: could not configure sensor for reading.";
+            } else {
+                qCWarning(dcSensorStation()) << "TSL2561: could not read the sensor values.";
+            }
+
+            countError();
+            if (frameCheck.addFailure() != SensorHealthCheck::FaultNone) {
+                qCWarning(dcSensorStation()) << "TSL2561: Health check failed:" << SensorHealthCheck::faultToString(SensorHealthCheck::FaultCommunication) << "Initializing the sensor again.";
+                countRecovery();
+                initialized = false;
+            }
+
+            if (!interruptibleSleep(500))
+                break;
+
             continue;
         }
 
         // Note: convert to big endian
         quint16 channel0 = static_cast<quint16>((data[1] << 8) | data[0]);
         quint16 channel1 = static_cast<quint16>((data[3] << 8) | data[2]);
-        quint16 visibleLight = channel0 - channel1;
+
+        SensorHealthCheck::Fault fault = frameCheck.addValue((static_cast<quint32>(channel0) << 16) | channel1);
+        if (fault == SensorHealthCheck::FaultStuck && isPowered()) {
+            // Dark or saturated, the chip is fine. Check the power again after the next series.
+            fault = SensorHealthCheck::FaultNone;
+            frameCheck.reset();
+        }
+
+        if (fault == SensorHealthCheck::FaultNone)
+            fault = visibleCheck.addValue(RawConversion::tsl2561Visible(channel0, channel1));
+
+        if (fault != SensorHealthCheck::FaultNone) {
+            // Note: a power loss resets the chip into the power down state
+            qCWarning(dcSensorStation()) << "TSL2561: Health check failed:" << SensorHealthCheck::faultToString(fault) << "Initializing the sensor again.";
+            countRecovery();
+            initialized = false;
+            continue;
+        }
+
+        if (!visibleCheck.isValid()) {
+            qCWarning(dcSensorStation()) << "TSL2561: Dropping implausible values, infrared" << channel1 << "exceeds full spectrum" << channel0;
+            countError();
+            if (!waitForNextCycle(500))
+                break;
+
+            continue;
+        }
+
+        quint16 visibleLight = static_cast<quint16>(RawConversion::tsl2561Visible(channel0, channel1));
 
         // Set the visible light as current value
-        QMutexLocker valueLocker(&m_valueMutex);
-        m_currentLux = qRound(luxFilter.filterValue(static_cast<double>(visibleLight)));
-        //qCDebug(dcSensorStation()) << "Full spectrum:" << channel0 << "[lux] | Infrared:" << channel1 << "[lux] | Visible:" << m_currentLux << "[lux]";
+        Sample sample;
+        sample.timestamp = QDateTime::currentMSecsSinceEpoch();
+        sample.fullSpectrum = channel0;
+        sample.infrared = channel1;
+        sample.lux = visibleLight;
+        m_samples.push(sample);
+        countSample();
+        captureSample(sample.timestamp, channel0, channel1, visibleLight);
+        //qCDebug(dcSensorStation()) << "Full spectrum:" << channel0 << "[lux] | Infrared:" << channel1 << "[lux] | Visible:" << sample.lux << "[lux]";
 
-        QMutexLocker stopLocker(&m_stopMutex);
-        if (m_stop) break;
-        msleep(500);
+        if (!waitForNextCycle(500))
+            break;
     }
 
     setPower(false);
@@ -129,10 +196,27 @@ void TSL2561::run()
     qCDebug(dcSensorStation()) << "TSL2561: Reading thread finished.";
 }
 
+void TSL2561::powerDown()
+{
+    // Note: the TSL2561 keeps integrating while powered, switch it off between the windows
+    setPower(false);
+}
+
+bool TSL2561::powerUp()
+{
+    if (!setPower(true) || !setTiming())
+        return false;
+
+    // Wait for the first integration cycle (402 ms) to complete
+    return interruptibleSleep(450);
+}
+
 bool TSL2561::setPower(bool power)
 {
-    if (ioctl(m_fileDescriptor, I2C_SLAVE, m_i2cAddress) < 0) {
+    I2CBusLocker busLocker(m_i2cPortName, m_fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+    if (!busLocker.isValid()) {
         qCWarning(dcSensorStation()) << "TSL2561: Could not set I2C into slave mode" << m_i2cPortName << QString("0x%1").arg(m_i2cAddress, 0, 16);
+        countError();
         return false;
     }
 
@@ -142,15 +226,37 @@ bool TSL2561::setPower(bool power)
     config[1] = (power ? 0x03 : 0x00);
     if (write(m_fileDescriptor, config, 2) != 2) {
         qCWarning(dcSensorStation()) << "TSL2561: Could not power" << (power ? "on" : "off") << "sensor.";
+        countError();
         return false;
     }
     return true;
 }
 
+bool TSL2561::isPowered()
+{
+    I2CBusLocker busLocker(m_i2cPortName, m_fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+    if (!busLocker.isValid()) {
+        countError();
+        return false;
+    }
+
+    // Control register (0x80), the power bits read back 0x03 while powered
+    quint8 reg = 0x80;
+    quint8 control = 0;
+    if (write(m_fileDescriptor, &reg, 1) != 1 || read(m_fileDescriptor, &control, 1) != 1) {
+        countError();
+        return false;
+    }
+
+    return (control & 0x03) == 0x03;
+}
+
 bool TSL2561::setTiming()
 {
-    if (ioctl(m_fileDescriptor, I2C_SLAVE, m_i2cAddress) < 0) {
+    I2CBusLocker busLocker(m_i2cPortName, m_fileDescriptor, m_muxAddress, m_muxChannel, m_i2cAddress);
+    if (!busLocker.isValid()) {
         qCWarning(dcSensorStation()) << "TSL2561: Could not set I2C into slave mode" << m_i2cPortName << QString("0x%1").arg(m_i2cAddress, 0, 16);
+        countError();
         return false;
     }
 
@@ -160,35 +266,8 @@ bool TSL2561::setTiming()
     config[1] = 0x02;
     if (write(m_fileDescriptor, config, 2) != 2) {
         qCWarning(dcSensorStation()) << "TSL2561: Could not configure timings for sensor.";
+        countError();
         return false;
     }
     return true;
 }
-
-bool TSL2561::enable()
-{
-    // Check if this address can be opened
-    I2CPort port(m_i2cPortName);
-    if (!port.openPort(m_i2cAddress)) {
-        qCWarning(dcSensorStation()) << "TSL2561 is not available on port" << port.portDeviceName() << QString("0x%1").arg(m_i2cAddress, 0, 16);;
-        return false;
-    }
-    port.closePort();
-
-    // Start the reading thread
-    QMutexLocker locker(&m_stopMutex);
-    m_stop = false;
-    start();
-    return true;
-}
-
-void TSL2561::disable()
-{
-    // Stop the thread if not already disabled
-    QMutexLocker locker(&m_stopMutex);
-    if (m_stop)
-        return;
-
-    qCDebug(dcSensorStation()) << "TSL2561: Disable measurements";
-    m_stop = true;
-}
@@ -23,45 +23,51 @@
 #ifndef TSL2561_H
 #define TSL2561_H
 
-#include <QMutex>
 #include <QObject>
-#include <QThread>
-#include <QMutexLocker>
+
+#include "sensorthread.h"
+#include "sampleringbuffer.h"
 
 // Reference: https://github.com/ControlEverythingCommunity/TSL2561
 
-class TSL2561 : public QThread
+class TSL2561 : public SensorThread
 {
     Q_OBJECT
 public:
+    struct Sample {
+        qint64 timestamp = 0;
+        quint16 fullSpectrum = 0;
+        quint16 infrared = 0;
+        double lux = 0;
+    };
+
     explicit TSL2561(const QString &i2cPortName = "i2c-1", int i2cAddress = 0x39, QObject *parent = nullptr);
     ~TSL2561() override;
 
-    double currentLux();
+    // Raw samples collected since the last call, consumer side of the ring buffer
+    template <typename Function>
+    int consumeSamples(Function function) { return m_samples.consume(function); }
+    quint64 droppedSamples() const { return m_samples.droppedCount(); }
+
+    bool injectSample(const Sample &sample) { return m_samples.push(sample); }
+
+    QStringList captureColumns() const override;
 
 protected:
     void run() override;
+    void powerDown() override;
+    bool powerUp() override;
 
 private:
-    QString m_i2cPortName;
-    int m_i2cAddress;
     bool m_available = false;
     int m_fileDescriptor = -1;
 
-    // Thread stuff
-    QMutex m_stopMutex;
-    bool m_stop = false;
-
-    QMutex m_valueMutex;
-    double m_currentLux = 0;
+    SampleRingBuffer<Sample, 1024> m_samples;
 
     // Init methods
     bool setPower(bool power);
     bool setTiming();
-
-public slots:
-    bool enable();
-    void disable();
+    bool isPowered();
 
 };
 
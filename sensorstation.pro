@@ -2,7 +2,9 @@ include(/usr/include/nymea/plugin.pri)
 
 TARGET = $$qtLibraryTarget(nymea_devicepluginsensorstation)
 
-QT *= network
+QT *= network concurrent
+
+include(sensorlog/sensorlog.pri)
 
 message(============================================)
 message("Qt version: $$[QT_VERSION]")
@@ -18,7 +20,22 @@ HEADERS += \
     sensors/bmp180.h \
     sensors/sht30.h \
     sensors/tsl2561.h \
-    sensordatafilter.h
+    sensors/sensorthread.h \
+    sensors/sensorhealthcheck.h \
+    sensordatafilter.h \
+    filterconfiguration.h \
+    sampleringbuffer.h \
+    statepublisher.h \
+    chipdiscovery.h \
+    capturewriter.h \
+    gorillacompression.h \
+    historystore.h \
+    rollingmaximum.h \
+    metricsexporter.h \
+    derivedvalues.h \
+    pressuretendency.h \
+    rawconversion.h \
+    decimatingfilter.h
 
 SOURCES += \
     devicepluginsensorstation.cpp \
@@ -29,5 +46,19 @@ SOURCES += \
     sensors/bmp180.cpp \
     sensors/sht30.cpp \
     sensors/tsl2561.cpp \
-    sensordatafilter.cpp
+    sensors/sensorthread.cpp \
+    sensors/sensorhealthcheck.cpp \
+    sensordatafilter.cpp \
+    filterconfiguration.cpp \
+    statepublisher.cpp \
+    chipdiscovery.cpp \
+    capturewriter.cpp \
+    gorillacompression.cpp \
+    historystore.cpp \
+    rollingmaximum.cpp \
+    metricsexporter.cpp \
+    derivedvalues.cpp \
+    pressuretendency.cpp \
+    rawconversion.cpp \
+    decimatingfilter.cpp
 
@@ -0,0 +1,126 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "statepublisher.h"
+#include "sensordatafilter.h"
+#include "extern-plugininfo.h"
+
+#include <QtMath>
+
+StatePublisher::StatePublisher(Device *device, const StateTypeId &stateTypeId, const QList<SensorDataFilter *> &filters) :
+    m_device(device),
+    m_stateTypeId(stateTypeId),
+    m_filters(filters)
+{
+
+}
+
+double StatePublisher::deadband() const
+{
+    return m_deadband;
+}
+
+void StatePublisher::setDeadband(double deadband)
+{
+    m_deadband = qAbs(deadband);
+}
+
+double StatePublisher::rateThreshold() const
+{
+    return m_rateThreshold;
+}
+
+void StatePublisher::setRateThreshold(double rateThreshold)
+{
+    m_rateThreshold = qAbs(rateThreshold);
+}
+
+bool StatePublisher::isReady() const
+{
+    foreach (SensorDataFilter *filter, m_filters) {
+        if (!filter->isReady()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StatePublisher::isPublished() const
+{
+    return m_published;
+}
+
+double StatePublisher::lastPublishedValue() const
+{
+    return m_lastPublishedValue;
+}
+
+bool StatePublisher::update(double value, qint64 timestamp, bool periodic)
+{
+    // Note: the value of a filter without enough samples is not valid yet, it must not end up in the state
+    if (!isReady())
+        return false;
+
+    double roundedValue = roundValue(value);
+
+    // Rate of change since the previous update
+    bool rateExceeded = false;
+    if (m_hasPreviousValue && m_rateThreshold > 0 && timestamp > m_previousTimestamp) {
+        double minutes = (timestamp - m_previousTimestamp) / 60000.0;
+        rateExceeded = qAbs(value - m_previousValue) / minutes >= m_rateThreshold;
+    }
+
+    m_hasPreviousValue = true;
+    m_previousValue = value;
+    m_previousTimestamp = timestamp;
+
+    if (!m_published) {
+        publish(roundedValue);
+        return true;
+    }
+
+    double delta = qAbs(roundedValue - m_lastPublishedValue);
+    if (qFuzzyIsNull(delta) || delta < m_deadband)
+        return false;
+
+    if (!periodic && !rateExceeded)
+        return false;
+
+    if (rateExceeded) {
+        qCDebug(dcSensorStation()) << "Rate of change threshold exceeded for state" << m_stateTypeId.toString() << m_lastPublishedValue << "->" << roundedValue;
+    }
+
+    publish(roundedValue);
+    return true;
+}
+
+double StatePublisher::roundValue(double value)
+{
+    return qRound(value * 100) / 100.0;
+}
+
+void StatePublisher::publish(double value)
+{
+    m_published = true;
+    m_lastPublishedValue = value;
+    m_device->setStateValue(m_stateTypeId, value);
+}
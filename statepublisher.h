@@ -0,0 +1,79 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STATEPUBLISHER_H
+#define STATEPUBLISHER_H
+
+#include "plugin/device.h"
+
+class SensorDataFilter;
+
+// Decides when a filtered value gets written into a device state.
+//
+// Nothing gets published until all filters the value is calculated from have
+// enough samples, the state keeps its last value until then. On the periodic
+// publish the state only gets updated if the value moved more than the
+// deadband since the last published value. In between, a change faster than
+// the rate threshold gets published immediately.
+
+class StatePublisher
+{
+public:
+    StatePublisher(Device *device, const StateTypeId &stateTypeId, const QList<SensorDataFilter *> &filters);
+
+    double deadband() const;
+    void setDeadband(double deadband);
+
+    // Change per minute, 0 disables the rate of change trigger
+    double rateThreshold() const;
+    void setRateThreshold(double rateThreshold);
+
+    // All filters of the value are ready
+    bool isReady() const;
+
+    bool isPublished() const;
+    double lastPublishedValue() const;
+
+    // Returns true if the value has been written into the state
+    bool update(double value, qint64 timestamp, bool periodic);
+
+    static double roundValue(double value);
+
+private:
+    Device *m_device = nullptr;
+    StateTypeId m_stateTypeId;
+    QList<SensorDataFilter *> m_filters;
+
+    double m_deadband = 0;
+    double m_rateThreshold = 0;
+
+    bool m_published = false;
+    double m_lastPublishedValue = 0;
+
+    bool m_hasPreviousValue = false;
+    double m_previousValue = 0;
+    qint64 m_previousTimestamp = 0;
+
+    void publish(double value);
+};
+
+#endif // STATEPUBLISHER_H
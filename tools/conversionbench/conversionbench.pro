@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = conversionbench
+
+QT -= gui
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+HEADERS += \
+    ../../rawconversion.h
+
+SOURCES += \
+    main.cpp \
+    ../../rawconversion.cpp
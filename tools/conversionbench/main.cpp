@@ -0,0 +1,207 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QDebug>
+#include <QVector>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include <string.h>
+
+#include "rawconversion.h"
+
+// Benchmarks the batch conversion kernels of the raw sensor frames against
+// the scalar reference and verifies that both return bit identical results.
+
+class FrameGenerator
+{
+public:
+    explicit FrameGenerator(quint32 seed) : m_state(seed ? seed : 1) { }
+
+    quint16 code()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return static_cast<quint16>(m_state >> 8);
+    }
+
+private:
+    quint32 m_state;
+};
+
+static bool identical(const QVector<double> &values, const QVector<double> &expected, const char *name)
+{
+    // Note: compared bitwise, the kernels must not differ in the last bit
+    for (int i = 0; i < values.count(); i++) {
+        if (memcmp(&values.at(i), &expected.at(i), sizeof(double)) != 0) {
+            qWarning().nospace() << name << ": mismatch at index " << i << ": " << qPrintable(QString::number(values.at(i), 'g', 17)) << " != " << qPrintable(QString::number(expected.at(i), 'g', 17));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool validate()
+{
+    bool valid = true;
+
+    // SHT30 and ADS1115: every possible code, in an odd count so the scalar tail gets used as well
+    int count = 65536 + 3;
+    QVector<Sht30Frame> sht30Frames(count);
+    QVector<qint16> adsCodes(count);
+    for (int i = 0; i < count; i++) {
+        sht30Frames[i].temperature = static_cast<quint16>(i);
+        sht30Frames[i].humidity = static_cast<quint16>(65535 - i);
+        adsCodes[i] = static_cast<qint16>(i);
+    }
+
+    // The formulas as they were inlined in the sensor threads
+    QVector<double> temperatureExpected(count), humidityExpected(count), voltageExpected(count);
+    for (int i = 0; i < count; i++) {
+        int temperatureRaw = sht30Frames.at(i).temperature;
+        temperatureExpected[i] = -45 + (175 * temperatureRaw / 65535.0);
+        humidityExpected[i] = 100 * sht30Frames.at(i).humidity / 65535.0;
+        voltageExpected[i] = static_cast<double>(adsCodes.at(i)) * 4.096 / 32767.0;
+    }
+
+    QVector<double> temperature(count), humidity(count), voltage(count);
+    RawConversion::convertSht30Reference(sht30Frames.constData(), temperature.data(), humidity.data(), count);
+    valid &= identical(temperature, temperatureExpected, "SHT30 temperature reference");
+    valid &= identical(humidity, humidityExpected, "SHT30 humidity reference");
+
+    RawConversion::convertSht30(sht30Frames.constData(), temperature.data(), humidity.data(), count);
+    valid &= identical(temperature, temperatureExpected, "SHT30 temperature kernel");
+    valid &= identical(humidity, humidityExpected, "SHT30 humidity kernel");
+
+    RawConversion::convertAds1115Reference(adsCodes.constData(), voltage.data(), count);
+    valid &= identical(voltage, voltageExpected, "ADS1115 reference");
+
+    RawConversion::convertAds1115(adsCodes.constData(), voltage.data(), count);
+    valid &= identical(voltage, voltageExpected, "ADS1115 kernel");
+
+    // TSL2561: every full spectrum code against every 257th infrared code
+    QVector<Tsl2561Frame> tslFrames(count);
+    QVector<double> visibleExpected(count), visible(count), visibleReference(count);
+    for (int infrared = 0; infrared <= 65535 && valid; infrared += 257) {
+        for (int i = 0; i < count; i++) {
+            tslFrames[i].channel0 = static_cast<quint16>(i);
+            tslFrames[i].channel1 = static_cast<quint16>(infrared);
+            visibleExpected[i] = static_cast<int>(tslFrames.at(i).channel0) - static_cast<int>(tslFrames.at(i).channel1);
+        }
+
+        RawConversion::convertTsl2561Reference(tslFrames.constData(), visibleReference.data(), count);
+        valid &= identical(visibleReference, visibleExpected, "TSL2561 reference");
+
+        RawConversion::convertTsl2561(tslFrames.constData(), visible.data(), count);
+        valid &= identical(visible, visibleExpected, "TSL2561 kernel");
+    }
+
+    return valid;
+}
+
+template <typename Function>
+static double benchmark(int iterations, int frames, Function function)
+{
+    // Returns ns per frame, the best of 5 runs to filter out scheduling noise
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; i++)
+            function();
+
+        double nanoSeconds = static_cast<double>(timer.nsecsElapsed()) / iterations / frames;
+        if (run == 0 || nanoSeconds < best)
+            best = nanoSeconds;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("conversionbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark the batch conversion kernels of the raw SHT30, ADS1115 and TSL2561 frames.\n\n"
+                                     "Prints the time per frame of the vectorized kernel and of the scalar reference.");
+    parser.addHelpOption();
+    QCommandLineOption framesOption(QStringList() << "n" << "frames", "Frames per batch (default 4096).", "count", "4096");
+    parser.addOption(framesOption);
+    QCommandLineOption iterationsOption(QStringList() << "i" << "iterations", "Batches per run (default 2000).", "count", "2000");
+    parser.addOption(iterationsOption);
+    QCommandLineOption validateOption("validate", "Compare the kernels and the reference against the original formulas for every raw code and exit.");
+    parser.addOption(validateOption);
+    QCommandLineOption tsvOption("tsv", "Print one tab separated line (for CI).");
+    parser.addOption(tsvOption);
+    parser.process(application);
+
+    if (parser.isSet(validateOption)) {
+        bool valid = validate();
+        qInfo() << "Kernel" << RawConversion::kernelName() << (valid ? "matches" : "does not match") << "the reference";
+        return valid ? 0 : 1;
+    }
+
+    int frames = qMax(1, parser.value(framesOption).toInt());
+    int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+    FrameGenerator generator(42);
+    QVector<Sht30Frame> sht30Frames(frames);
+    QVector<qint16> adsCodes(frames);
+    QVector<Tsl2561Frame> tslFrames(frames);
+    for (int i = 0; i < frames; i++) {
+        sht30Frames[i].temperature = generator.code();
+        sht30Frames[i].humidity = generator.code();
+        adsCodes[i] = static_cast<qint16>(generator.code());
+        tslFrames[i].channel0 = generator.code();
+        tslFrames[i].channel1 = generator.code();
+    }
+
+    QVector<double> first(frames), second(frames);
+    double sht30Kernel = benchmark(iterations, frames, [&]() { RawConversion::convertSht30(sht30Frames.constData(), first.data(), second.data(), frames); });
+    double sht30Reference = benchmark(iterations, frames, [&]() { RawConversion::convertSht30Reference(sht30Frames.constData(), first.data(), second.data(), frames); });
+    double adsKernel = benchmark(iterations, frames, [&]() { RawConversion::convertAds1115(adsCodes.constData(), first.data(), frames); });
+    double adsReference = benchmark(iterations, frames, [&]() { RawConversion::convertAds1115Reference(adsCodes.constData(), first.data(), frames); });
+    double tslKernel = benchmark(iterations, frames, [&]() { RawConversion::convertTsl2561(tslFrames.constData(), first.data(), frames); });
+    double tslReference = benchmark(iterations, frames, [&]() { RawConversion::convertTsl2561Reference(tslFrames.constData(), first.data(), frames); });
+
+    QTextStream out(stdout);
+    if (parser.isSet(tsvOption)) {
+        out << "# kernel\tframes\tsht30\tsht30Reference\tads1115\tads1115Reference\ttsl2561\ttsl2561Reference\n";
+        out << RawConversion::kernelName() << '\t' << frames << '\t'
+            << sht30Kernel << '\t' << sht30Reference << '\t'
+            << adsKernel << '\t' << adsReference << '\t'
+            << tslKernel << '\t' << tslReference << '\n';
+    } else {
+        out << "Kernel:              " << RawConversion::kernelName() << '\n';
+        out << "Frames per batch:    " << frames << '\n';
+        out << "SHT30 [ns/frame]:    kernel " << sht30Kernel << " | reference " << sht30Reference << " | speedup " << sht30Reference / sht30Kernel << '\n';
+        out << "ADS1115 [ns/frame]:  kernel " << adsKernel << " | reference " << adsReference << " | speedup " << adsReference / adsKernel << '\n';
+        out << "TSL2561 [ns/frame]:  kernel " << tslKernel << " | reference " << tslReference << " | speedup " << tslReference / tslKernel << '\n';
+    }
+    out.flush();
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "busconnection.h"
+#include "chipdiscovery.h"
+
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include <QMutexLocker>
+
+HardwareConnection::HardwareConnection(const QString &portName, int muxAddress, int muxChannel, bool combined, bool lockDirect) :
+    m_port(portName),
+    m_muxAddress(muxAddress),
+    m_muxChannel(muxChannel),
+    m_combined(combined),
+    m_lockDirect(lockDirect)
+{
+
+}
+
+bool HardwareConnection::open()
+{
+    return m_port.openPort();
+}
+
+bool HardwareConnection::transfer(int address, const quint8 *command, int commandLength, quint8 *data, int dataLength)
+{
+    int fd = m_port.deviceDescriptor();
+
+    // Note: the locker only locks behind a multiplexer. On request the write and read on a
+    // direct bus get locked too, so no other worker moves the register pointer in between.
+    QMutex *mutex = (m_lockDirect && !m_combined && m_muxAddress < 0) ? I2CPort::busMutex(m_port.portName()) : nullptr;
+    if (mutex)
+        mutex->lock();
+
+    bool success = false;
+    {
+        I2CBusLocker busLocker(m_port.portName(), fd, m_muxAddress, m_muxChannel, address);
+        if (busLocker.isValid()) {
+            if (m_combined) {
+                struct i2c_msg messages[2];
+                messages[0].addr = static_cast<__u16>(address);
+                messages[0].flags = 0;
+                messages[0].len = static_cast<__u16>(commandLength);
+                messages[0].buf = const_cast<quint8 *>(command);
+                messages[1].addr = static_cast<__u16>(address);
+                messages[1].flags = I2C_M_RD;
+                messages[1].len = static_cast<__u16>(dataLength);
+                messages[1].buf = data;
+
+                struct i2c_rdwr_ioctl_data transfer;
+                transfer.msgs = messages;
+                transfer.nmsgs = 2;
+                success = ioctl(fd, I2C_RDWR, &transfer) == 2;
+            } else {
+                success = write(fd, command, static_cast<size_t>(commandLength)) == commandLength
+                        && read(fd, data, static_cast<size_t>(dataLength)) == dataLength;
+            }
+        }
+    }
+
+    if (mutex)
+        mutex->unlock();
+
+    return success;
+}
+
+QString HardwareConnection::errorString() const
+{
+    return QString("Could not open %1").arg(m_port.portDeviceName());
+}
+
+SimulatedBus::SimulatedBus(int clockFrequency, int overhead, double errorRate) :
+    m_clockFrequency(qMax(1000, clockFrequency)),
+    m_overhead(qMax(0, overhead)),
+    m_errorRate(errorRate)
+{
+
+}
+
+int SimulatedBus::clockFrequency() const
+{
+    return m_clockFrequency;
+}
+
+bool SimulatedBus::transfer(int address, const quint8 *command, int commandLength, quint8 *data, int dataLength, bool combined, quint32 random)
+{
+    // Address byte of both messages, 9 bit times per byte (ACK), start / repeated start / stop
+    int bytes = 2 + commandLength + dataLength;
+    int conditions = combined ? 3 : 4;
+    int transfers = combined ? 1 : 2;
+    qint64 duration = static_cast<qint64>(transfers) * m_overhead + (bytes * 9 + conditions) * 1000000000LL / m_clockFrequency;
+
+    QMutexLocker locker(&m_adapterMutex);
+
+    // Note: spinning, a sleep would add the timer slack to every transfer
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    qint64 end = static_cast<qint64>(time.tv_sec) * 1000000000 + time.tv_nsec + duration;
+    qint64 now = 0;
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        now = static_cast<qint64>(time.tv_sec) * 1000000000 + time.tv_nsec;
+    } while (now < end);
+
+    if (random < m_errorRate * 4294967296.0)
+        return false;
+
+    return respond(address, command, commandLength, data, dataLength);
+}
+
+bool SimulatedBus::respond(int address, const quint8 *command, int commandLength, quint8 *data, int dataLength)
+{
+    // The supported chips on their default addresses, register reads only
+    memset(data, 0, static_cast<size_t>(dataLength));
+    quint8 reg = commandLength > 0 ? command[0] : 0;
+    switch (address) {
+    case 0x44:
+        // SHT30 status register
+        if (commandLength == 2 && command[0] == 0xF3 && command[1] == 0x2D && dataLength >= 3) {
+            data[0] = 0x80;
+            data[1] = 0x10;
+            data[2] = ChipDiscovery::crc8(data, 2);
+        }
+        return true;
+    case 0x77:
+        // BMP180 chip id and calibration EEPROM
+        if (reg == 0xD0) {
+            data[0] = 0x55;
+        } else if (reg == 0xAA) {
+            for (int i = 0; i < dataLength; i++)
+                data[i] = static_cast<quint8>(0x5A + i * 7);
+        }
+        return true;
+    case 0x39:
+        // TSL2561 id register, TSL2561T revision 0
+        if (reg == 0x8A)
+            data[0] = 0x50;
+
+        return true;
+    case 0x48:
+        // ADS1115 conversion and threshold registers
+        if (reg == 0x00 && dataLength >= 2) {
+            m_conversion = static_cast<quint16>(0x4000 + (m_conversion * 75 + 74) % 257);
+            data[0] = static_cast<quint8>(m_conversion >> 8);
+            data[1] = static_cast<quint8>(m_conversion & 0xFF);
+        } else if (reg == 0x02 && dataLength >= 2) {
+            data[0] = 0x80;
+        } else if (reg == 0x03 && dataLength >= 2) {
+            data[0] = 0x7F;
+            data[1] = 0xFF;
+        }
+        return true;
+    default:
+        // Nobody acknowledges the address
+        return false;
+    }
+}
+
+SimulatedConnection::SimulatedConnection(SimulatedBus *bus, bool combined, quint32 seed) :
+    m_bus(bus),
+    m_combined(combined),
+    m_state(seed ? seed : 1)
+{
+
+}
+
+bool SimulatedConnection::open()
+{
+    return true;
+}
+
+bool SimulatedConnection::transfer(int address, const quint8 *command, int commandLength, quint8 *data, int dataLength)
+{
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return m_bus->transfer(address, command, commandLength, data, dataLength, m_combined, m_state);
+}
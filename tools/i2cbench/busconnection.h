@@ -0,0 +1,106 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BUSCONNECTION_H
+#define BUSCONNECTION_H
+
+#include <QMutex>
+#include <QString>
+
+#include "i2cport.h"
+
+// One benchmark worker's access to the bus.
+//
+// A transfer writes a command (register pointer) and reads the answer. By
+// default these are two separate transfers like in the sensor threads,
+// combined they become one I2C_RDWR with a repeated start.
+
+class BusConnection
+{
+public:
+    virtual ~BusConnection() { }
+
+    virtual bool open() = 0;
+    virtual bool transfer(int address, const quint8 *command, int commandLength, quint8 *data, int dataLength) = 0;
+
+    virtual QString errorString() const { return QString(); }
+};
+
+// Real chips, every worker gets its own file descriptor like a sensor thread.
+// Like the sensor threads it only takes the bus lock behind a multiplexer,
+// lockDirect also locks write and read on a direct bus.
+class HardwareConnection : public BusConnection
+{
+public:
+    HardwareConnection(const QString &portName, int muxAddress, int muxChannel, bool combined, bool lockDirect = false);
+
+    bool open() override;
+    bool transfer(int address, const quint8 *command, int commandLength, quint8 *data, int dataLength) override;
+    QString errorString() const override;
+
+private:
+    I2CPort m_port;
+    int m_muxAddress;
+    int m_muxChannel;
+    bool m_combined;
+    bool m_lockDirect;
+};
+
+// Timing model of one bus adapter with the supported chips attached.
+//
+// A transfer occupies the adapter for a fixed driver overhead plus 9 bit
+// times per byte and the start / stop conditions at the given clock. The
+// adapter serves one transfer at a time, like the kernel adapter lock.
+class SimulatedBus
+{
+public:
+    SimulatedBus(int clockFrequency, int overhead, double errorRate);
+
+    int clockFrequency() const;
+
+    bool transfer(int address, const quint8 *command, int commandLength, quint8 *data, int dataLength, bool combined, quint32 random);
+
+private:
+    QMutex m_adapterMutex;
+    int m_clockFrequency; // [Hz]
+    int m_overhead; // [ns] per transfer
+    double m_errorRate;
+    quint16 m_conversion = 0x4000;
+
+    bool respond(int address, const quint8 *command, int commandLength, quint8 *data, int dataLength);
+};
+
+class SimulatedConnection : public BusConnection
+{
+public:
+    SimulatedConnection(SimulatedBus *bus, bool combined, quint32 seed);
+
+    bool open() override;
+    bool transfer(int address, const quint8 *command, int commandLength, quint8 *data, int dataLength) override;
+
+private:
+    SimulatedBus *m_bus;
+    bool m_combined;
+    quint32 m_state;
+};
+
+#endif // BUSCONNECTION_H
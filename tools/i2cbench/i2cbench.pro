@@ -0,0 +1,21 @@
+TEMPLATE = app
+TARGET = i2cbench
+
+QT -= gui
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+# Note: the logging category and plugin info stubs of the measurebench
+INCLUDEPATH += ../measurebench/stubs ../..
+
+HEADERS += \
+    busconnection.h \
+    ../../chipdiscovery.h \
+    ../../i2cport.h \
+    ../../i2cport_p.h
+
+SOURCES += \
+    main.cpp \
+    busconnection.cpp \
+    ../../chipdiscovery.cpp \
+    ../../i2cport.cpp
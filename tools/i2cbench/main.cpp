@@ -0,0 +1,493 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QFile>
+#include <QDebug>
+#include <QThread>
+#include <QVector>
+#include <QSysInfo>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QRegularExpression>
+
+#include <atomic>
+#include <algorithm>
+
+#include "busconnection.h"
+#include "chipdiscovery.h"
+#include "extern-plugininfo.h"
+#include "loggingcategories.h"
+
+// Measures what one I2C bus sustains: N workers run a weighted mix of
+// register reads as fast as possible, each with its own connection like the
+// sensor threads. For every concurrency level it reports the transactions
+// per second, the error rate and the latency distribution.
+//
+// Only reads get sent to the chips, the transactions never change a register
+// besides the address pointer.
+
+Q_LOGGING_CATEGORY(dcSensorStation, "SensorStation", QtInfoMsg)
+Q_LOGGING_CATEGORY(dcHardware, "Hardware", QtInfoMsg)
+
+struct TransactionType {
+    const char *name;
+    int address; // Default address of the chip
+    quint8 command[2];
+    int commandLength;
+    int dataLength;
+    bool (*check)(const quint8 *data);
+};
+
+static bool checkSht30Status(const quint8 *data) { return ChipDiscovery::crc8(data, 2) == data[2]; }
+static bool checkBmp180Id(const quint8 *data) { return data[0] == 0x55; }
+static bool checkTsl2561Id(const quint8 *data) { return (data[0] >> 4) == 0x01 || (data[0] >> 4) == 0x05; }
+static bool checkAds1115Threshold(const quint8 *data) { return data[0] == 0x80 && data[1] == 0x00; }
+
+static const TransactionType s_transactionTypes[] = {
+    { "sht30-status", 0x44, { 0xF3, 0x2D }, 2, 3, checkSht30Status },
+    { "bmp180-id", 0x77, { 0xD0, 0x00 }, 1, 1, checkBmp180Id },
+    { "bmp180-calibration", 0x77, { 0xAA, 0x00 }, 1, 22, nullptr },
+    { "tsl2561-id", 0x39, { 0x8A, 0x00 }, 1, 1, checkTsl2561Id },
+    { "ads1115-conversion", 0x48, { 0x00, 0x00 }, 1, 2, nullptr },
+    { "ads1115-threshold", 0x48, { 0x02, 0x00 }, 1, 2, checkAds1115Threshold }
+};
+
+struct MixEntry {
+    const TransactionType *type = nullptr;
+    int address = 0;
+    int weight = 1;
+};
+
+struct EntryCounters {
+    quint64 transactions = 0;
+    quint64 errors = 0;
+};
+
+struct LevelResult {
+    int concurrency = 0;
+    double seconds = 0;
+    quint64 transactions = 0;
+    quint64 errors = 0;
+    QVector<qint64> latencies; // [ns], sorted
+    QVector<EntryCounters> entries;
+};
+
+static bool parseMix(const QString &mix, QList<MixEntry> *entries)
+{
+    // <transaction>[@<address>][=<weight>], comma separated
+    QRegularExpression expression("^([a-z0-9-]+)(?:@(0x[0-9a-fA-F]+|[0-9]+))?(?:=([0-9]+))?$");
+    foreach (const QString &item, mix.split(',', QString::SkipEmptyParts)) {
+        QRegularExpressionMatch match = expression.match(item.trimmed());
+        if (!match.hasMatch()) {
+            qWarning() << "Invalid transaction" << item;
+            return false;
+        }
+
+        MixEntry entry;
+        for (const TransactionType &type : s_transactionTypes) {
+            if (match.captured(1) == type.name)
+                entry.type = &type;
+        }
+
+        if (!entry.type) {
+            qWarning() << "Unknown transaction" << match.captured(1) << "(see --list)";
+            return false;
+        }
+
+        entry.address = entry.type->address;
+        if (!match.captured(2).isEmpty())
+            entry.address = match.captured(2).toInt(nullptr, 0);
+
+        if (!match.captured(3).isEmpty())
+            entry.weight = match.captured(3).toInt();
+
+        if (entry.address < 0x03 || entry.address > 0x77 || entry.weight <= 0) {
+            qWarning() << "Invalid address or weight" << item;
+            return false;
+        }
+
+        entries->append(entry);
+    }
+
+    return !entries->isEmpty();
+}
+
+class BenchWorker : public QThread
+{
+public:
+    BenchWorker(BusConnection *connection, const QList<MixEntry> &mix, quint32 seed, std::atomic<bool> *measuring, std::atomic<bool> *stop) :
+        m_connection(connection),
+        m_mix(mix),
+        m_state(seed ? seed : 1),
+        m_measuring(measuring),
+        m_stop(stop)
+    {
+        foreach (const MixEntry &entry, m_mix) {
+            m_weightSum += entry.weight;
+        }
+        m_latencies.reserve(65536);
+        m_entries.resize(m_mix.count());
+    }
+
+    const QVector<qint64> &latencies() const { return m_latencies; }
+    const QVector<EntryCounters> &entries() const { return m_entries; }
+
+protected:
+    void run() override
+    {
+        quint8 data[32];
+        QElapsedTimer timer;
+        while (!m_stop->load(std::memory_order_relaxed)) {
+            int index = pick();
+            const MixEntry &entry = m_mix.at(index);
+
+            timer.start();
+            bool success = m_connection->transfer(entry.address, entry.type->command, entry.type->commandLength, data, entry.type->dataLength);
+            qint64 latency = timer.nsecsElapsed();
+
+            // Note: a wrong answer counts as error, e.g. a register pointer moved by someone else
+            if (success && entry.type->check)
+                success = entry.type->check(data);
+
+            if (!m_measuring->load(std::memory_order_relaxed))
+                continue;
+
+            m_latencies.append(latency);
+            m_entries[index].transactions++;
+            if (!success)
+                m_entries[index].errors++;
+        }
+    }
+
+private:
+    BusConnection *m_connection;
+    QList<MixEntry> m_mix;
+    int m_weightSum = 0;
+    quint32 m_state;
+    std::atomic<bool> *m_measuring;
+    std::atomic<bool> *m_stop;
+
+    QVector<qint64> m_latencies;
+    QVector<EntryCounters> m_entries;
+
+    int pick()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        int value = static_cast<int>(m_state % static_cast<quint32>(m_weightSum));
+        for (int i = 0; i < m_mix.count(); i++) {
+            value -= m_mix.at(i).weight;
+            if (value < 0)
+                return i;
+        }
+        return m_mix.count() - 1;
+    }
+};
+
+static double percentile(const QVector<qint64> &sorted, double fraction)
+{
+    if (sorted.isEmpty())
+        return 0;
+
+    int index = qBound(0, static_cast<int>(fraction * (sorted.count() - 1) + 0.5), sorted.count() - 1);
+    return sorted.at(index) / 1000.0;
+}
+
+static double mean(const QVector<qint64> &values)
+{
+    if (values.isEmpty())
+        return 0;
+
+    double sum = 0;
+    foreach (qint64 value, values) {
+        sum += value;
+    }
+    return sum / values.count() / 1000.0;
+}
+
+static int busClockFrequency(const QString &portName)
+{
+    // Device tree property of the adapter (big endian u32), e.g. on the Raspberry Pi
+    QFile file(QString("/sys/class/i2c-adapter/%1/of_node/clock-frequency").arg(portName));
+    if (!file.open(QFile::ReadOnly))
+        return 0;
+
+    QByteArray data = file.readAll();
+    if (data.size() != 4)
+        return 0;
+
+    return (static_cast<quint8>(data.at(0)) << 24) | (static_cast<quint8>(data.at(1)) << 16) | (static_cast<quint8>(data.at(2)) << 8) | static_cast<quint8>(data.at(3));
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("i2cbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark the throughput and latency of an I2C bus.\n\n"
+                                     "For every concurrency level the workers run the transaction mix as fast as possible,\n"
+                                     "each worker with its own file descriptor. Latencies are in microseconds.");
+    parser.addHelpOption();
+    QCommandLineOption busOption(QStringList() << "b" << "bus", "I2C bus (default i2c-1).", "port", "i2c-1");
+    parser.addOption(busOption);
+    QCommandLineOption muxOption("mux", "Chips behind the TCA9548A multiplexer <address> on <channel>.", "address:channel");
+    parser.addOption(muxOption);
+    QCommandLineOption mixOption(QStringList() << "m" << "mix", "Transaction mix, comma separated <transaction>[@<address>][=<weight>] (default one of each chip ID read).", "mix", "sht30-status,bmp180-id,tsl2561-id,ads1115-threshold");
+    parser.addOption(mixOption);
+    QCommandLineOption concurrencyOption(QStringList() << "c" << "concurrency", "Comma separated numbers of workers (default 1,2,4,8).", "levels", "1,2,4,8");
+    parser.addOption(concurrencyOption);
+    QCommandLineOption durationOption(QStringList() << "d" << "duration", "Measured seconds per concurrency level (default 5).", "seconds", "5");
+    parser.addOption(durationOption);
+    QCommandLineOption warmupOption(QStringList() << "w" << "warmup", "Unmeasured milliseconds before each level (default 500).", "msecs", "500");
+    parser.addOption(warmupOption);
+    QCommandLineOption combinedOption("combined", "Write and read as one I2C_RDWR transfer with repeated start instead of two transfers like the sensor threads.");
+    parser.addOption(combinedOption);
+    QCommandLineOption lockOption("lock", "Also lock the bus between write and read on a bus without multiplexer. The sensor threads do not, without it workers reading the same chip can answer each other (counted as errors).");
+    parser.addOption(lockOption);
+    QCommandLineOption simulateOption("simulate", "Use the simulated bus with the chips on their default addresses instead of the hardware.");
+    parser.addOption(simulateOption);
+    QCommandLineOption clockOption("clock", "Clock of the simulated bus in Hz (default 100000).", "frequency", "100000");
+    parser.addOption(clockOption);
+    QCommandLineOption overheadOption("overhead", "Driver overhead of the simulated bus per transfer in microseconds (default 60).", "usecs", "60");
+    parser.addOption(overheadOption);
+    QCommandLineOption errorRateOption("error-rate", "Fraction of failing transactions on the simulated bus (default 0).", "fraction", "0");
+    parser.addOption(errorRateOption);
+    QCommandLineOption listOption("list", "List the available transactions and exit.");
+    parser.addOption(listOption);
+    QCommandLineOption tsvOption("tsv", "Print one tab separated line per concurrency level (for CI).");
+    parser.addOption(tsvOption);
+    QCommandLineOption jsonOption("json", "Print the results and the test setup as JSON.");
+    parser.addOption(jsonOption);
+    parser.process(application);
+
+    QTextStream out(stdout);
+    if (parser.isSet(listOption)) {
+        for (const TransactionType &type : s_transactionTypes) {
+            out << QString(type.name).leftJustified(20)
+                << QString("0x%1").arg(type.address, 2, 16, QChar('0')) << "  write " << type.commandLength << " | read " << type.dataLength
+                << (type.check ? " | verified" : "") << '\n';
+        }
+        return 0;
+    }
+
+    QList<MixEntry> mix;
+    if (!parseMix(parser.value(mixOption), &mix))
+        return 1;
+
+    QList<int> levels;
+    foreach (const QString &level, parser.value(concurrencyOption).split(',', QString::SkipEmptyParts)) {
+        if (level.toInt() <= 0) {
+            qWarning() << "Invalid concurrency level" << level;
+            return 1;
+        }
+        levels.append(level.toInt());
+    }
+
+    if (levels.isEmpty()) {
+        qWarning() << "No concurrency level given";
+        return 1;
+    }
+
+    int muxAddress = -1;
+    int muxChannel = 0;
+    if (parser.isSet(muxOption)) {
+        QStringList mux = parser.value(muxOption).split(':');
+        muxAddress = mux.first().toInt(nullptr, 0);
+        muxChannel = mux.count() > 1 ? mux.at(1).toInt() : -1;
+        if (mux.count() != 2 || muxAddress < 0x70 || muxAddress > 0x77 || muxChannel < 0 || muxChannel > 7) {
+            qWarning() << "Invalid multiplexer" << parser.value(muxOption);
+            return 1;
+        }
+    }
+
+    QString portName = parser.value(busOption);
+    bool simulate = parser.isSet(simulateOption);
+    bool combined = parser.isSet(combinedOption);
+    bool lockDirect = parser.isSet(lockOption);
+    double duration = qMax(0.1, parser.value(durationOption).toDouble());
+    int warmup = qMax(0, parser.value(warmupOption).toInt());
+
+    SimulatedBus simulatedBus(parser.value(clockOption).toInt(), parser.value(overheadOption).toInt() * 1000, parser.value(errorRateOption).toDouble());
+    int clockFrequency = simulate ? simulatedBus.clockFrequency() : busClockFrequency(portName);
+
+    QList<LevelResult> results;
+    foreach (int concurrency, levels) {
+        std::atomic<bool> measuring { false };
+        std::atomic<bool> stop { false };
+
+        QList<BusConnection *> connections;
+        QList<BenchWorker *> workers;
+        bool opened = true;
+        for (int i = 0; i < concurrency && opened; i++) {
+            BusConnection *connection = nullptr;
+            if (simulate) {
+                connection = new SimulatedConnection(&simulatedBus, combined, 0x9E3779B9u * (i + 1));
+            } else {
+                connection = new HardwareConnection(portName, muxAddress, muxChannel, combined, lockDirect);
+            }
+
+            connections.append(connection);
+            if (!connection->open()) {
+                qWarning() << qPrintable(connection->errorString());
+                opened = false;
+                break;
+            }
+
+            workers.append(new BenchWorker(connection, mix, 42 + i, &measuring, &stop));
+        }
+
+        if (!opened) {
+            qDeleteAll(workers);
+            qDeleteAll(connections);
+            return 1;
+        }
+
+        foreach (BenchWorker *worker, workers) {
+            worker->start();
+        }
+
+        QThread::msleep(static_cast<unsigned long>(warmup));
+        QElapsedTimer timer;
+        timer.start();
+        measuring.store(true);
+        QThread::msleep(static_cast<unsigned long>(duration * 1000));
+        stop.store(true);
+        double seconds = timer.nsecsElapsed() / 1e9;
+
+        LevelResult result;
+        result.concurrency = concurrency;
+        result.seconds = seconds;
+        result.entries.resize(mix.count());
+        foreach (BenchWorker *worker, workers) {
+            worker->wait();
+            result.latencies += worker->latencies();
+            for (int i = 0; i < mix.count(); i++) {
+                result.entries[i].transactions += worker->entries().at(i).transactions;
+                result.entries[i].errors += worker->entries().at(i).errors;
+                result.transactions += worker->entries().at(i).transactions;
+                result.errors += worker->entries().at(i).errors;
+            }
+        }
+        std::sort(result.latencies.begin(), result.latencies.end());
+        results.append(result);
+
+        qDeleteAll(workers);
+        qDeleteAll(connections);
+    }
+
+    QString backend = simulate ? "simulated" : "hardware";
+    QString mixString;
+    foreach (const MixEntry &entry, mix) {
+        mixString += QString("%1%2@0x%3=%4").arg(mixString.isEmpty() ? "" : ",").arg(entry.type->name).arg(entry.address, 2, 16, QChar('0')).arg(entry.weight);
+    }
+
+    if (parser.isSet(jsonOption)) {
+        QJsonObject root;
+        root.insert("backend", backend);
+        root.insert("bus", portName);
+        root.insert("muxAddress", muxAddress);
+        root.insert("muxChannel", muxChannel);
+        root.insert("clockFrequency", clockFrequency);
+        root.insert("combined", combined);
+        root.insert("lock", lockDirect);
+        root.insert("kernel", QSysInfo::kernelVersion());
+        root.insert("architecture", QSysInfo::currentCpuArchitecture());
+        root.insert("host", QSysInfo::machineHostName());
+        root.insert("duration", duration);
+        root.insert("mix", mixString);
+
+        QJsonArray levelArray;
+        foreach (const LevelResult &result, results) {
+            QJsonObject level;
+            level.insert("concurrency", result.concurrency);
+            level.insert("seconds", result.seconds);
+            level.insert("transactions", static_cast<double>(result.transactions));
+            level.insert("errors", static_cast<double>(result.errors));
+            level.insert("errorRate", result.transactions > 0 ? static_cast<double>(result.errors) / result.transactions : 0);
+            level.insert("transactionsPerSecond", result.transactions / result.seconds);
+
+            QJsonObject latency;
+            latency.insert("mean", mean(result.latencies));
+            latency.insert("p50", percentile(result.latencies, 0.5));
+            latency.insert("p90", percentile(result.latencies, 0.9));
+            latency.insert("p99", percentile(result.latencies, 0.99));
+            latency.insert("p999", percentile(result.latencies, 0.999));
+            latency.insert("max", result.latencies.isEmpty() ? 0 : result.latencies.last() / 1000.0);
+            level.insert("latency", latency);
+
+            QJsonArray entryArray;
+            for (int i = 0; i < mix.count(); i++) {
+                QJsonObject entry;
+                entry.insert("transaction", mix.at(i).type->name);
+                entry.insert("address", mix.at(i).address);
+                entry.insert("transactions", static_cast<double>(result.entries.at(i).transactions));
+                entry.insert("errors", static_cast<double>(result.entries.at(i).errors));
+                entryArray.append(entry);
+            }
+            level.insert("mix", entryArray);
+            levelArray.append(level);
+        }
+        root.insert("levels", levelArray);
+        out << QJsonDocument(root).toJson(QJsonDocument::Indented);
+    } else if (parser.isSet(tsvOption)) {
+        out << "# backend\tbus\tclock\tcombined\tconcurrency\ttransactions\terrors\terrorRate\ttps\tmean\tp50\tp90\tp99\tp999\tmax\n";
+        foreach (const LevelResult &result, results) {
+            out << backend << '\t' << portName << '\t' << clockFrequency << '\t' << (combined ? 1 : 0) << '\t'
+                << result.concurrency << '\t' << result.transactions << '\t' << result.errors << '\t'
+                << (result.transactions > 0 ? static_cast<double>(result.errors) / result.transactions : 0) << '\t'
+                << result.transactions / result.seconds << '\t' << mean(result.latencies) << '\t'
+                << percentile(result.latencies, 0.5) << '\t' << percentile(result.latencies, 0.9) << '\t'
+                << percentile(result.latencies, 0.99) << '\t' << percentile(result.latencies, 0.999) << '\t'
+                << (result.latencies.isEmpty() ? 0 : result.latencies.last() / 1000.0) << '\n';
+        }
+    } else {
+        out << "Backend:             " << backend << (combined ? " (combined transfers)" : "") << (lockDirect && !simulate ? " (locked transfers)" : "") << '\n';
+        out << "Bus:                 " << portName << " | clock " << (clockFrequency > 0 ? QString("%1 Hz").arg(clockFrequency) : QString("unknown")) << '\n';
+        out << "Kernel:              " << QSysInfo::kernelVersion() << " (" << QSysInfo::currentCpuArchitecture() << ")\n";
+        out << "Mix:                 " << mixString << '\n';
+        foreach (const LevelResult &result, results) {
+            out << '\n';
+            out << "Concurrency " << result.concurrency << ":       " << result.transactions / result.seconds << " transactions/s | errors " << result.errors
+                << " (" << (result.transactions > 0 ? 100.0 * result.errors / result.transactions : 0) << " %)\n";
+            out << "Latency [us]:        mean " << mean(result.latencies)
+                << " | p50 " << percentile(result.latencies, 0.5)
+                << " | p90 " << percentile(result.latencies, 0.9)
+                << " | p99 " << percentile(result.latencies, 0.99)
+                << " | p99.9 " << percentile(result.latencies, 0.999)
+                << " | max " << (result.latencies.isEmpty() ? 0 : result.latencies.last() / 1000.0) << '\n';
+            for (int i = 0; i < mix.count(); i++) {
+                out << "  " << QString(mix.at(i).type->name).leftJustified(20)
+                    << result.entries.at(i).transactions << " transactions | " << result.entries.at(i).errors << " errors\n";
+            }
+        }
+    }
+    out.flush();
+
+    return 0;
+}
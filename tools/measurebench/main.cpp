@@ -0,0 +1,242 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QDir>
+#include <QDebug>
+#include <QDateTime>
+#include <QVector>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include <algorithm>
+
+#include "allocationcounter.h"
+#include "airqualitymonitor.h"
+#include "extern-plugininfo.h"
+
+// Drives AirQualityMonitor::measure() of N simulated stations with injected
+// samples and reports the latency distribution and the heap allocations of
+// one publish cycle. No I2C bus or nymea is required.
+
+class SampleGenerator
+{
+public:
+    explicit SampleGenerator(quint32 seed) : m_state(seed ? seed : 1) { }
+
+    // Uniform noise in [-amplitude, amplitude], deterministic for a seed
+    double noise(double amplitude)
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return (static_cast<double>(m_state) / 0xFFFFFFFFu * 2.0 - 1.0) * amplitude;
+    }
+
+private:
+    quint32 m_state;
+};
+
+struct Station {
+    Device *device = nullptr;
+    AirQualityMonitor *monitor = nullptr;
+    SHT30 *temperatureHumiditySensor = nullptr;
+    BMP180 *pressureSensor = nullptr;
+    TSL2561 *lightSensor = nullptr;
+    ADS1115 *adc = nullptr;
+};
+
+static void injectSamples(const Station &station, SampleGenerator *generator, qint64 timestamp, int count)
+{
+    // Note: one publish interval of samples, oldest first
+    for (int i = 0; i < count; i++) {
+        qint64 sampleTimestamp = timestamp - (count - i) * 1000;
+
+        SHT30::Sample temperatureHumidity;
+        temperatureHumidity.timestamp = sampleTimestamp;
+        temperatureHumidity.temperature = 22.0 + generator->noise(0.5);
+        temperatureHumidity.humidity = 45.0 + generator->noise(2.0);
+        station.temperatureHumiditySensor->injectSample(temperatureHumidity);
+
+        BMP180::Sample pressure;
+        pressure.timestamp = sampleTimestamp;
+        pressure.pressure = 1013.25 + generator->noise(0.3);
+        pressure.altitude = 0;
+        station.pressureSensor->injectSample(pressure);
+
+        TSL2561::Sample light;
+        light.timestamp = sampleTimestamp;
+        light.fullSpectrum = static_cast<quint16>(400 + generator->noise(20));
+        light.infrared = static_cast<quint16>(100 + generator->noise(5));
+        light.lux = light.fullSpectrum - light.infrared;
+        station.lightSensor->injectSample(light);
+
+        ADS1115::Sample adc;
+        adc.timestamp = sampleTimestamp;
+        adc.channelValues[ADS1115::Channel1] = static_cast<int>(8000 + generator->noise(200));
+        station.adc->injectSample(adc);
+    }
+}
+
+static double percentile(const QVector<qint64> &sorted, double fraction)
+{
+    if (sorted.isEmpty())
+        return 0;
+
+    int index = qBound(0, static_cast<int>(fraction * (sorted.count() - 1) + 0.5), sorted.count() - 1);
+    return sorted.at(index) / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("measurebench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark one publish cycle (AirQualityMonitor::measure()) of N simulated sensor stations.\n\n"
+                                     "Before each cycle every sensor of every station gets <samples> injected samples,\n"
+                                     "only the measure() calls are timed. Latencies are in microseconds.");
+    parser.addHelpOption();
+    QCommandLineOption stationsOption(QStringList() << "n" << "stations", "Number of simulated stations (default 1).", "count", "1");
+    parser.addOption(stationsOption);
+    QCommandLineOption iterationsOption(QStringList() << "i" << "iterations", "Measured publish cycles per station (default 1000).", "count", "1000");
+    parser.addOption(iterationsOption);
+    QCommandLineOption warmupOption(QStringList() << "w" << "warmup", "Unmeasured publish cycles per station before the measurement (default 20).", "count", "20");
+    parser.addOption(warmupOption);
+    QCommandLineOption samplesOption(QStringList() << "s" << "samples", "Samples per sensor and cycle, at most 1024 (default 300, one 300 s interval at 1 Hz).", "count", "300");
+    parser.addOption(samplesOption);
+    QCommandLineOption logOption(QStringList() << "l" << "log", "Enable the sensor data log of the monitors.");
+    parser.addOption(logOption);
+    QCommandLineOption historyOption("history", "Store the history in <directory>.", "directory");
+    parser.addOption(historyOption);
+    QCommandLineOption tsvOption("tsv", "Print one tab separated line (for CI).");
+    parser.addOption(tsvOption);
+    parser.process(application);
+
+    int stationCount = qMax(1, parser.value(stationsOption).toInt());
+    int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    int warmup = qMax(0, parser.value(warmupOption).toInt());
+    int samples = qBound(1, parser.value(samplesOption).toInt(), 1024);
+
+    // Set up the stations, the sensor threads never get started
+    QList<Station> stations;
+    for (int i = 0; i < stationCount; i++) {
+        Station station;
+        station.device = new Device(QUuid::createUuid(), QString("Station %1").arg(i + 1));
+        station.device->setParamValue(sensorStationBusParamTypeId, "i2c-1");
+        station.device->setParamValue(sensorStationMuxAddressParamTypeId, 0);
+        station.device->setParamValue(sensorStationMuxChannelParamTypeId, 0);
+        station.device->setParamValue(sensorStationSht30AddressParamTypeId, 0x44);
+        station.device->setParamValue(sensorStationBmp180AddressParamTypeId, 0x77);
+        station.device->setParamValue(sensorStationTsl2561AddressParamTypeId, 0x39);
+        station.device->setParamValue(sensorStationAds1115AddressParamTypeId, 0x48);
+
+        station.monitor = new AirQualityMonitor(station.device, ChipDiscovery::ChipAll);
+        station.monitor->setSensorLogEnabled(parser.isSet(logOption));
+        if (parser.isSet(historyOption))
+            station.monitor->setHistoryDirectory(QDir(parser.value(historyOption)).filePath(QString("station-%1").arg(i + 1)));
+
+        foreach (SensorThread *sensor, station.monitor->sensors()) {
+            if (qobject_cast<SHT30 *>(sensor))
+                station.temperatureHumiditySensor = qobject_cast<SHT30 *>(sensor);
+            else if (qobject_cast<BMP180 *>(sensor))
+                station.pressureSensor = qobject_cast<BMP180 *>(sensor);
+            else if (qobject_cast<TSL2561 *>(sensor))
+                station.lightSensor = qobject_cast<TSL2561 *>(sensor);
+            else if (qobject_cast<ADS1115 *>(sensor))
+                station.adc = qobject_cast<ADS1115 *>(sensor);
+        }
+
+        stations.append(station);
+    }
+
+    SampleGenerator generator(42);
+    qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+
+    QVector<qint64> latencies;
+    latencies.reserve(stationCount * iterations);
+    quint64 allocations = 0;
+    quint64 allocatedBytes = 0;
+    quint64 maximumAllocations = 0;
+
+    QElapsedTimer timer;
+    qint64 totalTime = 0;
+    for (int iteration = 0; iteration < warmup + iterations; iteration++) {
+        timestamp += samples * 1000;
+        foreach (const Station &station, stations) {
+            injectSamples(station, &generator, timestamp, samples);
+        }
+
+        bool measured = iteration >= warmup;
+        foreach (const Station &station, stations) {
+            if (measured)
+                AllocationCounter::start();
+
+            timer.start();
+            station.monitor->measure();
+            qint64 latency = timer.nsecsElapsed();
+            AllocationCounter::Counters counters = AllocationCounter::stop();
+
+            if (measured) {
+                latencies.append(latency);
+                totalTime += latency;
+                allocations += counters.allocations;
+                allocatedBytes += counters.bytes;
+                maximumAllocations = qMax(maximumAllocations, counters.allocations);
+            }
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    double calls = latencies.count();
+
+    QTextStream out(stdout);
+    if (parser.isSet(tsvOption)) {
+        out << "# stations\tsamples\tcalls\tmean\tp50\tp90\tp99\tp999\tmax\tallocations\tbytes\n";
+        out << stationCount << '\t' << samples << '\t' << latencies.count() << '\t'
+            << totalTime / calls / 1000.0 << '\t' << percentile(latencies, 0.5) << '\t' << percentile(latencies, 0.9) << '\t'
+            << percentile(latencies, 0.99) << '\t' << percentile(latencies, 0.999) << '\t' << latencies.last() / 1000.0 << '\t'
+            << allocations / calls << '\t' << allocatedBytes / calls << '\n';
+    } else {
+        out << "Stations:            " << stationCount << '\n';
+        out << "Samples per sensor:  " << samples << " per cycle\n";
+        out << "measure() calls:     " << latencies.count() << '\n';
+        out << "Latency [us]:        mean " << totalTime / calls / 1000.0
+            << " | p50 " << percentile(latencies, 0.5)
+            << " | p90 " << percentile(latencies, 0.9)
+            << " | p99 " << percentile(latencies, 0.99)
+            << " | p99.9 " << percentile(latencies, 0.999)
+            << " | max " << latencies.last() / 1000.0 << '\n';
+        out << "Allocations:         " << allocations / calls << " per call (max " << maximumAllocations << ") | "
+            << allocatedBytes / calls << " bytes per call\n";
+        out << "Per sample [ns]:     " << totalTime / calls / (samples * 4.0) << '\n';
+    }
+    out.flush();
+
+    foreach (const Station &station, stations) {
+        delete station.monitor;
+        delete station.device;
+    }
+
+    return 0;
+}
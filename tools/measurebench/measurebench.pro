@@ -0,0 +1,66 @@
+TEMPLATE = app
+TARGET = measurebench
+
+QT += concurrent
+QT -= gui
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+include(../../sensorlog/sensorlog.pri)
+
+# Note: the stubs replace the nymea headers, the plugin sources get built unchanged
+INCLUDEPATH += stubs ../..
+
+HEADERS += \
+    stubs/plugin/device.h \
+    stubs/extern-plugininfo.h \
+    stubs/loggingcategories.h \
+    allocationcounter.h \
+    ../../airqualitymonitor.h \
+    ../../capturewriter.h \
+    ../../chipdiscovery.h \
+    ../../decimatingfilter.h \
+    ../../derivedvalues.h \
+    ../../filterconfiguration.h \
+    ../../gorillacompression.h \
+    ../../historystore.h \
+    ../../i2cport.h \
+    ../../i2cport_p.h \
+    ../../pressuretendency.h \
+    ../../rawconversion.h \
+    ../../rollingmaximum.h \
+    ../../sensordatafilter.h \
+    ../../statepublisher.h \
+    ../../sensors/ads1115.h \
+    ../../sensors/bmp180.h \
+    ../../sensors/mq135.h \
+    ../../sensors/sensorhealthcheck.h \
+    ../../sensors/sensorthread.h \
+    ../../sensors/sht30.h \
+    ../../sensors/tsl2561.h
+
+SOURCES += \
+    main.cpp \
+    allocationcounter.cpp \
+    stubs/stubs.cpp \
+    ../../airqualitymonitor.cpp \
+    ../../capturewriter.cpp \
+    ../../chipdiscovery.cpp \
+    ../../decimatingfilter.cpp \
+    ../../derivedvalues.cpp \
+    ../../filterconfiguration.cpp \
+    ../../gorillacompression.cpp \
+    ../../historystore.cpp \
+    ../../i2cport.cpp \
+    ../../pressuretendency.cpp \
+    ../../rawconversion.cpp \
+    ../../rollingmaximum.cpp \
+    ../../sensordatafilter.cpp \
+    ../../statepublisher.cpp \
+    ../../sensors/ads1115.cpp \
+    ../../sensors/bmp180.cpp \
+    ../../sensors/mq135.cpp \
+    ../../sensors/sensorhealthcheck.cpp \
+    ../../sensors/sensorthread.cpp \
+    ../../sensors/sht30.cpp \
+    ../../sensors/tsl2561.cpp
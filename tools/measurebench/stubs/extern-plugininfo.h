@@ -0,0 +1,58 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef EXTERNPLUGININFO_H
+#define EXTERNPLUGININFO_H
+
+#include <QLoggingCategory>
+
+#include "plugin/device.h"
+
+// Stand in for the header generated from devicepluginsensorstation.json
+
+Q_DECLARE_LOGGING_CATEGORY(dcSensorStation)
+
+extern ParamTypeId sensorStationBusParamTypeId;
+extern ParamTypeId sensorStationMuxAddressParamTypeId;
+extern ParamTypeId sensorStationMuxChannelParamTypeId;
+extern ParamTypeId sensorStationSht30AddressParamTypeId;
+extern ParamTypeId sensorStationBmp180AddressParamTypeId;
+extern ParamTypeId sensorStationTsl2561AddressParamTypeId;
+extern ParamTypeId sensorStationAds1115AddressParamTypeId;
+
+extern StateTypeId sensorStationConnectedStateTypeId;
+extern StateTypeId sensorStationSht30AvailableStateTypeId;
+extern StateTypeId sensorStationBmp180AvailableStateTypeId;
+extern StateTypeId sensorStationTsl2561AvailableStateTypeId;
+extern StateTypeId sensorStationAds1115AvailableStateTypeId;
+extern StateTypeId sensorStationCo2StateTypeId;
+extern StateTypeId sensorStationTemperatureStateTypeId;
+extern StateTypeId sensorStationHumidityStateTypeId;
+extern StateTypeId sensorStationPressureStateTypeId;
+extern StateTypeId sensorStationLightIntensityStateTypeId;
+extern StateTypeId sensorStationDewPointStateTypeId;
+extern StateTypeId sensorStationAbsoluteHumidityStateTypeId;
+extern StateTypeId sensorStationHeatIndexStateTypeId;
+extern StateTypeId sensorStationSeaLevelPressureStateTypeId;
+extern StateTypeId sensorStationPressureTendencyStateTypeId;
+
+#endif // EXTERNPLUGININFO_H
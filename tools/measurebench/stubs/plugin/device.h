@@ -0,0 +1,78 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <QHash>
+#include <QUuid>
+#include <QObject>
+#include <QVariant>
+
+// Minimal stand in for the nymea Device, only the API used by the AirQualityMonitor
+
+class DeviceId : public QUuid
+{
+public:
+    DeviceId(const QUuid &uuid = QUuid()) : QUuid(uuid) { }
+};
+
+class StateTypeId : public QUuid
+{
+public:
+    StateTypeId(const QUuid &uuid = QUuid()) : QUuid(uuid) { }
+    StateTypeId(const char *uuid) : QUuid(uuid) { }
+};
+
+class ParamTypeId : public QUuid
+{
+public:
+    ParamTypeId(const QUuid &uuid = QUuid()) : QUuid(uuid) { }
+    ParamTypeId(const char *uuid) : QUuid(uuid) { }
+};
+
+class Device : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Device(const DeviceId &id, const QString &name, QObject *parent = nullptr);
+
+    DeviceId id() const;
+    QString name() const;
+
+    QVariant paramValue(const ParamTypeId &paramTypeId) const;
+    void setParamValue(const ParamTypeId &paramTypeId, const QVariant &value);
+
+    QVariant stateValue(const StateTypeId &stateTypeId) const;
+    void setStateValue(const StateTypeId &stateTypeId, const QVariant &value);
+
+signals:
+    void stateValueChanged(const StateTypeId &stateTypeId, const QVariant &value);
+
+private:
+    DeviceId m_id;
+    QString m_name;
+    QHash<ParamTypeId, QVariant> m_params;
+    QHash<StateTypeId, QVariant> m_states;
+};
+
+#endif // DEVICE_H
@@ -0,0 +1,98 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "plugin/device.h"
+#include "extern-plugininfo.h"
+#include "loggingcategories.h"
+
+// Note: same ids as in devicepluginsensorstation.json
+ParamTypeId sensorStationBusParamTypeId("{ab669dcc-008e-4bd5-a552-95a60792fb9c}");
+ParamTypeId sensorStationMuxAddressParamTypeId("{70fdd6b8-96b2-430c-b8c8-b0a495ed724d}");
+ParamTypeId sensorStationMuxChannelParamTypeId("{9509e731-4fd0-48e7-addd-e4eabe62b71f}");
+ParamTypeId sensorStationSht30AddressParamTypeId("{2d969621-61dc-4996-8391-a2c5805a21c0}");
+ParamTypeId sensorStationBmp180AddressParamTypeId("{7fd10c46-3836-43f4-a261-2ff3e6606168}");
+ParamTypeId sensorStationTsl2561AddressParamTypeId("{9c5dbb10-d01d-4480-a5f8-7dcb4c1183a3}");
+ParamTypeId sensorStationAds1115AddressParamTypeId("{b94b1c8f-2549-427a-baa3-9b3dedc32b0d}");
+
+StateTypeId sensorStationConnectedStateTypeId("{00069d99-99e0-4bd4-9435-138ca8cb4fa6}");
+StateTypeId sensorStationSht30AvailableStateTypeId("{ff52eb55-b37f-4cd8-b983-05af9b5be5c9}");
+StateTypeId sensorStationBmp180AvailableStateTypeId("{25aaed0a-2ca0-4b36-a8fd-ca0e48582b43}");
+StateTypeId sensorStationTsl2561AvailableStateTypeId("{45d40f99-fa26-420f-b14a-4d017b908108}");
+StateTypeId sensorStationAds1115AvailableStateTypeId("{71b1cb5f-8b2e-4385-8916-42e6af7ff31a}");
+StateTypeId sensorStationCo2StateTypeId("{c8403b02-6e3c-4881-b0e5-2fbc86ca6990}");
+StateTypeId sensorStationTemperatureStateTypeId("{fca3f10b-e6ab-4c11-8c7a-fdfe92d00b8f}");
+StateTypeId sensorStationHumidityStateTypeId("{b0cd0e7a-a015-49fb-a8a4-0674be28ae93}");
+StateTypeId sensorStationPressureStateTypeId("{5fce7e33-5402-422a-8277-cb43ce491ce5}");
+StateTypeId sensorStationLightIntensityStateTypeId("{309b49d9-e79b-4b8b-ad14-3c29fdba73ee}");
+StateTypeId sensorStationDewPointStateTypeId("{a3b1afa0-e2b8-465e-ae27-8027d9e86a35}");
+StateTypeId sensorStationAbsoluteHumidityStateTypeId("{f190d363-3ee5-452b-906b-27d26e454b06}");
+StateTypeId sensorStationHeatIndexStateTypeId("{d43792ff-8357-44a5-882b-c908b61a1ad3}");
+StateTypeId sensorStationSeaLevelPressureStateTypeId("{98de32da-bf78-4699-ad8e-d5cb5fbab34a}");
+StateTypeId sensorStationPressureTendencyStateTypeId("{8f2b3f97-03bd-43f6-8679-db793b343d3c}");
+
+// Note: like in nymead, debug output is disabled unless enabled by the logging rules
+Q_LOGGING_CATEGORY(dcSensorStation, "SensorStation", QtInfoMsg)
+Q_LOGGING_CATEGORY(dcHardware, "Hardware", QtInfoMsg)
+
+Device::Device(const DeviceId &id, const QString &name, QObject *parent) :
+    QObject(parent),
+    m_id(id),
+    m_name(name)
+{
+
+}
+
+DeviceId Device::id() const
+{
+    return m_id;
+}
+
+QString Device::name() const
+{
+    return m_name;
+}
+
+QVariant Device::paramValue(const ParamTypeId &paramTypeId) const
+{
+    return m_params.value(paramTypeId);
+}
+
+void Device::setParamValue(const ParamTypeId &paramTypeId, const QVariant &value)
+{
+    m_params.insert(paramTypeId, value);
+}
+
+QVariant Device::stateValue(const StateTypeId &stateTypeId) const
+{
+    return m_states.value(stateTypeId);
+}
+
+void Device::setStateValue(const StateTypeId &stateTypeId, const QVariant &value)
+{
+    // Same as nymea: only a changed value emits the signal
+    QHash<StateTypeId, QVariant>::iterator state = m_states.find(stateTypeId);
+    if (state != m_states.end() && state.value() == value)
+        return;
+
+    m_states.insert(stateTypeId, value);
+    emit stateValueChanged(stateTypeId, value);
+}
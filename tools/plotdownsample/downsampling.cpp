@@ -0,0 +1,122 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "downsampling.h"
+
+#include <math.h>
+
+QVector<int> Downsampling::largestTriangleThreeBuckets(const QVector<double> &x, const QVector<double> &y, int threshold)
+{
+    QVector<int> indices;
+    int count = x.count();
+    if (threshold >= count || threshold < 3) {
+        indices.reserve(count);
+        for (int i = 0; i < count; i++) {
+            indices.append(i);
+        }
+        return indices;
+    }
+
+    indices.reserve(threshold);
+
+    // The first and the last point are always kept, the others get split into threshold - 2 buckets
+    double bucketSize = static_cast<double>(count - 2) / (threshold - 2);
+    int selected = 0;
+    indices.append(selected);
+
+    for (int bucket = 0; bucket < threshold - 2; bucket++) {
+        // Average of the next bucket is the third point of the triangle
+        int nextStart = static_cast<int>(floor((bucket + 1) * bucketSize)) + 1;
+        int nextEnd = qMin(static_cast<int>(floor((bucket + 2) * bucketSize)) + 1, count);
+        double averageX = 0;
+        double averageY = 0;
+        for (int i = nextStart; i < nextEnd; i++) {
+            averageX += x.at(i);
+            averageY += y.at(i);
+        }
+        int nextCount = qMax(1, nextEnd - nextStart);
+        averageX /= nextCount;
+        averageY /= nextCount;
+
+        // Point of the current bucket with the largest triangle
+        int start = static_cast<int>(floor(bucket * bucketSize)) + 1;
+        int end = static_cast<int>(floor((bucket + 1) * bucketSize)) + 1;
+        double selectedX = x.at(selected);
+        double selectedY = y.at(selected);
+        double maximumArea = -1;
+        int maximumIndex = start;
+        for (int i = start; i < end; i++) {
+            double area = fabs((selectedX - averageX) * (y.at(i) - selectedY) - (selectedX - x.at(i)) * (averageY - selectedY));
+            if (area > maximumArea) {
+                maximumArea = area;
+                maximumIndex = i;
+            }
+        }
+
+        selected = maximumIndex;
+        indices.append(selected);
+    }
+
+    indices.append(count - 1);
+    return indices;
+}
+
+QVector<int> Downsampling::minMaxEnvelope(const QVector<double> &y, int threshold)
+{
+    QVector<int> indices;
+    int count = y.count();
+    int buckets = threshold / 2;
+    if (threshold >= count || buckets < 1) {
+        indices.reserve(count);
+        for (int i = 0; i < count; i++) {
+            indices.append(i);
+        }
+        return indices;
+    }
+
+    indices.reserve(buckets * 2);
+    double bucketSize = static_cast<double>(count) / buckets;
+    for (int bucket = 0; bucket < buckets; bucket++) {
+        int start = static_cast<int>(floor(bucket * bucketSize));
+        int end = qMin(static_cast<int>(floor((bucket + 1) * bucketSize)), count);
+        if (start >= end)
+            continue;
+
+        int minimumIndex = start;
+        int maximumIndex = start;
+        for (int i = start + 1; i < end; i++) {
+            if (y.at(i) < y.at(minimumIndex))
+                minimumIndex = i;
+
+            if (y.at(i) > y.at(maximumIndex))
+                maximumIndex = i;
+        }
+
+        // Keep the time order within the bucket
+        indices.append(qMin(minimumIndex, maximumIndex));
+        if (minimumIndex != maximumIndex) {
+            indices.append(qMax(minimumIndex, maximumIndex));
+        }
+    }
+
+    return indices;
+}
@@ -0,0 +1,40 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef DOWNSAMPLING_H
+#define DOWNSAMPLING_H
+
+#include <QVector>
+
+// Point reduction for plotting, both methods return the indices of the kept points.
+//
+// Largest-Triangle-Three-Buckets (Steinarsson 2013) keeps the visual shape of a line,
+// the min/max envelope keeps every spike, which matters for the scattered raw values.
+
+namespace Downsampling {
+
+QVector<int> largestTriangleThreeBuckets(const QVector<double> &x, const QVector<double> &y, int threshold);
+QVector<int> minMaxEnvelope(const QVector<double> &y, int threshold);
+
+}
+
+#endif // DOWNSAMPLING_H
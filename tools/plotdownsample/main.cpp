@@ -0,0 +1,171 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QFile>
+#include <QDebug>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include "downsampling.h"
+#include "sensorlogreader.h"
+#include "sensorlogcolumns.h"
+
+// Reads a sensor log once and writes one small data file per plot:
+// <plot>.dat with the reduced raw values (index 0) and filtered values (index 1).
+
+struct Plot {
+    QString name;
+    int rawColumn;
+    int filteredColumn;
+};
+
+static QList<Plot> plots()
+{
+    // One plot per channel, columns of the sensor log without the timestamp
+    QList<Plot> plotList;
+    QStringList channels = sensorLogChannels();
+    for (int i = 0; i < channels.count(); i++) {
+        plotList << Plot { channels.at(i), i * 2, i * 2 + 1 };
+    }
+    return plotList;
+}
+
+static bool loadLog(const QString &fileName, QVector<double> *timestamps, QVector<QVector<double> > *columns, QString *errorString)
+{
+    if (SensorLogReader::isSensorLog(fileName)) {
+        SensorLogReader reader(fileName);
+        if (!reader.open()) {
+            *errorString = reader.errorString();
+            return false;
+        }
+
+        QVector<int> indices;
+        foreach (const QString &name, sensorLogColumns()) {
+            indices.append(reader.columnIndex(name));
+            if (indices.last() < 0) {
+                *errorString = QString("Missing column %1").arg(name);
+                return false;
+            }
+        }
+
+        for (qint64 i = 0; i < reader.recordCount(); i++) {
+            timestamps->append(reader.timestamp(i) / 1000);
+            const float *values = reader.values(i);
+            for (int column = 0; column < indices.count(); column++) {
+                (*columns)[column].append(static_cast<double>(values[indices.at(column)]));
+            }
+        }
+        return true;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        *errorString = file.errorString();
+        return false;
+    }
+
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        QList<QByteArray> tokens = line.simplified().split(' ');
+        if (tokens.count() < columns->count() + 1)
+            continue;
+
+        timestamps->append(tokens.at(0).toDouble());
+        for (int column = 0; column < columns->count(); column++) {
+            (*columns)[column].append(tokens.at(column + 1).toDouble());
+        }
+    }
+    return true;
+}
+
+static void writeBlock(QTextStream &stream, const QVector<double> &timestamps, const QVector<double> &values, const QVector<int> &indices)
+{
+    foreach (int index, indices) {
+        stream << qint64(timestamps.at(index)) << ' ' << values.at(index) << '\n';
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("plotdownsample");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Reduce a sensor log to a fixed number of points per plot for the gnuplot scripts.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("logfiles", "Text or binary sensor logs, oldest first.", "<logfile> [<logfile> ...]");
+    QCommandLineOption pointsOption(QStringList() << "n" << "points", "Maximum number of points per series (default 2000).", "count", "2000");
+    parser.addOption(pointsOption);
+    QCommandLineOption methodOption(QStringList() << "m" << "method", "Reduction of the raw values: envelope (default) or lttb. The filtered values always use lttb.", "method", "envelope");
+    parser.addOption(methodOption);
+    QCommandLineOption directoryOption(QStringList() << "d" << "directory", "Write the data files into <directory>.", "directory", ".");
+    parser.addOption(directoryOption);
+    parser.process(application);
+
+    if (parser.positionalArguments().isEmpty())
+        parser.showHelp(1);
+
+    int points = parser.value(pointsOption).toInt();
+    QString method = parser.value(methodOption);
+    if (points < 3 || (method != "envelope" && method != "lttb")) {
+        qWarning() << "Invalid number of points or method";
+        return 1;
+    }
+
+    QVector<double> timestamps;
+    QVector<QVector<double> > columns(sensorLogColumns().count());
+    foreach (const QString &fileName, parser.positionalArguments()) {
+        QString errorString;
+        if (!loadLog(fileName, &timestamps, &columns, &errorString)) {
+            qWarning() << "Could not load" << fileName << errorString;
+            return 1;
+        }
+    }
+
+    foreach (const Plot &plot, plots()) {
+        QFile file(QString("%1/%2.dat").arg(parser.value(directoryOption)).arg(plot.name));
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            qWarning() << "Could not open" << file.fileName() << file.errorString();
+            return 1;
+        }
+
+        const QVector<double> &raw = columns.at(plot.rawColumn);
+        const QVector<double> &filtered = columns.at(plot.filteredColumn);
+        QVector<int> rawIndices = method == "lttb" ? Downsampling::largestTriangleThreeBuckets(timestamps, raw, points)
+                                                   : Downsampling::minMaxEnvelope(raw, points);
+        QVector<int> filteredIndices = Downsampling::largestTriangleThreeBuckets(timestamps, filtered, points);
+
+        // Two data sets separated by two blank lines, selected with "index" in gnuplot
+        QTextStream stream(&file);
+        stream << "# " << plot.name << " raw\n";
+        writeBlock(stream, timestamps, raw, rawIndices);
+        stream << "\n\n# " << plot.name << " filtered\n";
+        writeBlock(stream, timestamps, filtered, filteredIndices);
+    }
+
+    qInfo().nospace() << "Reduced " << timestamps.count() << " rows to at most " << points << " points per series";
+    return 0;
+}
@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = plotdownsample
+
+QT -= gui
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+include(../../sensorlog/sensorlog.pri)
+
+HEADERS += \
+    downsampling.h
+
+SOURCES += \
+    main.cpp \
+    downsampling.cpp
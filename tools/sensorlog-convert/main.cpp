@@ -0,0 +1,113 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QFile>
+#include <QDebug>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include "sensorlogreader.h"
+#include "sensorlogcolumns.h"
+
+// Converts binary sensor logs into the whitespace separated text format used by the gnuplot scripts:
+// <timestamp [s]> <column 1> ... <column n>
+// Logs of AirQualityMonitor get written in the order of sensorLogColumns(), the plot scripts
+// and tools rely on it. Other logs keep the order of the file.
+
+static QStringList outputColumns(const QStringList &columns)
+{
+    foreach (const QString &column, sensorLogColumns()) {
+        if (!columns.contains(column))
+            return columns;
+    }
+    return sensorLogColumns();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("sensorlog-convert");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Convert binary sensor station logs into the gnuplot text format. "
+                                     "Pass rotated files from the oldest to the newest one.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("logfiles", "The binary log files to convert.", "<logfile> [<logfile> ...]");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write into <file> instead of stdout.", "file");
+    parser.addOption(outputOption);
+    QCommandLineOption millisecondsOption(QStringList() << "m" << "milliseconds", "Write the timestamps in milliseconds.");
+    parser.addOption(millisecondsOption);
+    parser.process(application);
+
+    if (parser.positionalArguments().isEmpty())
+        parser.showHelp(1);
+
+    QFile output;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QFile::WriteOnly | QFile::Truncate)) {
+            qWarning() << "Could not open" << output.fileName() << output.errorString();
+            return 1;
+        }
+    } else {
+        output.open(stdout, QFile::WriteOnly);
+    }
+
+    QTextStream stream(&output);
+    bool milliseconds = parser.isSet(millisecondsOption);
+    QStringList columns;
+    QVector<int> indices;
+
+    foreach (const QString &fileName, parser.positionalArguments()) {
+        SensorLogReader reader(fileName);
+        if (!reader.open()) {
+            qWarning() << "Could not open" << fileName << reader.errorString();
+            return 1;
+        }
+
+        if (columns.isEmpty()) {
+            columns = reader.columns();
+            stream << "# timestamp " << outputColumns(columns).join(' ') << '\n';
+        } else if (columns != reader.columns()) {
+            qWarning() << "The columns of" << fileName << "do not match the previous files";
+            return 1;
+        }
+
+        indices.clear();
+        foreach (const QString &column, outputColumns(columns)) {
+            indices.append(reader.columnIndex(column));
+        }
+
+        for (qint64 i = 0; i < reader.recordCount(); i++) {
+            stream << (milliseconds ? reader.timestamp(i) : reader.timestamp(i) / 1000) << ' ';
+            const float *values = reader.values(i);
+            foreach (int column, indices) {
+                stream << values[column] << ' ';
+            }
+            stream << '\n';
+        }
+    }
+
+    stream.flush();
+    return 0;
+}
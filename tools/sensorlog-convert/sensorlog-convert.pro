@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = sensorlog-convert
+
+QT -= gui
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+include(../../sensorlog/sensorlog.pri)
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,196 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QFile>
+#include <QDebug>
+#include <QThreadPool>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "replaydata.h"
+#include "replayrunner.h"
+#include "filterconfiguration.h"
+#include "sensors/mq135.h"
+
+// Replays recorded sensor data through the filter chain of the plugin and
+// prints tracking error, noise reduction and lag of each configuration.
+
+struct Job {
+    ReplayRunner::Configuration configuration;
+    ReplayRunner::Result result;
+};
+
+static bool writeSeries(const QString &prefix, const ReplayData &data, const ReplayRunner::Result &result)
+{
+    foreach (const QString &channel, result.filtered.keys()) {
+        QFile file(QString("%1-%2.dat").arg(prefix).arg(channel));
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            qWarning() << "Could not open" << file.fileName() << file.errorString();
+            return false;
+        }
+
+        // Same layout as the gnuplot log: <timestamp [s]> <raw> <filtered>
+        QTextStream stream(&file);
+        const ReplayData::Series &series = data.series(channel);
+        QVector<double> filtered = result.filtered.value(channel);
+        for (int i = 0; i < series.values.count(); i++) {
+            stream << series.timestamps.at(i) / 1000 << ' ' << series.values.at(i) << ' ' << filtered.at(i) << '\n';
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("sensorreplay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replay recorded sensor station data through the filter chain and MQ-135 conversion of the plugin.\n\n"
+                                     "A configuration is a list of <channel>=<type>:<window>[:<alpha>] entries, e.g.\n"
+                                     "  \"temperature=average:30 pressure=lowpass:20:0.1\"\n"
+                                     "Channels: temperature, humidity, pressure, lux, ppm. Types: average, lowpass, highpass.\n"
+                                     "Channels not listed keep the filters of the plugin.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("logfiles", "Text logs, binary sensor logs or raw capture logs, oldest first.", "<logfile> [<logfile> ...]");
+    QCommandLineOption configOption(QStringList() << "c" << "config", "Evaluate the configuration <spec>, can be given multiple times.", "spec");
+    parser.addOption(configOption);
+    QCommandLineOption configFileOption(QStringList() << "f" << "config-file", "Evaluate every configuration listed in <file>, one per line.", "file");
+    parser.addOption(configFileOption);
+    QCommandLineOption seriesOption(QStringList() << "s" << "series", "Write the filtered series of the first configuration into <prefix>-<channel>.dat.", "prefix");
+    parser.addOption(seriesOption);
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Number of configurations evaluated in parallel.", "count");
+    parser.addOption(jobsOption);
+    QCommandLineOption rateOption("air-quality-rate", QString("MQ-135 samples per second of the recording, sets the window of the CO2 average (default %1, 10 with airQualityStreaming).").arg(FilterConfiguration::singleShotSampleRate), "rate");
+    parser.addOption(rateOption);
+    QCommandLineOption rZeroOption("rzero", "RZero of the MQ-135 conversion in Ohm, e.g. the baseline learned by the station (default: the fixed RZero of the plugin).", "ohm");
+    parser.addOption(rZeroOption);
+    QCommandLineOption validateOption("validate-mq135", "Compare the table based MQ-135 conversion against the pow() reference and exit.");
+    parser.addOption(validateOption);
+    parser.process(application);
+
+    if (parser.isSet(validateOption)) {
+        double maximumError = MQ135::validate();
+        qInfo() << "MQ-135 maximum relative error against pow():" << maximumError;
+        return maximumError < 1e-6 ? 0 : 1;
+    }
+
+    if (parser.positionalArguments().isEmpty())
+        parser.showHelp(1);
+
+    // Load the recordings
+    QElapsedTimer timer;
+    timer.start();
+    ReplayData data;
+    if (parser.isSet(rZeroOption))
+        data.setRZero(parser.value(rZeroOption).toDouble());
+
+    foreach (const QString &fileName, parser.positionalArguments()) {
+        if (!data.load(fileName)) {
+            qWarning() << qPrintable(data.errorString());
+            return 1;
+        }
+    }
+    data.finish();
+    qint64 loadTime = timer.restart();
+
+    // Collect the configurations
+    QStringList specifications = parser.values(configOption);
+    if (parser.isSet(configFileOption)) {
+        QFile file(parser.value(configFileOption));
+        if (!file.open(QFile::ReadOnly)) {
+            qWarning() << "Could not open" << file.fileName() << file.errorString();
+            return 1;
+        }
+
+        while (!file.atEnd()) {
+            QString line = QString::fromUtf8(file.readLine()).trimmed();
+            if (!line.isEmpty() && !line.startsWith('#')) {
+                specifications.append(line);
+            }
+        }
+    }
+
+    int airQualitySampleRate = FilterConfiguration::singleShotSampleRate;
+    if (parser.isSet(rateOption))
+        airQualitySampleRate = qMax(1, parser.value(rateOption).toInt());
+
+    QList<ReplayRunner::Configuration> configurations;
+    if (specifications.isEmpty())
+        configurations.append(ReplayRunner::defaultConfiguration(airQualitySampleRate));
+
+    foreach (const QString &specification, specifications) {
+        ReplayRunner::Configuration configuration;
+        QString errorString;
+        if (!ReplayRunner::parseConfiguration(specification, airQualitySampleRate, &configuration, &errorString)) {
+            qWarning() << qPrintable(errorString);
+            return 1;
+        }
+        configurations.append(configuration);
+    }
+
+    if (parser.isSet(jobsOption))
+        QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(jobsOption).toInt()));
+
+    // Evaluate, the configurations are independent of each other
+    bool writeFilteredSeries = parser.isSet(seriesOption);
+    QVector<Job> jobs;
+    foreach (const ReplayRunner::Configuration &configuration, configurations) {
+        Job job;
+        job.configuration = configuration;
+        jobs.append(job);
+    }
+
+    QtConcurrent::blockingMap(jobs, [&data](Job &job) {
+        job.result = ReplayRunner::run(data, job.configuration, false);
+    });
+
+    if (writeFilteredSeries) {
+        ReplayRunner::Result result = ReplayRunner::run(data, configurations.first(), true);
+        if (!writeSeries(parser.value(seriesOption), data, result)) {
+            return 1;
+        }
+    }
+
+    QTextStream out(stdout);
+    out << "# configuration\tchannel\tsamples\trmse\tnoiseReduction\tlagSamples\tlagSeconds\trecordedRmse\n";
+    foreach (const Job &job, jobs) {
+        const ReplayRunner::Result &result = job.result;
+        foreach (const QString &channel, ReplayData::channels()) {
+            if (!result.metrics.contains(channel))
+                continue;
+
+            ReplayRunner::Metrics metrics = result.metrics.value(channel);
+            out << job.configuration.name << '\t' << channel << '\t' << metrics.samples << '\t'
+                << metrics.rmse << '\t' << metrics.noiseReduction << '\t'
+                << metrics.lagSamples << '\t' << metrics.lagSeconds << '\t' << metrics.recordedRmse << '\n';
+        }
+    }
+    out.flush();
+
+    qInfo().nospace() << "Loaded in " << loadTime << " ms, evaluated " << configurations.count() << " configurations in " << timer.elapsed() << " ms";
+    return 0;
+}
@@ -0,0 +1,231 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "replaydata.h"
+#include "rawconversion.h"
+#include "sensorlogreader.h"
+#include "sensorlogcolumns.h"
+#include "sensors/mq135.h"
+
+#include <QFile>
+
+QStringList ReplayData::channels()
+{
+    return sensorLogChannels();
+}
+
+bool ReplayData::load(const QString &fileName)
+{
+    if (SensorLogReader::isSensorLog(fileName))
+        return loadBinary(fileName);
+
+    return loadText(fileName);
+}
+
+void ReplayData::setRZero(double rZero)
+{
+    m_rZero = rZero;
+}
+
+void ReplayData::finish()
+{
+    convertAdcValues();
+
+    // Remove channels without data
+    foreach (const QString &channel, m_series.keys()) {
+        if (m_series.value(channel).values.isEmpty()) {
+            m_series.remove(channel);
+        }
+    }
+}
+
+QString ReplayData::errorString() const
+{
+    return m_errorString;
+}
+
+bool ReplayData::contains(const QString &channel) const
+{
+    return m_series.contains(channel);
+}
+
+const ReplayData::Series &ReplayData::series(const QString &channel) const
+{
+    static const Series empty;
+    QHash<QString, Series>::const_iterator it = m_series.constFind(channel);
+    return it == m_series.constEnd() ? empty : it.value();
+}
+
+bool ReplayData::loadText(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        m_errorString = QString("Could not open %1: %2").arg(fileName).arg(file.errorString());
+        return false;
+    }
+
+    // <timestamp [s]> followed by raw and filtered value of each channel
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        lineNumber++;
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        QList<QByteArray> tokens = line.simplified().split(' ');
+        if (tokens.count() < 11) {
+            m_errorString = QString("%1:%2: expected 11 columns").arg(fileName).arg(lineNumber);
+            return false;
+        }
+
+        double values[10];
+        for (int i = 0; i < 10; i++) {
+            values[i] = tokens.at(i + 1).toDouble();
+        }
+        appendMonitorRow(tokens.at(0).toLongLong() * 1000, values);
+    }
+
+    return true;
+}
+
+bool ReplayData::loadBinary(const QString &fileName)
+{
+    SensorLogReader reader(fileName);
+    if (!reader.open()) {
+        m_errorString = QString("Could not open %1: %2").arg(fileName).arg(reader.errorString());
+        return false;
+    }
+
+    QStringList columns = reader.columns();
+    if (columns.contains("temperatureFiltered")) {
+        QVector<int> indices;
+        foreach (const QString &column, sensorLogColumns()) {
+            indices.append(reader.columnIndex(column));
+            if (indices.last() < 0) {
+                m_errorString = QString("%1: missing column %2").arg(fileName).arg(column);
+                return false;
+            }
+        }
+
+        for (qint64 i = 0; i < reader.recordCount(); i++) {
+            const float *recordValues = reader.values(i);
+            double values[10];
+            for (int column = 0; column < 10; column++) {
+                values[column] = static_cast<double>(recordValues[indices.at(column)]);
+            }
+            appendMonitorRow(reader.timestamp(i), values);
+        }
+        return true;
+    }
+
+    // Raw capture of one sensor thread
+    QList<QPair<QString, int> > mapping;
+    if (columns == (QStringList() << "temperature" << "humidity")) {
+        mapping << qMakePair(QString("temperature"), 0) << qMakePair(QString("humidity"), 1);
+    } else if (columns == (QStringList() << "pressure" << "altitude")) {
+        mapping << qMakePair(QString("pressure"), 0);
+    } else if (columns == (QStringList() << "fullSpectrum" << "infrared" << "lux")) {
+        // The capture keeps the raw channels, convert all frames at once with the kernel of the plugin
+        QVector<Tsl2561Frame> frames(static_cast<int>(reader.recordCount()));
+        for (int i = 0; i < frames.count(); i++) {
+            frames[i].channel0 = static_cast<quint16>(reader.value(i, 0));
+            frames[i].channel1 = static_cast<quint16>(reader.value(i, 1));
+        }
+
+        QVector<double> visible(frames.count());
+        RawConversion::convertTsl2561(frames.constData(), visible.data(), frames.count());
+
+        Series &series = m_series["lux"];
+        for (int i = 0; i < frames.count(); i++) {
+            series.timestamps.append(reader.timestamp(i));
+            series.values.append(visible.at(i));
+        }
+        return true;
+    } else if (columns.count() == 4 && columns.first() == "channel1") {
+        for (qint64 i = 0; i < reader.recordCount(); i++) {
+            m_adcValues.timestamps.append(reader.timestamp(i));
+            m_adcValues.values.append(static_cast<double>(reader.value(i, 0)));
+        }
+        return true;
+    } else {
+        m_errorString = QString("%1: unknown columns %2").arg(fileName).arg(columns.join(", "));
+        return false;
+    }
+
+    for (int m = 0; m < mapping.count(); m++) {
+        Series &series = m_series[mapping.at(m).first];
+        for (qint64 i = 0; i < reader.recordCount(); i++) {
+            series.timestamps.append(reader.timestamp(i));
+            series.values.append(static_cast<double>(reader.value(i, mapping.at(m).second)));
+        }
+    }
+
+    return true;
+}
+
+void ReplayData::appendMonitorRow(qint64 timestamp, const double *values)
+{
+    QStringList channelNames = channels();
+    for (int i = 0; i < channelNames.count(); i++) {
+        Series &series = m_series[channelNames.at(i)];
+        series.timestamps.append(timestamp);
+        series.values.append(values[i * 2]);
+        series.recordedFiltered.append(values[i * 2 + 1]);
+    }
+}
+
+void ReplayData::convertAdcValues()
+{
+    if (m_adcValues.values.isEmpty())
+        return;
+
+    // Same as AirQualityMonitor: the MQ-135 gets the latest raw temperature and humidity
+    const Series &temperature = series("temperature");
+    const Series &humidity = series("humidity");
+    Series ppm;
+
+    MQ135 airQualitySensor;
+    if (m_rZero > 0)
+        airQualitySensor.setRZero(m_rZero);
+
+    int temperatureIndex = 0;
+    int humidityIndex = 0;
+    for (int i = 0; i < m_adcValues.values.count(); i++) {
+        qint64 timestamp = m_adcValues.timestamps.at(i);
+        while (temperatureIndex < temperature.timestamps.count() && temperature.timestamps.at(temperatureIndex) <= timestamp) {
+            airQualitySensor.setTemperature(temperature.values.at(temperatureIndex));
+            temperatureIndex++;
+        }
+
+        while (humidityIndex < humidity.timestamps.count() && humidity.timestamps.at(humidityIndex) <= timestamp) {
+            airQualitySensor.setHumidity(humidity.values.at(humidityIndex));
+            humidityIndex++;
+        }
+
+        airQualitySensor.setAdcValue(static_cast<int>(m_adcValues.values.at(i)));
+        ppm.timestamps.append(timestamp);
+        ppm.values.append(airQualitySensor.calculatePpmValue());
+    }
+
+    m_series.insert("ppm", ppm);
+    m_adcValues = Series();
+}
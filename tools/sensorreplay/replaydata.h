@@ -0,0 +1,80 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef REPLAYDATA_H
+#define REPLAYDATA_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <QStringList>
+
+// Recorded sensor data loaded for the replay.
+//
+// Supported inputs:
+//   - the text log of the gnuplot scripts (sensordata.log)
+//   - the binary sensor log written by AirQualityMonitor (*.slog)
+//   - the raw capture logs of the sensor threads (sensorcapture-*-<sensor>.slog)
+//
+// Every channel (temperature, humidity, pressure, lux, ppm) is one series of raw
+// values. Sensor logs also contain the filtered values calculated on the device,
+// those are kept as reference. The ADS1115 capture contains ADC values, which
+// get converted with the MQ135 math of the plugin. The TSL2561 capture contains
+// the raw channels, which get converted with the batch kernel of RawConversion.
+
+class ReplayData
+{
+public:
+    struct Series {
+        QVector<qint64> timestamps; // [ms]
+        QVector<double> values;
+        QVector<double> recordedFiltered; // Empty if not recorded
+    };
+
+    static QStringList channels();
+
+    bool load(const QString &fileName);
+
+    // RZero of the MQ-135 conversion, e.g. the baseline learned by the station. 0 keeps the default.
+    void setRZero(double rZero);
+
+    // Call once all files are loaded
+    void finish();
+
+    QString errorString() const;
+
+    bool contains(const QString &channel) const;
+    const Series &series(const QString &channel) const;
+
+private:
+    QHash<QString, Series> m_series;
+    Series m_adcValues;
+    double m_rZero = 0;
+    QString m_errorString;
+
+    bool loadText(const QString &fileName);
+    bool loadBinary(const QString &fileName);
+    void appendMonitorRow(qint64 timestamp, const double *values);
+    void convertAdcValues();
+};
+
+#endif // REPLAYDATA_H
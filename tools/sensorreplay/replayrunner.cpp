@@ -0,0 +1,192 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "replayrunner.h"
+
+#include <math.h>
+#include <algorithm>
+
+#include <QRegExp>
+#include <QStringList>
+
+ReplayRunner::Configuration ReplayRunner::defaultConfiguration(int airQualitySampleRate)
+{
+    Configuration configuration;
+    configuration.name = "default";
+    configuration.filters = FilterConfiguration::monitorFilters(airQualitySampleRate);
+    return configuration;
+}
+
+bool ReplayRunner::parseConfiguration(const QString &specification, int airQualitySampleRate, ReplayRunner::Configuration *configuration, QString *errorString)
+{
+    *configuration = defaultConfiguration(airQualitySampleRate);
+    configuration->name = specification.simplified();
+
+    foreach (const QString &token, specification.split(QRegExp("[\\s;]+"), QString::SkipEmptyParts)) {
+        QStringList assignment = token.split('=');
+        if (assignment.count() != 2 || !ReplayData::channels().contains(assignment.at(0))) {
+            *errorString = QString("Invalid filter \"%1\", expected <channel>=<type>:<window>[:<alpha>] with channel one of %2").arg(token).arg(ReplayData::channels().join(", "));
+            return false;
+        }
+
+        QStringList parameters = assignment.at(1).split(':');
+        FilterConfiguration::Filter filter;
+        if (parameters.at(0) == "average") {
+            filter.type = SensorDataFilter::TypeAverage;
+        } else if (parameters.at(0) == "lowpass") {
+            filter.type = SensorDataFilter::TypeLowPass;
+        } else if (parameters.at(0) == "highpass") {
+            filter.type = SensorDataFilter::TypeHighPass;
+        } else {
+            *errorString = QString("Invalid filter type \"%1\", expected average, lowpass or highpass").arg(parameters.at(0));
+            return false;
+        }
+
+        bool windowValid = parameters.count() >= 2;
+        if (windowValid)
+            filter.windowSize = parameters.at(1).toUInt(&windowValid);
+
+        if (!windowValid || filter.windowSize == 0) {
+            *errorString = QString("Invalid window size in \"%1\"").arg(token);
+            return false;
+        }
+
+        if (parameters.count() >= 3) {
+            bool alphaValid = false;
+            filter.alpha = parameters.at(2).toDouble(&alphaValid);
+            if (!alphaValid || filter.alpha <= 0 || filter.alpha > 1) {
+                *errorString = QString("Invalid alpha in \"%1\", expected 0 < alpha <= 1").arg(token);
+                return false;
+            }
+        }
+
+        configuration->filters.insert(assignment.at(0), filter);
+    }
+
+    return true;
+}
+
+ReplayRunner::Result ReplayRunner::run(const ReplayData &data, const ReplayRunner::Configuration &configuration, bool keepSeries)
+{
+    Result result;
+    foreach (const QString &channel, ReplayData::channels()) {
+        if (!data.contains(channel))
+            continue;
+
+        const ReplayData::Series &series = data.series(channel);
+        FilterConfiguration::Filter filterConfiguration = configuration.filters.value(channel);
+
+        SensorDataFilter filter(filterConfiguration.type);
+        FilterConfiguration::apply(&filter, filterConfiguration);
+
+        QVector<double> filtered;
+        filtered.reserve(series.values.count());
+        foreach (double value, series.values) {
+            filtered.append(filter.filterValue(value));
+        }
+
+        result.metrics.insert(channel, evaluate(series, filtered, filterConfiguration.windowSize));
+        if (keepSeries) {
+            result.filtered.insert(channel, filtered);
+        }
+    }
+
+    return result;
+}
+
+ReplayRunner::Metrics ReplayRunner::evaluate(const ReplayData::Series &series, const QVector<double> &filtered, uint windowSize)
+{
+    Metrics metrics;
+    int count = series.values.count();
+    metrics.samples = count;
+    if (count < 2)
+        return metrics;
+
+    double squaredError = 0;
+    double recordedSquaredError = 0;
+    bool hasRecorded = series.recordedFiltered.count() == count;
+    double rawMean = 0;
+    double filteredMean = 0;
+    for (int i = 0; i < count; i++) {
+        double error = filtered.at(i) - series.values.at(i);
+        squaredError += error * error;
+        if (hasRecorded) {
+            double recordedError = filtered.at(i) - series.recordedFiltered.at(i);
+            recordedSquaredError += recordedError * recordedError;
+        }
+        rawMean += series.values.at(i);
+        filteredMean += filtered.at(i);
+    }
+
+    metrics.rmse = sqrt(squaredError / count);
+    if (hasRecorded)
+        metrics.recordedRmse = sqrt(recordedSquaredError / count);
+
+    rawMean /= count;
+    filteredMean /= count;
+
+    // Noise: standard deviation of the sample to sample changes
+    double rawDifferences = 0;
+    double filteredDifferences = 0;
+    for (int i = 1; i < count; i++) {
+        double rawDifference = series.values.at(i) - series.values.at(i - 1);
+        double filteredDifference = filtered.at(i) - filtered.at(i - 1);
+        rawDifferences += rawDifference * rawDifference;
+        filteredDifferences += filteredDifference * filteredDifference;
+    }
+    metrics.noiseReduction = rawDifferences > 0 ? sqrt(filteredDifferences / rawDifferences) : 1;
+
+    // Lag: shift of the filtered series with the best cross correlation
+    int maximumLag = qMin(qMin(static_cast<int>(windowSize) * 2, 256), count / 2);
+    double bestCorrelation = -2;
+    for (int lag = 0; lag <= maximumLag; lag++) {
+        double covariance = 0;
+        double rawVariance = 0;
+        double filteredVariance = 0;
+        for (int i = 0; i + lag < count; i++) {
+            double raw = series.values.at(i) - rawMean;
+            double value = filtered.at(i + lag) - filteredMean;
+            covariance += raw * value;
+            rawVariance += raw * raw;
+            filteredVariance += value * value;
+        }
+
+        if (rawVariance <= 0 || filteredVariance <= 0)
+            break;
+
+        double correlation = covariance / sqrt(rawVariance * filteredVariance);
+        if (correlation > bestCorrelation) {
+            bestCorrelation = correlation;
+            metrics.lagSamples = lag;
+        }
+    }
+
+    // Convert with the median sample interval
+    QVector<qint64> intervals;
+    for (int i = 1; i < count; i++) {
+        intervals.append(series.timestamps.at(i) - series.timestamps.at(i - 1));
+    }
+    std::nth_element(intervals.begin(), intervals.begin() + intervals.count() / 2, intervals.end());
+    metrics.lagSeconds = metrics.lagSamples * intervals.at(intervals.count() / 2) / 1000.0;
+
+    return metrics;
+}
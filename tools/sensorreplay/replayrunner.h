@@ -0,0 +1,69 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of nymea.                                            *
+ *                                                                         *
+ *  This library is free software; you can redistribute it and/or          *
+ *  modify it under the terms of the GNU Lesser General Public             *
+ *  License as published by the Free Software Foundation; either           *
+ *  version 2.1 of the License, or (at your option) any later version.     *
+ *                                                                         *
+ *  This library is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU      *
+ *  Lesser General Public License for more details.                        *
+ *                                                                         *
+ *  You should have received a copy of the GNU Lesser General Public       *
+ *  License along with this library; If not, see                           *
+ *  <http://www.gnu.org/licenses/>.                                        *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef REPLAYRUNNER_H
+#define REPLAYRUNNER_H
+
+#include <QHash>
+#include <QVector>
+#include <QString>
+
+#include "replaydata.h"
+#include "filterconfiguration.h"
+
+// Runs one filter configuration over the recorded data and evaluates it.
+
+class ReplayRunner
+{
+public:
+    struct Configuration {
+        QString name;
+        QHash<QString, FilterConfiguration::Filter> filters;
+    };
+
+    struct Metrics {
+        int samples = 0;
+        double rmse = 0; // Filtered against raw
+        double noiseReduction = 0; // Std of the first differences, filtered / raw
+        int lagSamples = 0; // Shift with the best correlation between raw and filtered
+        double lagSeconds = 0;
+        double recordedRmse = qQNaN(); // Filtered against the filtered values recorded on the device
+    };
+
+    struct Result {
+        QHash<QString, Metrics> metrics;
+        QHash<QString, QVector<double> > filtered;
+    };
+
+    // The filter chain of AirQualityMonitor for the given MQ-135 sample rate [samples/s]
+    static Configuration defaultConfiguration(int airQualitySampleRate = FilterConfiguration::singleShotSampleRate);
+
+    // e.g. "temperature=average:60 pressure=lowpass:20:0.2", missing channels keep the defaults
+    static bool parseConfiguration(const QString &specification, int airQualitySampleRate, Configuration *configuration, QString *errorString);
+
+    static Result run(const ReplayData &data, const Configuration &configuration, bool keepSeries);
+
+private:
+    static Metrics evaluate(const ReplayData::Series &series, const QVector<double> &filtered, uint windowSize);
+};
+
+#endif // REPLAYRUNNER_H
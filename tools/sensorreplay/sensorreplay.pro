@@ -0,0 +1,28 @@
+TEMPLATE = app
+TARGET = sensorreplay
+
+QT -= gui
+QT += concurrent
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+include(../../sensorlog/sensorlog.pri)
+
+INCLUDEPATH += ../..
+
+HEADERS += \
+    ../../filterconfiguration.h \
+    ../../rawconversion.h \
+    ../../sensordatafilter.h \
+    ../../sensors/mq135.h \
+    replaydata.h \
+    replayrunner.h
+
+SOURCES += \
+    main.cpp \
+    ../../filterconfiguration.cpp \
+    ../../rawconversion.cpp \
+    ../../sensordatafilter.cpp \
+    ../../sensors/mq135.cpp \
+    replaydata.cpp \
+    replayrunner.cpp